@@ -30,30 +30,37 @@ SerialCommand::SerialCommand()
   : commandList(NULL),
     commandCount(0),
     defaultHandler(NULL),
+    delim(' '),           // default delimiter for tokens, space character
     term('\n'),           // default terminator for commands, newline character
+    idSep('#'),           // default separator for request IDs
     last(NULL)
 {
-  strcpy(delim, " "); // strtok_r needs a null-terminated string
   clearBuffer();
 }
 
 /**
- * Adds a "command" and a handler function to the list of available commands.
- * This is used for matching a found token in the buffer, and gives the pointer
- * to the handler function to deal with it.
+ * Sets the table of commands and their handler functions.
+ * Table and command strings must be stored in PROGMEM and the table must be sorted
+ * by command (strcmp order) as it is searched binary. Nothing is allocated.
  */
-void SerialCommand::addCommand(const char *command, void (*function)()) {
+void SerialCommand::setCommands(const SerialCommandCallback *commands, byte count) {
+  commandList = commands;
+  commandCount = count;
+
   #ifdef SERIALCOMMAND_DEBUG
-    Serial.print("Adding command (");
-    Serial.print(commandCount);
-    Serial.print("): ");
-    Serial.println(command);
+    for (int i = 1; i < commandCount; i++) {
+      SerialCommandCallback prev, cur;
+      memcpy_P(&prev, &commandList[i-1], sizeof(prev));
+      memcpy_P(&cur, &commandList[i], sizeof(cur));
+      char prevCommand[SERIALCOMMAND_BUFFER + 1];
+      strncpy_P(prevCommand, prev.command, SERIALCOMMAND_BUFFER);
+      prevCommand[SERIALCOMMAND_BUFFER] = '\0';
+      if (strcmp_P(prevCommand, cur.command) >= 0) {
+        Serial.print("Command table not sorted at ");
+        Serial.println(i);
+      }
+    }
   #endif
-
-  commandList = (SerialCommandCallback *) realloc(commandList, (commandCount + 1) * sizeof(SerialCommandCallback));
-  strncpy(commandList[commandCount].command, command, SERIALCOMMAND_MAXCOMMANDLENGTH);
-  commandList[commandCount].function = function;
-  commandCount++;
 }
 
 /**
@@ -66,66 +73,151 @@ void SerialCommand::setDefaultHandler(void (*function)(const char *)) {
 
 
 /**
- * This checks the Serial stream for characters, and assembles them into a buffer.
- * When the terminator character (default '\n') is seen, it starts parsing the
- * buffer for a prefix command, and calls handlers setup by addCommand() member
+ * This checks the Serial stream for characters and parses them as they arrive,
+ * see processChar(). Returns true right after a command has been executed such
+ * that its handler may take over the serial stream.
  */
 boolean SerialCommand::readSerial() {
-  boolean matched = false;
   while (Serial.available() > 0) {
-    char inChar = Serial.read();   // Read single available character, there may be more waiting
+    if (processChar(Serial.read())) {   // Read single available character, there may be more waiting
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * Parses one character: the command is looked up as soon as its first delimiter
+ * is seen, arguments are split into tokens (or passed to the argument handler of
+ * the command) on the fly. When the terminator character (default '\n') is seen,
+ * the handler given by setCommands() is called right away.
+ * A command may be followed by a request ID (CMD#id) that is available to its handler.
+ * Returns true if a command has been executed.
+ */
+boolean SerialCommand::processChar(char inChar) {
+  boolean matched = false;
+  #ifdef SERIALCOMMAND_DEBUG
+    Serial.print(inChar);   // Echo back to serial stream
+  #endif
+
+  if (inChar == term) {     // Check for the terminator (default '\n') meaning end of command
+    matched = dispatch();
+    clearBuffer();
+  }
+  else if (!isprint((unsigned char)inChar)) {
+    // Only printable characters are parsed; char may be signed, isprint() takes its value as unsigned char
+  }
+  else if (state == PARSE_STREAM) {
+    (*entry.argument)(inChar);
+  }
+  else if (state == PARSE_SKIP) {
+    // Discard the arguments of an unknown command
+  }
+  else if (inChar == delim) {
+    if (state == PARSE_COMMAND) {
+      if (bufPos > 0) {     // Skip leading delimiters
+        commandComplete();
+      }
+    } else if (buffer[bufPos - 1] != '\0' && bufPos < SERIALCOMMAND_BUFFER) {
+      buffer[++bufPos] = '\0';    // Terminate the current token, skip repeated delimiters
+    }
+  }
+  else if (inChar == idSep && state == PARSE_COMMAND && idPos == 0 && bufPos > 0 && bufPos < SERIALCOMMAND_BUFFER) {
+    buffer[++bufPos] = '\0';    // Terminate the command, the request ID follows
+    idPos = bufPos;
+  }
+  else if (bufPos < SERIALCOMMAND_BUFFER) {     // Command or argument character into the buffer
+    buffer[bufPos++] = inChar;
+    buffer[bufPos] = '\0';
+  } else {
     #ifdef SERIALCOMMAND_DEBUG
-      Serial.print(inChar);   // Echo back to serial stream
+      Serial.println("Line buffer is full - increase SERIALCOMMAND_BUFFER");
     #endif
+  }
+  return matched;
+}
 
-    if (inChar == term) {     // Check for the terminator (default '\r') meaning end of command
-      #ifdef SERIALCOMMAND_DEBUG
-        Serial.print("Received: ");
-        Serial.println(buffer);
-      #endif
-
-      char *command = strtok_r(buffer, delim, &last);   // Search for command at start of buffer
-      if (command != NULL) {
-        for (int i = 0; i < commandCount; i++) {
-          #ifdef SERIALCOMMAND_DEBUG
-            Serial.print("Comparing [");
-            Serial.print(command);
-            Serial.print("] to [");
-            Serial.print(commandList[i].command);
-            Serial.println("]");
-          #endif
-
-          // Compare the found command against the list of known commands for a match
-          if (strncmp(command, commandList[i].command, SERIALCOMMAND_MAXCOMMANDLENGTH) == 0) {
-            #ifdef SERIALCOMMAND_DEBUG
-              Serial.print("Matched Command: ");
-              Serial.println(command);
-            #endif
-
-            // Execute the stored handler function for the command
-            (*commandList[i].function)();
-            matched = true;
-            break;
-          }
-        }
-        if (!matched && (defaultHandler != NULL)) {
-          (*defaultHandler)(command);
-        }
-      }
-      clearBuffer();
+/**
+ * Binary search for the command at the start of the buffer in the sorted command table.
+ * On success the table entry is copied to entry.
+ */
+boolean SerialCommand::findCommand() {
+  int lo = 0;
+  int hi = commandCount - 1;
+  while (lo <= hi) {
+    int mid = (lo + hi) / 2;
+    memcpy_P(&entry, &commandList[mid], sizeof(entry));
+    #ifdef SERIALCOMMAND_DEBUG
+      Serial.print("Comparing [");
+      Serial.print(buffer);
+      Serial.print("] to [");
+      Serial.print((const __FlashStringHelper *)entry.command);
+      Serial.println("]");
+    #endif
+
+    // Compare the command against the table entry (in flash, full length)
+    int cmp = strcmp_P(buffer, entry.command);
+    if (cmp == 0) {
+      return true;
+    } else if (cmp < 0) {
+      hi = mid - 1;
+    } else {
+      lo = mid + 1;
     }
-    else if (isprint(inChar)) {     // Only printable characters into the buffer
-      if (bufPos < SERIALCOMMAND_BUFFER) {
-        buffer[bufPos++] = inChar;  // Put character into buffer
-        buffer[bufPos] = '\0';      // Null terminate
-      } else {
-        #ifdef SERIALCOMMAND_DEBUG
-          Serial.println("Line buffer is full - increase SERIALCOMMAND_BUFFER");
-        #endif
-      }
+  }
+  return false;
+}
+
+/**
+ * Called once the command has been read completely; selects how its arguments are parsed.
+ */
+void SerialCommand::commandComplete() {
+  if (!findCommand()) {
+    state = PARSE_SKIP;
+  } else if (entry.argument != NULL) {
+    state = PARSE_STREAM;
+    (*entry.argument)('\0');
+  } else {
+    state = PARSE_ARGS;
+    if (bufPos < SERIALCOMMAND_BUFFER) {
+      buffer[++bufPos] = '\0';    // Arguments start behind the terminated command
+    }
+  }
+}
+
+/**
+ * Calls the handler of the command in the buffer, or the default handler if there is none.
+ * Returns true if a command was executed.
+ */
+boolean SerialCommand::dispatch() {
+  if (state == PARSE_COMMAND) {
+    if (bufPos == 0) {
+      return false;     // Empty line
     }
+    commandComplete();
   }
-	return matched;
+  #ifdef SERIALCOMMAND_DEBUG
+    Serial.print("Received: ");
+    Serial.println(buffer);
+  #endif
+
+  if (state == PARSE_SKIP) {
+    if (defaultHandler != NULL) {
+      (*defaultHandler)(buffer);
+    }
+    return false;
+  }
+
+  #ifdef SERIALCOMMAND_DEBUG
+    Serial.print("Matched Command: ");
+    Serial.println(buffer);
+  #endif
+
+  // Execute the stored handler function for the command, arguments follow command and request ID
+  last = buffer + idPos;
+  last += strlen(last) + 1;
+  (*entry.function)();
+  return true;
 }
 
 /*
@@ -134,6 +226,8 @@ boolean SerialCommand::readSerial() {
 void SerialCommand::clearBuffer() {
   buffer[0] = '\0';
   bufPos = 0;
+  idPos = 0;
+  state = PARSE_COMMAND;
 }
 
 /**
@@ -141,5 +235,18 @@ void SerialCommand::clearBuffer() {
  * Returns NULL if no more tokens exist.
  */
 char *SerialCommand::next() {
-  return strtok_r(NULL, delim, &last);
+  if (last == NULL || last > buffer + bufPos || *last == '\0') {
+    return NULL;
+  }
+  char *token = last;
+  last += strlen(token) + 1;
+  return token;
+}
+
+/**
+ * Returns the request ID given with the current command (CMD#id) or NULL if there is none.
+ * Only valid while the handler of the command is executed.
+ */
+const char *SerialCommand::requestId() {
+  return (idPos == 0 || buffer[idPos] == '\0' ? NULL : buffer + idPos);
 }
@@ -32,11 +32,11 @@
   #include <WProgram.h>
 #endif
 #include <string.h>
+#include <avr/pgmspace.h>
 
 // Size of the input buffer in bytes (maximum length of one command plus arguments)
+// (longer arguments can be streamed to an argument handler, see SerialCommandCallback)
 #define SERIALCOMMAND_BUFFER 50
-// Maximum length of a command excluding the terminating null
-#define SERIALCOMMAND_MAXCOMMANDLENGTH 8
 
 // Uncomment the next line to run the library in debug mode (verbose messages)
 //#define SERIALCOMMAND_DEBUG
@@ -44,32 +44,54 @@
 
 class SerialCommand {
   public:
+    // Data structure to hold Command/Handler function key-value pairs (command string and table in PROGMEM)
+    // If argument is not NULL it is called with '\0' as soon as the command is recognized and then
+    // with each argument character as it arrives; those characters are not buffered.
+    struct SerialCommandCallback {
+      const char *command;
+      void (*function)();
+      void (*argument)(char c);
+    };
+
     SerialCommand();      // Constructor
-    void addCommand(const char *command, void(*function)());  // Add a command to the processing dictionary.
+    void setCommands(const SerialCommandCallback *commands, byte count);  // Sets the (sorted, PROGMEM) command table; commands are matched exactly.
     void setDefaultHandler(void (*function)(const char *));   // A handler to call when no valid command received.
 
     boolean readSerial();    // Main entry point.
+    boolean processChar(char inChar);   // Parses one character, returns true if a command has been executed.
     void clearBuffer();   // Clears the input buffer.
     char *next();         // Returns pointer to next token found in command buffer (for getting arguments to commands).
+    const char *requestId();   // Returns the request ID of the current command (CMD#id) or NULL.
 
   private:
-    // Command/handler dictionary
-    struct SerialCommandCallback {
-      char command[SERIALCOMMAND_MAXCOMMANDLENGTH + 1];
-      void (*function)();
-    };                                    // Data structure to hold Command/Handler function key-value pairs
-    SerialCommandCallback *commandList;   // Actual definition for command/handler array
+    // Parser states
+    enum ParseState {
+      PARSE_COMMAND,   // reading the command
+      PARSE_ARGS,      // command recognized, tokenizing arguments into the buffer
+      PARSE_STREAM,    // command recognized, passing arguments to its argument handler
+      PARSE_SKIP       // unknown command, discarding the rest of the line
+    };
+
+    boolean findCommand();     // Looks up the command at the start of the buffer and stores it in entry
+    void commandComplete();    // Switches to the argument state matching the command just read
+    boolean dispatch();        // Calls the handler of the command once the terminator arrived
+
+    const SerialCommandCallback *commandList;   // Command/handler table in PROGMEM, sorted by command
     byte commandCount;
 
     // Pointer to the default handler function
     void (*defaultHandler)(const char *);
 
-    char delim[2]; // null-terminated list of character to be used as delimeters for tokenizing (default " ")
+    char delim;    // Character used as delimiter for tokenizing (default ' ')
     char term;     // Character that signals end of command (default '\n')
+    char idSep;    // Character that separates an optional request ID from the command (default '#')
 
-    char buffer[SERIALCOMMAND_BUFFER + 1]; // Buffer of stored characters while waiting for terminator character
+    char buffer[SERIALCOMMAND_BUFFER + 1]; // Buffer of null-separated tokens while waiting for terminator character
     byte bufPos;                        // Current position in the buffer
-    char *last;                         // State variable used by strtok_r during processing
+    byte state;                         // Current ParseState
+    byte idPos;                         // Position of the request ID in the buffer, 0 if none
+    SerialCommandCallback entry;        // Table entry of the recognized command (copied from PROGMEM)
+    char *last;                         // Next token to be returned by next()
 };
 
 #endif //SerialCommand_h
@@ -38,3 +38,37 @@
 
 #include <tonino.h>
 
+
+// micros() timestamps of the boot stages, 0 if not reached
+uint32_t bootTimes[NR_BOOT_STAGES];
+
+// records the current time for the given boot stage
+void bootStage(uint8_t stage) {
+  if (stage < NR_BOOT_STAGES) {
+    bootTimes[stage] = micros();
+  }
+}
+
+// time in ms spent in each energy state except ENERGY_RUN (see energyTime())
+uint32_t energyTimes[NR_ENERGY_STATES];
+// sub-millisecond rest of the times in energyTimes
+static uint16_t energyMicros[NR_ENERGY_STATES];
+
+// adds us microseconds to the time spent in the given energy state
+void energyAdd(uint8_t state, uint32_t us) {
+  energyTimes[state] += us / 1000;
+  energyMicros[state] += us % 1000;
+  if (energyMicros[state] >= 1000) {
+    energyMicros[state] -= 1000;
+    ++energyTimes[state];
+  }
+}
+
+// time in ms spent in the given energy state since reset
+// millis() does not advance during power down, so the run time is all of millis() not spent idle
+uint32_t energyTime(uint8_t state) {
+  if (state == ENERGY_RUN) {
+    return millis() - energyTimes[ENERGY_IDLE] - energyTimes[ENERGY_IDLE_SLOW];
+  }
+  return energyTimes[state];
+}
@@ -53,7 +53,7 @@
  #include "WProgram.h"
 #endif
 
-// low power mode if no action during this time
+// low power mode if no action during this time (defaults, see ToninoConfig::setPowerTimes)
 // DIM < SLEEP < POWERDOWN
 #define TIME_TILL_DIM        120000 //  2 minutes = 120000
 #define TIME_TILL_SLEEP      600000 // 10 minutes = 600000
@@ -65,6 +65,10 @@
 #define DEFAULT_DELAYTILLUPTEST 10 // in 100ms, i.e. 10 means 1 second
 #define DEFAULT_BRIGHTNESS 10
 #define DEFAULT_DOCALINIT true
+#define DEFAULT_FASTBOOT false
+#define DEFAULT_BAUDRATE 115200
+#define DEFAULT_ADAPTIVEPOWER false
+#define DEFAULT_THROUGHPUT false
 #define DEFAULT_SCALE_0 0.0
 #define DEFAULT_SCALE_1 0.0
 #define DEFAULT_SCALE_2 102.2727273
@@ -74,6 +78,46 @@
 
 #define AVERAGE_TIME_SPAN 4000 // 4000=4sec; time in milliseconds after which averaging is restarted
 
+// boot timeline stages, see bootStage()
+#define BOOT_START     0 // setup() entered
+#define BOOT_SERIAL    1 // serial communication initialized
+#define BOOT_DISPLAY   2 // display initialized
+#define BOOT_SENSOR    3 // color sensor initialized
+#define BOOT_CONFIG    4 // configuration loaded
+#define BOOT_READY     5 // ready for the first scan
+#define BOOT_SCAN      6 // first scan (or calibration) finished
+#define BOOT_DEFERRED  7 // deferred initialization finished
+#define NR_BOOT_STAGES 8
+
+// micros() timestamps of the boot stages, 0 if not reached
+extern uint32_t bootTimes[NR_BOOT_STAGES];
+
+// records the current time for the given boot stage
+void bootStage(uint8_t stage);
+
+// states of the energy model, see energyAdd()
+#define ENERGY_RUN       0 // CPU running (all time not spent in the other states)
+#define ENERGY_IDLE      1 // idle sleep between tasks, woken by timer 0 and serial input
+#define ENERGY_SLEEP     2 // power down after the sleep time (see ToninoPower)
+#define ENERGY_IDLE_SLOW 3 // idle sleep with the clock divided by CLOCK_SLOW_DIV
+#define NR_ENERGY_STATES 4
+
+// estimated supply current of the board in each energy state, in uA
+// rough figures for an ATmega328P at 16MHz incl. regulator, display and sensor off
+#define ENERGY_CURRENT_RUN       15000
+#define ENERGY_CURRENT_IDLE       6000
+#define ENERGY_CURRENT_SLEEP       300
+#define ENERGY_CURRENT_IDLE_SLOW  2500
+
+// time in ms spent in each energy state except ENERGY_RUN (see energyTime())
+extern uint32_t energyTimes[NR_ENERGY_STATES];
+
+// adds us microseconds to the time spent in the given energy state
+void energyAdd(uint8_t state, uint32_t us);
+
+// time in ms spent in the given energy state since reset
+uint32_t energyTime(uint8_t state);
+
 #if DODEBUG
 #define WRITEDEBUG(s) Serial.print(s)
 #define WRITEDEBUGF(s, f) Serial.print(s, f)
@@ -0,0 +1,424 @@
+// tonino_calibration.cpp
+//------------------------
+// calibration with the calibration plates or other reference plates, run step by step by the main loop
+//
+// *** BSD License ***
+// ------------------------------------------------------------------------------------------
+// Copyright (c) 2016, Paul Holleis, Marko Luther
+// All rights reserved.
+//
+// Authors:  Paul Holleis, Marko Luther
+//
+// Redistribution and use in source and binary forms, with or without modification, are 
+// permitted provided that the following conditions are met:
+//
+//   Redistributions of source code must retain the above copyright notice, this list of 
+//   conditions and the following disclaimer.
+//
+//   Redistributions in binary form must reproduce the above copyright notice, this list 
+//   of conditions and the following disclaimer in the documentation and/or other materials 
+//   provided with the distribution.
+//
+//   Neither the name of the copyright holder(s) nor the names of its contributors may be 
+//   used to endorse or promote products derived from this software without specific prior 
+//   written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS 
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF 
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL 
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) 
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS 
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// ------------------------------------------------------------------------------------------
+
+
+
+
+#include <tonino_calibration.h>
+#include <tonino_serial.h>
+
+
+ToninoCalibration::ToninoCalibration(TCS3200 *colorSense, LCD *display, ToninoConfig *tConfig) :
+  _colorSense(colorSense), _display(display), _tConfig(tConfig),
+  _state(CAL_IDLE), _plate(0), _plates(CAL_PLATES), _model(CAL_LINEAR), _checkPlate(true),
+  _since(0), _scans(0), _red(0.0), _blue(0.0) {
+  for (uint8_t p = 0; p < CAL_MAX_PLATES; ++p) {
+    _targets[p] = 0.0;
+    _rb[p] = 0.0;
+    _deviation[p] = 0.0;
+    _used[p] = 0;
+    _residual[p] = 0.0;
+  }
+}
+
+ToninoCalibration::~ToninoCalibration() {
+  // empty
+}
+
+// starts a new calibration with the first plate; a running one is restarted
+// without targets the two calibration plates are used, otherwise the given number of plates with the given target values
+void ToninoCalibration::start(uint8_t plates, uint8_t model, const float *targets) {
+  WRITEDEBUGLN("Cal.");
+  if (targets == NULL || !isValid(plates, model)) {
+    _plates = CAL_PLATES;
+    _model = CAL_LINEAR;
+    _targets[0] = LOW_TARGET;
+    _targets[1] = HIGH_TARGET;
+    _checkPlate = true;
+  } else {
+    _plates = plates;
+    _model = model;
+    memcpy(_targets, targets, plates * sizeof(float));
+    _checkPlate = false;
+  }
+  _plate = 0;
+  for (uint8_t p = 0; p < CAL_MAX_PLATES; ++p) {
+    _used[p] = 0;
+    _residual[p] = 0.0;
+  }
+  showPlate();
+  enter(CAL_PUTDOWN);
+}
+
+// true if start() accepts the given number of plates and model
+bool ToninoCalibration::isValid(uint8_t plates, uint8_t model) {
+  return (model == CAL_LINEAR || model == CAL_QUADRATIC) && plates > model && plates <= CAL_MAX_PLATES;
+}
+
+// aborts a running calibration; nothing is stored
+void ToninoCalibration::abort() {
+  if (active()) {
+    fail(CAL_ERR_ABORT);
+  }
+}
+
+// true while a calibration is running
+bool ToninoCalibration::active() {
+  return _state != CAL_IDLE;
+}
+
+// the current state, one of CAL_xxx
+uint8_t ToninoCalibration::getState() {
+  return _state;
+}
+
+// the plate (0 first, 1 second) the current state refers to
+uint8_t ToninoCalibration::getPlate() {
+  return _plate;
+}
+
+// number of plates of the last calibration
+uint8_t ToninoCalibration::getPlates() {
+  return _plates;
+}
+
+// model of the last calibration, CAL_LINEAR or CAL_QUADRATIC
+uint8_t ToninoCalibration::getModel() {
+  return _model;
+}
+
+// mean r/b ratio of the given plate in the last calibration
+float ToninoCalibration::getRatio(uint8_t plate) {
+  return (plate < CAL_MAX_PLATES ? _rb[plate] : 0.0);
+}
+
+// standard deviation of the r/b ratios of the given plate in the last calibration
+float ToninoCalibration::getDeviation(uint8_t plate) {
+  return (plate < CAL_MAX_PLATES ? _deviation[plate] : 0.0);
+}
+
+// number of scans of the given plate used in the last calibration, 0 if not scanned
+uint8_t ToninoCalibration::getScans(uint8_t plate) {
+  return (plate < CAL_MAX_PLATES ? _used[plate] : 0);
+}
+
+// residual of the fit for the given plate in the last calibration (target minus calibrated value)
+float ToninoCalibration::getResidual(uint8_t plate) {
+  return (plate < CAL_MAX_PLATES ? _residual[plate] : 0.0);
+}
+
+// executes the next step of the calibration; returns the time (ms) until step() is to be called again
+uint16_t ToninoCalibration::step() {
+  switch (_state) {
+    case CAL_PUTDOWN:
+      if (_colorSense->isDark()) {
+        showPlate();
+        // put-downs on the plates are not counted in the settle statistics of stand-alone scans
+        _colorSense->startSettle(false);
+        enter(CAL_SETTLE);
+        return SETTLE_PROBE_INTERVAL;
+      }
+      break;
+
+    case CAL_SETTLE:
+      if (!_colorSense->settled()) {
+        return SETTLE_PROBE_INTERVAL;
+      }
+      _scans = 0;
+      _red = 0.0;
+      _blue = 0.0;
+      enter(CAL_SCAN);
+      return 0;
+
+    case CAL_SCAN:
+      // one scan per step such that serial commands are handled in between
+      scanOnce();
+      if (_scans < CAL_SCANS) {
+        return 0;
+      }
+      if (!evaluatePlate()) {
+        return 0;
+      }
+      if (_plate + 1 < _plates) {
+        ++_plate;
+        showPlate();
+        enter(CAL_LIFT);
+        return CAL_POLL_INTERVAL;
+      }
+      _display->done();
+      enter(CAL_DONE);
+      _state = CAL_IDLE;
+      return 0;
+
+    case CAL_LIFT:
+      if (_colorSense->isLight()) {
+        _display->up();
+        enter(CAL_PUTDOWN);
+        return CAL_POLL_INTERVAL;
+      }
+      break;
+
+    default:
+      return 0;
+  }
+  // still waiting for the can
+  if (millis() - _since > CAL_TIMEOUT) {
+    fail(CAL_ERR_TIMEOUT);
+    return 0;
+  }
+  return CAL_POLL_INTERVAL;
+}
+
+// changes to the given state and reports it
+void ToninoCalibration::enter(uint8_t state) {
+  _state = state;
+  _since = millis();
+  ToninoSerial::pushCalibration(state, _plate, CAL_ERR_NONE);
+}
+
+// shows CAL1, CAL2, ... for the current plate
+void ToninoCalibration::showPlate() {
+  _display->calibrationPlate(_plate + 1);
+}
+
+// ends the calibration with the given CAL_ERR_xxx reason
+void ToninoCalibration::fail(uint8_t reason) {
+  WRITEDEBUG("Cal. failed:");
+  WRITEDEBUGLN(reason);
+  if (reason == CAL_ERR_ABORT) {
+    _display->clear();
+  } else {
+    _display->error();
+  }
+  _state = CAL_IDLE;
+  ToninoSerial::pushCalibration(CAL_FAILED, _plate, reason);
+}
+
+// takes the next of the CAL_SCANS scans of the current plate
+void ToninoCalibration::scanOnce() {
+  sensorData sd;
+  _colorSense->scan(NULL, false, &sd, true, false, NULL, 0, COLOR_RED|COLOR_BLUE);
+  showPlate();
+
+  float red = sd.value[RED_IDX];
+  float blue = sd.value[BLUE_IDX];
+  _ratios[_scans++] = (blue > 0 ? red / blue : 0.0);
+  _red += red;
+  _blue += blue;
+}
+
+// rejects outliers among the scans of the current plate and checks their spread; returns false if it failed
+// the last plate completes the calibration which is then fitted and stored
+bool ToninoCalibration::evaluatePlate() {
+  float redavg = _red / _scans;
+  float blueavg = _blue / _scans;
+  if (_plate == 0 && _checkPlate &&
+      ((abs(redavg - LOW_RED) >= RED_RANGE_LOW) || (abs(blueavg - LOW_BLUE) >= BLUE_RANGE_LOW))) {
+    // could not detect first plate even though quick check thought so
+    fail(CAL_ERR_PLATE);
+    return false;
+  }
+
+  // outliers are further from the median than CAL_OUTLIER times the median absolute deviation
+  float v[CAL_SCANS];
+  memcpy(v, _ratios, sizeof(v));
+  float med = median(v, _scans);
+  for (uint8_t i = 0; i < _scans; ++i) {
+    v[i] = fabs(_ratios[i] - med);
+  }
+  float limit = median(v, _scans) * CAL_OUTLIER;
+  if (limit < CAL_MAX_DEVIATION) {
+    limit = CAL_MAX_DEVIATION;
+  }
+
+  float sum = 0.0;
+  uint8_t n = 0;
+  for (uint8_t i = 0; i < _scans; ++i) {
+    if (fabs(_ratios[i] - med) <= limit) {
+      sum += _ratios[i];
+      ++n;
+    }
+  }
+  if (n == 0) {
+    // no ratio within the limit, e.g. if a reading failed
+    fail(CAL_ERR_SPREAD);
+    return false;
+  }
+  float mean = sum / n;
+  float sq = 0.0;
+  for (uint8_t i = 0; i < _scans; ++i) {
+    if (fabs(_ratios[i] - med) <= limit) {
+      sq += (_ratios[i] - mean) * (_ratios[i] - mean);
+    }
+  }
+  _rb[_plate] = mean;
+  _deviation[_plate] = (n > 1 ? sqrt(sq / (n - 1)) : 0.0);
+  _used[_plate] = n;
+
+  WRITEDEBUG(redavg);
+  WRITEDEBUG("/");
+  WRITEDEBUG(blueavg);
+  WRITEDEBUG("=");
+  WRITEDEBUGF(mean, 5);
+  WRITEDEBUG("+-");
+  WRITEDEBUGF(_deviation[_plate], 5);
+  WRITEDEBUG(" n=");
+  WRITEDEBUGLN(n);
+
+  if (n < CAL_MIN_SCANS || _deviation[_plate] > CAL_MAX_DEVIATION) {
+    fail(CAL_ERR_SPREAD);
+    return false;
+  }
+  if (_plate + 1 < _plates) {
+    return true;
+  }
+  if (!fit()) {
+    fail(CAL_ERR_FIT);
+    return false;
+  }
+  return true;
+}
+
+// least squares fit of the model to the ratios and targets of all plates; stores the calibration and the residuals
+bool ToninoCalibration::fit() {
+  // the ratios are centered on their mean to keep the normal equations well conditioned in single precision
+  uint8_t n = _model + 1;
+  float mean = 0.0;
+  for (uint8_t p = 0; p < _plates; ++p) {
+    mean += _rb[p];
+  }
+  mean /= _plates;
+
+  // normal equations: sum of x^(i+j) * c[j] = sum of y * x^i
+  float a[3][3];
+  float c[3];
+  for (uint8_t i = 0; i < n; ++i) {
+    c[i] = 0.0;
+    for (uint8_t j = 0; j < n; ++j) {
+      a[i][j] = 0.0;
+    }
+  }
+  for (uint8_t p = 0; p < _plates; ++p) {
+    float x = _rb[p] - mean;
+    float xp[5] = { 1.0, x, x*x, x*x*x, x*x*x*x };
+    for (uint8_t i = 0; i < n; ++i) {
+      c[i] += _targets[p] * xp[i];
+      for (uint8_t j = 0; j < n; ++j) {
+        a[i][j] += xp[i+j];
+      }
+    }
+  }
+  if (!solve(a, c, n)) {
+    return false;
+  }
+
+  // back from centered to plain ratios
+  float quad = (n > 2 ? c[2] : 0.0);
+  float cal[2];
+  cal[0] = c[1] - 2*quad*mean;
+  cal[1] = c[0] - c[1]*mean + quad*mean*mean;
+  if (abs(quad) > CAL_QUAD_MAX || isnan(cal[0]) || isnan(cal[1])) {
+    return false;
+  }
+
+  for (uint8_t p = 0; p < _plates; ++p) {
+    _residual[p] = _targets[p] - ((quad * _rb[p] + cal[0]) * _rb[p] + cal[1]);
+  }
+
+  WRITEDEBUG("=>");
+  WRITEDEBUGF(quad, 5);
+  WRITEDEBUG(",");
+  WRITEDEBUGF(cal[0], 5);
+  WRITEDEBUG(",");
+  WRITEDEBUGLNF(cal[1], 5);
+
+  _tConfig->setCalibration(cal, quad);
+  return true;
+}
+
+// solves the n x n (n <= 3) linear system a * x = b by Gaussian elimination with partial pivoting, x is returned in b
+bool ToninoCalibration::solve(float a[3][3], float *b, uint8_t n) {
+  for (uint8_t k = 0; k < n; ++k) {
+    uint8_t pivot = k;
+    for (uint8_t i = k + 1; i < n; ++i) {
+      if (abs(a[i][k]) > abs(a[pivot][k])) {
+        pivot = i;
+      }
+    }
+    if (abs(a[pivot][k]) < 1e-6) {
+      return false;
+    }
+    if (pivot != k) {
+      for (uint8_t j = 0; j < n; ++j) {
+        float t = a[k][j];
+        a[k][j] = a[pivot][j];
+        a[pivot][j] = t;
+      }
+      float t = b[k];
+      b[k] = b[pivot];
+      b[pivot] = t;
+    }
+    for (uint8_t i = k + 1; i < n; ++i) {
+      float f = a[i][k] / a[k][k];
+      for (uint8_t j = k; j < n; ++j) {
+        a[i][j] -= f * a[k][j];
+      }
+      b[i] -= f * b[k];
+    }
+  }
+  for (int8_t i = n - 1; i >= 0; --i) {
+    for (uint8_t j = i + 1; j < n; ++j) {
+      b[i] -= a[i][j] * b[j];
+    }
+    b[i] /= a[i][i];
+  }
+  return true;
+}
+
+// median of the first n values of v; v gets sorted
+float ToninoCalibration::median(float *v, uint8_t n) {
+  // insertion sort, n is small
+  for (uint8_t i = 1; i < n; ++i) {
+    float x = v[i];
+    int8_t j = i - 1;
+    while (j >= 0 && v[j] > x) {
+      v[j + 1] = v[j];
+      --j;
+    }
+    v[j + 1] = x;
+  }
+  return (n % 2 == 1 ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2);
+}
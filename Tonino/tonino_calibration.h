@@ -0,0 +1,177 @@
+// tonino_calibration.h
+//----------------------
+// calibration with the calibration plates or other reference plates, run step by step by the main loop
+//
+// *** BSD License ***
+// ------------------------------------------------------------------------------------------
+// Copyright (c) 2016, Paul Holleis, Marko Luther
+// All rights reserved.
+//
+// Authors:  Paul Holleis, Marko Luther
+//
+// Redistribution and use in source and binary forms, with or without modification, are 
+// permitted provided that the following conditions are met:
+//
+//   Redistributions of source code must retain the above copyright notice, this list of 
+//   conditions and the following disclaimer.
+//
+//   Redistributions in binary form must reproduce the above copyright notice, this list 
+//   of conditions and the following disclaimer in the documentation and/or other materials 
+//   provided with the distribution.
+//
+//   Neither the name of the copyright holder(s) nor the names of its contributors may be 
+//   used to endorse or promote products derived from this software without specific prior 
+//   written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS 
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF 
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL 
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) 
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS 
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// ------------------------------------------------------------------------------------------
+
+
+
+
+#ifndef _TONINO_CALIBRATION_H
+#define _TONINO_CALIBRATION_H
+
+
+#include <tonino.h>
+#include <tonino_lcd.h>
+#include <tonino_tcs3200.h>
+#include <tonino_config.h>
+
+
+// states of the calibration, also reported by !CAL events
+#define CAL_IDLE    0 // no calibration running
+#define CAL_PUTDOWN 1 // waiting for the can to be put on the plate
+#define CAL_SETTLE  2 // waiting for the can to settle (see TCS3200::settled)
+#define CAL_SCAN    3 // scanning the plate
+#define CAL_LIFT    4 // waiting for the can to be lifted from the plate
+#define CAL_DONE    5 // calibration stored (event only)
+#define CAL_FAILED  6 // calibration aborted, nothing stored (event only)
+
+// reasons for CAL_FAILED
+#define CAL_ERR_NONE    0
+#define CAL_ERR_PLATE   1 // first plate not recognized
+#define CAL_ERR_TIMEOUT 2 // can not lifted or put down within CAL_TIMEOUT
+#define CAL_ERR_ABORT   3 // aborted by the host
+#define CAL_ERR_SPREAD  4 // r/b ratios of the scans of a plate spread too much
+#define CAL_ERR_FIT     5 // no unique fit (plates too similar) or quadratic term out of range
+
+// calibration models: calibrated value = quad * r/b^2 + cal[0] * r/b + cal[1], quad being 0 for linear
+#define CAL_LINEAR    1
+#define CAL_QUADRATIC 2
+
+// number of plates: the two calibration plates by default, up to CAL_MAX_PLATES reference plates
+// with given target values (at least one more than the degree of the model)
+#define CAL_PLATES 2
+#define CAL_MAX_PLATES 6
+// each plate is scanned CAL_SCANS times, only red and blue, at the sampling of the current profile such that
+// the calibration has the resolution of the measurements it is used for
+#define CAL_SCANS 5
+// a scan is rejected as outlier if its r/b ratio differs from the median of all scans of the plate
+// by more than CAL_OUTLIER times the median absolute deviation and more than CAL_MAX_DEVIATION
+#define CAL_OUTLIER 3
+// the calibration fails if less than CAL_MIN_SCANS scans are left or if the standard deviation of their
+// r/b ratios is above CAL_MAX_DEVIATION (about 1 value on the Tonino scale, see AVERAGE_THRESHOLD)
+#define CAL_MIN_SCANS 3
+#define CAL_MAX_DEVIATION 0.011
+// interval (ms) for checking whether the can was lifted or put down
+#define CAL_POLL_INTERVAL 100
+// time (ms) to wait for the can to be lifted or put down before the calibration is aborted
+#define CAL_TIMEOUT 60000
+
+
+class ToninoCalibration {
+  public:
+    ToninoCalibration(TCS3200 *colorSense, LCD *display, ToninoConfig *tConfig);
+    ~ToninoCalibration();
+
+    // starts a new calibration with the first plate; a running one is restarted
+    // without targets the two calibration plates are used with LOW_TARGET and HIGH_TARGET and the first one is checked,
+    // otherwise the given number of plates with the given target values; the model is CAL_LINEAR or CAL_QUADRATIC
+    void start(uint8_t plates = CAL_PLATES, uint8_t model = CAL_LINEAR, const float *targets = NULL);
+
+    // true if start() accepts the given number of plates and model
+    static bool isValid(uint8_t plates, uint8_t model);
+
+    // aborts a running calibration; nothing is stored
+    void abort();
+
+    // true while a calibration is running
+    bool active();
+
+    // the current state, one of CAL_xxx, and the plate (0 first, 1 second, ...) it refers to
+    uint8_t getState();
+    uint8_t getPlate();
+
+    // number of plates and model of the last calibration
+    uint8_t getPlates();
+    uint8_t getModel();
+
+    // results of the last calibration for the given plate: mean r/b ratio and its standard deviation
+    // over the scans left after outlier rejection, the number of those scans (0 if not scanned) and
+    // the residual of the fit (target minus calibrated value, 0 if not fitted)
+    float getRatio(uint8_t plate);
+    float getDeviation(uint8_t plate);
+    uint8_t getScans(uint8_t plate);
+    float getResidual(uint8_t plate);
+
+    // executes the next step of the calibration; returns the time (ms) until step() is to be called again
+    // the calibration stored in the configuration is only changed by the last step
+    uint16_t step();
+
+  private:
+    TCS3200 *_colorSense;
+    LCD *_display;
+    ToninoConfig *_tConfig;
+    // current state and plate
+    uint8_t _state;
+    uint8_t _plate;
+    // number of plates, model and target values, see start()
+    uint8_t _plates;
+    uint8_t _model;
+    float _targets[CAL_MAX_PLATES];
+    // true if the first plate is checked to be the low calibration plate
+    bool _checkPlate;
+    // time the current waiting state was entered
+    uint32_t _since;
+    // r/b ratios and sum of the raw red and blue values of the scans taken of the current plate
+    float _ratios[CAL_SCANS];
+    uint8_t _scans;
+    float _red;
+    float _blue;
+    // results per plate, see getRatio
+    float _rb[CAL_MAX_PLATES];
+    float _deviation[CAL_MAX_PLATES];
+    uint8_t _used[CAL_MAX_PLATES];
+    float _residual[CAL_MAX_PLATES];
+
+    // changes to the given state and reports it
+    void enter(uint8_t state);
+    // shows CAL1, CAL2, ... for the current plate
+    void showPlate();
+    // ends the calibration with the given CAL_ERR_xxx reason
+    void fail(uint8_t reason);
+    // takes the next of the CAL_SCANS scans of the current plate
+    void scanOnce();
+    // rejects outliers among the scans of the current plate and checks their spread; returns false if it failed
+    // the last plate completes the calibration which is then fitted and stored
+    bool evaluatePlate();
+    // least squares fit of the model to the ratios and targets of all plates; stores the calibration
+    // and the residuals; returns false if there is no unique fit or the quadratic term is out of range
+    bool fit();
+    // solves the n x n (n <= 3) linear system a * x = b by Gaussian elimination, x is returned in b
+    // returns false if it is singular
+    static bool solve(float a[3][3], float *b, uint8_t n);
+    // median of the first n values of v; v gets sorted
+    static float median(float *v, uint8_t n);
+};
+
+#endif
@@ -0,0 +1,104 @@
+// tonino_clock.cpp
+//----------------
+// CPU clock scaling while sleeping idle
+//
+// *** BSD License ***
+// ------------------------------------------------------------------------------------------
+// Copyright (c) 2016, Paul Holleis, Marko Luther
+// All rights reserved.
+//
+// Authors:  Paul Holleis, Marko Luther
+//
+// Redistribution and use in source and binary forms, with or without modification, are 
+// permitted provided that the following conditions are met:
+//
+//   Redistributions of source code must retain the above copyright notice, this list of 
+//   conditions and the following disclaimer.
+//
+//   Redistributions in binary form must reproduce the above copyright notice, this list 
+//   of conditions and the following disclaimer in the documentation and/or other materials 
+//   provided with the distribution.
+//
+//   Neither the name of the copyright holder(s) nor the names of its contributors may be 
+//   used to endorse or promote products derived from this software without specific prior 
+//   written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS 
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF 
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL 
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) 
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS 
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// ------------------------------------------------------------------------------------------
+
+
+
+#include <tonino_clock.h>
+
+// for ATOMIC_BLOCK, part of avr-libc
+#include <util/atomic.h>
+
+
+boolean ToninoClock::_available = false;
+boolean ToninoClock::_slow = false;
+uint16_t ToninoClock::_ubrrFull = 0;
+uint16_t ToninoClock::_ubrrSlow = 0;
+
+// checks whether the UART can receive at the given baud rate with the slow clock;
+// to be called after each Serial.begin()
+void ToninoClock::init(uint32_t baud) {
+  full();
+  // Serial.begin() uses double speed mode (8 samples per bit) for most rates
+  uint32_t samples = (UCSR0A & bit(U2X0)) ? 8 : 16;
+  uint32_t clock = F_CPU / CLOCK_SLOW_DIV;
+  _ubrrFull = UBRR0;
+  uint32_t ubrr = (clock + samples * baud / 2) / (samples * baud);
+  if (ubrr == 0) {
+    _available = false;
+  } else {
+    uint32_t actual = clock / (samples * ubrr);
+    uint32_t error = (actual > baud ? actual - baud : baud - actual) * 1000 / baud;
+    _available = (error <= CLOCK_MAX_BAUD_ERROR);
+    _ubrrSlow = ubrr - 1;
+  }
+  WRITEDEBUG("slow clock:");
+  WRITEDEBUGLN(_available);
+}
+
+// true if the slow clock can be used at the current baud rate
+boolean ToninoClock::isAvailable() {
+  return _available;
+}
+
+// switches to the slow clock if available and no serial output is pending
+// returns false if the clock was not changed
+boolean ToninoClock::slow() {
+  if (!_available || _slow || (UCSR0B & bit(UDRIE0))) {
+    return false;
+  }
+  // wait for the last byte to be shifted out
+  Serial.flush();
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    clock_prescale_set(clock_div_8);
+    TCCR0B = (TCCR0B & ~(bit(CS02) | bit(CS01) | bit(CS00))) | bit(CS01);  // timer 0: /8
+    UBRR0 = _ubrrSlow;
+    _slow = true;
+  }
+  return true;
+}
+
+// switches back to full speed, to be called right after waking up
+void ToninoClock::full() {
+  if (!_slow) {
+    return;
+  }
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    clock_prescale_set(clock_div_1);
+    TCCR0B = (TCCR0B & ~(bit(CS02) | bit(CS01) | bit(CS00))) | bit(CS01) | bit(CS00);  // timer 0: /64
+    UBRR0 = _ubrrFull;
+    _slow = false;
+  }
+}
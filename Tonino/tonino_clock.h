@@ -0,0 +1,83 @@
+// tonino_clock.h
+//----------------
+// CPU clock scaling while sleeping idle
+//
+// *** BSD License ***
+// ------------------------------------------------------------------------------------------
+// Copyright (c) 2016, Paul Holleis, Marko Luther
+// All rights reserved.
+//
+// Authors:  Paul Holleis, Marko Luther
+//
+// Redistribution and use in source and binary forms, with or without modification, are 
+// permitted provided that the following conditions are met:
+//
+//   Redistributions of source code must retain the above copyright notice, this list of 
+//   conditions and the following disclaimer.
+//
+//   Redistributions in binary form must reproduce the above copyright notice, this list 
+//   of conditions and the following disclaimer in the documentation and/or other materials 
+//   provided with the distribution.
+//
+//   Neither the name of the copyright holder(s) nor the names of its contributors may be 
+//   used to endorse or promote products derived from this software without specific prior 
+//   written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS 
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF 
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL 
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) 
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS 
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// ------------------------------------------------------------------------------------------
+
+
+
+#ifndef _TONINO_CLOCK_H
+#define _TONINO_CLOCK_H
+
+
+#include <tonino.h>
+
+// clock prescaler, built-in, part of avr-libc
+#include <avr/power.h>
+
+
+// the slow clock is F_CPU/8; timer 0 is switched from /64 to /8 at the same time
+// such that millis() and micros() keep their rate
+#define CLOCK_SLOW_DIV 8
+// max. deviation of the baud rate with the slow clock, in 1/1000
+// (at full speed, 115200 baud deviate by 21/1000)
+#define CLOCK_MAX_BAUD_ERROR 25
+
+
+class ToninoClock {
+  public:
+    // checks whether the UART can receive at the given baud rate with the slow clock;
+    // to be called after each Serial.begin()
+    static void init(uint32_t baud);
+
+    // true if the slow clock can be used at the current baud rate
+    static boolean isAvailable();
+
+    // switches to the slow clock if available and no serial output is pending
+    // returns false if the clock was not changed
+    static boolean slow();
+
+    // switches back to full speed, to be called right after waking up
+    static void full();
+
+  private:
+    // true if the slow clock can be used at the current baud rate
+    static boolean _available;
+    // true while running with the slow clock
+    static boolean _slow;
+    // UART baud rate register values for full and slow clock
+    static uint16_t _ubrrFull;
+    static uint16_t _ubrrSlow;
+};
+
+#endif
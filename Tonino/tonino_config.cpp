@@ -37,11 +37,20 @@
 
 #include <tonino_config.h>
 
+// the padding of sensorProfile on other platforms must be at its end, see SENSOR_PROFILE_SIZE
+static_assert(offsetof(sensorProfile, colorMode)+1 == SENSOR_PROFILE_SIZE, "sensorProfile layout");
+// all fields of the extension block must fit into it
+static_assert(EEPROM_CALQUAD_ADDRESS+2*NR_PROFILES <= EEPROM_EXT_START_ADDRESS+EEPROM_EXT_SIZE, "EEPROM extension block");
+
 
 // constructor needs color sensor object for passing parameters
 ToninoConfig::ToninoConfig(TCS3200 *c, LCD *d) :
-  _colorSense(c), _display(d), _doInitCal(true) {
-  // empty
+  _colorSense(c), _display(d), _doInitCal(true), _fastBoot(false), _baudRate(DEFAULT_BAUDRATE),
+  _dimTime(TIME_TILL_DIM/1000), _sleepTime(TIME_TILL_SLEEP/1000), _powerDownTime(TIME_TILL_POWERDOWN/1000), _adaptivePower(DEFAULT_ADAPTIVEPOWER),
+  _throughputMode(DEFAULT_THROUGHPUT), _session(false), _profilesLoaded(true), _activeProfile(0) {
+  for (uint8_t p = 0; p < NR_PROFILES; ++p) {
+    _calQuad[p] = 0;
+  }
 }
 
 ToninoConfig::~ToninoConfig(void) {
@@ -60,56 +69,57 @@ void ToninoConfig::init() {
   }
 }
 
+// load everything skipped by init() in fast boot mode; does nothing otherwise
+void ToninoConfig::initDeferred() {
+  if (_profilesLoaded) {
+    return;
+  }
+  uint8_t active = _activeProfile;
+  for (uint8_t p = 0; p < NR_PROFILES; ++p) {
+    if (p != active) {
+      WRITEDEBUG("Profile ");
+      WRITEDEBUGLN(p);
+      useProfile(p);
+      readProfileParameters();
+    }
+  }
+  useProfile(active);
+  _profilesLoaded = true;
+}
+
 // returns true if the value is not a valid float
 bool ToninoConfig::isInvalidNumber(float f) {
   return isnan(f) || isinf(f) || f > 4294967040.0 || 
          f <-4294967040.0 || f == 0x7fffffff || f == (-0x7fffffff -1L);
 }
 
-// store calibration data to sensor library and EEPROM
-void ToninoConfig::setCalibration(float *cal) {
+// store calibration data and the quadratic term (within +-CAL_QUAD_MAX) to sensor library and EEPROM
+void ToninoConfig::setCalibration(float *cal, float quad) {
   _colorSense->setCalibration(cal);
+  WRITEDEBUGLN("Calib.");
+  writeFloats(profileAddress(_activeProfile, offsetof(sensorProfile, cal)), cal, NR_CAL_VALUES);
 
-  floatByteData_t data;
-  int addr = EEPROM_CAL_ADDRESS;
-  for (int c = 0; c < NR_CAL_VALUES; ++c) {
-    data.f = cal[c];
-    WRITEDEBUG("Calib. ");
-    WRITEDEBUGF(data.f, 6);
-    WRITEDEBUGLN(" as");
-    for (int b = 0; b < 4; ++b) {
-      WRITEDEBUG(data.b[b]);
-      WRITEDEBUG(SEPARATOR);
-      checkedEepromWrite(addr++, data.b[b]);
-    }
-    WRITEDEBUGLN();
+  int16_t q = (int16_t)constrain(quad * CAL_QUAD_SCALE + (quad < 0 ? -0.5 : 0.5), -32767, 32767);
+  if (q == -1) {
+    // 0xFFFF means not set
+    q = 0;
   }
+  _calQuad[_activeProfile] = q;
+  _colorSense->setQuadratic(q / CAL_QUAD_SCALE);
+  writeWord(EEPROM_CALQUAD_ADDRESS + 2*_activeProfile, (uint16_t)q);
 }
 
 // store scaling data to sensor library and EEPROM
 void ToninoConfig::setScaling(float *cal) {
   _colorSense->setScaling(cal);
-
-  floatByteData_t data;
-  int addr = EEPROM_SCALE_ADDRESS;
-  for (int c = 0; c < NR_SCALE_VALUES; ++c) {
-    data.f = cal[c];
-    WRITEDEBUG("Scaling ");
-    WRITEDEBUGF(data.f, 6);
-    WRITEDEBUGLN(" as");
-    for (int b = 0; b < 4; ++b) {
-      WRITEDEBUG(data.b[b]);
-      WRITEDEBUG(SEPARATOR);
-      checkedEepromWrite(addr++, data.b[b]);
-    }
-    WRITEDEBUGLN();
-  }
+  WRITEDEBUGLN("Scaling");
+  writeFloats(profileAddress(_activeProfile, offsetof(sensorProfile, scale)), cal, NR_SCALE_VALUES);
 }
   
 // store sampling rate to sensor library and EEPROM
 void ToninoConfig::setSampling(uint8_t sampling) {
   _colorSense->setSampling(sampling);
-  checkedEepromWrite(EEPROM_SAMPLING_ADDRESS, sampling);
+  checkedEepromWrite(profileAddress(_activeProfile, offsetof(sensorProfile, sampling)), sampling);
 }
 
 // sets and stores the display brightness to EEPROM (0-15, 15=max brightness)
@@ -131,7 +141,107 @@ uint8_t ToninoConfig::getBrightness() {
 // store color mode setting to sensor library and EEPROM
 void ToninoConfig::setColorMode(uint8_t cmode) {
   _colorSense->setColorMode(cmode);
-  checkedEepromWrite(EEPROM_CMODE_ADDRESS, cmode);
+  checkedEepromWrite(profileAddress(_activeProfile, offsetof(sensorProfile, colorMode)), cmode);
+}
+
+// switch to profile p (0..NR_PROFILES-1) and store the selection to EEPROM
+// returns false if p is out of range
+bool ToninoConfig::selectProfile(uint8_t p) {
+  if (p >= NR_PROFILES) {
+    return false;
+  }
+  initDeferred();
+  useProfile(p);
+  checkedEepromWrite(EEPROM_PROFILE_ADDRESS, p);
+  return true;
+}
+
+// get the index of the currently used profile
+uint8_t ToninoConfig::getProfile() {
+  return _activeProfile;
+}
+
+// get the parameters of profile p, NULL if p is out of range
+sensorProfile *ToninoConfig::getProfileData(uint8_t p) {
+  if (p >= NR_PROFILES) {
+    return NULL;
+  }
+  if (p != _activeProfile) {
+    initDeferred();
+  }
+  return (p == 0 ? _colorSense->getDefaultProfile() : &_profiles[p-1]);
+}
+
+// switch to profile p without storing the selection
+// the sensor only gets a pointer to the profile's parameters, nothing is copied
+void ToninoConfig::useProfile(uint8_t p) {
+  _activeProfile = p;
+  _colorSense->setProfile(getProfileData(p));
+  _colorSense->setQuadratic(_calQuad[p] / CAL_QUAD_SCALE);
+}
+
+// EEPROM address of a profile field given by its offset within sensorProfile
+// profile 0 maps to the fields of the original config block
+uint16_t ToninoConfig::profileAddress(uint8_t p, uint8_t offset) {
+  if (p == 0) {
+    switch (offset) {
+      case offsetof(sensorProfile, cal):       return EEPROM_CAL_ADDRESS;
+      case offsetof(sensorProfile, scale):     return EEPROM_SCALE_ADDRESS;
+      case offsetof(sensorProfile, sampling):  return EEPROM_SAMPLING_ADDRESS;
+      default:                                 return EEPROM_CMODE_ADDRESS;
+    }
+  }
+  return EEPROM_PROFILES_ADDRESS + (p-1)*SENSOR_PROFILE_SIZE + offset;
+}
+
+// writes n floats starting at EEPROM address addr
+void ToninoConfig::writeFloats(uint16_t addr, float *vals, uint8_t n) {
+  floatByteData_t data;
+  for (uint8_t c = 0; c < n; ++c) {
+    data.f = vals[c];
+    WRITEDEBUGF(data.f, 6);
+    WRITEDEBUGLN(" as");
+    for (uint8_t b = 0; b < sizeof(data.f); ++b) {
+      WRITEDEBUG(data.b[b]);
+      WRITEDEBUG(SEPARATOR);
+      checkedEepromWrite(addr++, data.b[b]);
+    }
+    WRITEDEBUGLN();
+  }
+}
+
+// reads n floats starting at EEPROM address addr; returns false if not set or invalid
+bool ToninoConfig::readFloats(uint16_t addr, float *vals, uint8_t n) {
+  floatByteData_t data;
+  bool unknown = true;
+  for (uint8_t c = 0; c < n; ++c) {
+    for (uint8_t b = 0; b < sizeof(data.f); ++b) {
+      data.b[b] = checkedEepromRead(addr++);
+      if (data.b[b] != 255) {
+        unknown = false;
+      }
+      WRITEDEBUG(data.b[b]);
+      WRITEDEBUG(SEPARATOR);
+    }
+    WRITEDEBUGLNF(data.f, 6);
+    if (isInvalidNumber(data.f)) {
+      WRITEDEBUGLN("err->default");
+      return false;
+    }
+    vals[c] = data.f;
+  }
+  return !unknown;
+}
+
+// writes a 16 bit value (LSB first) to EEPROM address addr
+void ToninoConfig::writeWord(uint16_t addr, uint16_t val) {
+  checkedEepromWrite(addr, val & 0xFF);
+  checkedEepromWrite(addr+1, val >> 8);
+}
+
+// reads a 16 bit value (LSB first) from EEPROM address addr; 0xFFFF if not set
+uint16_t ToninoConfig::readWord(uint16_t addr) {
+  return checkedEepromRead(addr) | ((uint16_t)checkedEepromRead(addr+1) << 8);
 }
 
 // store whether initial calibration is tried setting to local variable and EEPROM
@@ -156,21 +266,330 @@ uint8_t ToninoConfig::getDelayTillUpTest() {
   return _delayTillUpTest;
 }
 
+// store whether to boot fast (no start animation, deferred loading) to local variable and EEPROM
+void ToninoConfig::setFastBoot(bool fb) {
+  _fastBoot = fb;
+  checkedEepromWrite(EEPROM_FASTBOOT_ADDRESS, fb ? 1 : 0);
+}
+
+// get fast boot setting
+bool ToninoConfig::getFastBoot() {
+  return _fastBoot;
+}
+
+// supported serial baud rates; the EEPROM holds the index into this list
+// 0 replaces 230400, keeping the indices of the following rates: at 16MHz the UART gets
+// no closer than 222222 baud (-3.5%), too far off for a reliable connection
+static const uint32_t baudRates[NR_BAUDRATES] PROGMEM = {
+  9600, 19200, 38400, 57600, 115200, 0, 250000, 500000, 1000000
+};
+
+// returns the index of baud within the supported baud rates or -1 if not supported
+int8_t ToninoConfig::baudRateIndex(uint32_t baud) {
+  if (baud == 0) {
+    return -1;
+  }
+  for (int8_t i = 0; i < NR_BAUDRATES; ++i) {
+    if (pgm_read_dword(&baudRates[i]) == baud) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+// store the serial baud rate to be used after reset to local variable and EEPROM
+// returns false if the rate is not supported (9600 to 1000000)
+bool ToninoConfig::setBaudRate(uint32_t baud) {
+  int8_t i = baudRateIndex(baud);
+  if (i < 0) {
+    return false;
+  }
+  _baudRate = baud;
+  checkedEepromWrite(EEPROM_BAUDRATE_ADDRESS, i);
+  return true;
+}
+
+// get serial baud rate used after reset
+uint32_t ToninoConfig::getBaudRate() {
+  return _baudRate;
+}
+
+// store the times without action (in seconds) after which the display is dimmed, the Tonino
+// goes to sleep and powers down to local variables and EEPROM
+// returns false unless 0 < dim < sleep < powerDown
+bool ToninoConfig::setPowerTimes(uint16_t dim, uint16_t sleep, uint16_t powerDown) {
+  if (dim == 0 || dim >= sleep || sleep >= powerDown) {
+    return false;
+  }
+  _dimTime = dim;
+  _sleepTime = sleep;
+  _powerDownTime = powerDown;
+  writeWord(EEPROM_POWER_ADDRESS, dim);
+  writeWord(EEPROM_POWER_ADDRESS+2, sleep);
+  writeWord(EEPROM_POWER_ADDRESS+4, powerDown);
+  return true;
+}
+
+// get the time without action (in seconds) after which the display is dimmed
+uint16_t ToninoConfig::getDimTime() {
+  return _dimTime;
+}
+
+// get the time without action (in seconds) after which the Tonino goes to sleep
+uint16_t ToninoConfig::getSleepTime() {
+  return _sleepTime;
+}
+
+// get the time without action (in seconds) after which the Tonino powers down
+uint16_t ToninoConfig::getPowerDownTime() {
+  return _powerDownTime;
+}
+
+// store whether the power times are adapted to the observed usage (see ToninoPower) to local variable and EEPROM
+void ToninoConfig::setAdaptivePower(bool ap) {
+  _adaptivePower = ap;
+  checkedEepromWrite(EEPROM_ADAPTIVEPOWER_ADDRESS, ap ? 1 : 0);
+}
+
+// get adaptive power setting
+bool ToninoConfig::getAdaptivePower() {
+  return _adaptivePower;
+}
+
+// store whether the throughput mode (scan without animations as soon as the can settled) is on to local variable and EEPROM
+void ToninoConfig::setThroughputMode(bool tm) {
+  _throughputMode = tm;
+  checkedEepromWrite(EEPROM_THROUGHPUT_ADDRESS, tm ? 1 : 0);
+}
+
+// get throughput mode setting
+bool ToninoConfig::getThroughputMode() {
+  return _throughputMode;
+}
+
+
+// returns true if all values of the profile are within their valid ranges
+bool ToninoConfig::isValidProfile(const sensorProfile *profile) {
+  if (profile->sampling == 0 || profile->sampling > 100 ||
+      profile->colorMode == 0 || profile->colorMode > COLOR_FULL) {
+    return false;
+  }
+  for (uint8_t i = 0; i < NR_CAL_VALUES; ++i) {
+    if (isInvalidNumber(profile->cal[i])) return false;
+  }
+  for (uint8_t i = 0; i < NR_SCALE_VALUES; ++i) {
+    if (isInvalidNumber(profile->scale[i])) return false;
+  }
+  return true;
+}
+
+// CRC-CCITT checksum of n bytes
+uint16_t ToninoConfig::crc(const uint8_t *buf, uint16_t n) {
+  uint16_t c = 0xFFFF;
+  for (uint16_t i = 0; i < n; ++i) {
+    c = _crc_ccitt_update(c, buf[i]);
+  }
+  return c;
+}
+
+// 16 bit values of the config blob are stored LSB first
+static void putBlobWord(uint8_t *buf, uint16_t w) {
+  buf[0] = w & 0xFF;
+  buf[1] = w >> 8;
+}
+
+static uint16_t getBlobWord(const uint8_t *buf) {
+  return buf[0] | ((uint16_t)buf[1] << 8);
+}
+
+// writes the complete configuration as CONFIG_BLOB_SIZE bytes to buf
+void ToninoConfig::exportConfig(uint8_t *buf) {
+  uint16_t pos = 0;
+  buf[pos++] = CONFIG_BLOB_VERSION;
+  buf[pos++] = CONFIG_BLOB_PAYLOAD;
+  buf[pos++] = getBrightness();
+  buf[pos++] = _doInitCal ? 1 : 0;
+  buf[pos++] = _delayTillUpTest;
+  buf[pos++] = _activeProfile;
+  buf[pos++] = _fastBoot ? 1 : 0;
+  putBlobWord(buf + pos, _dimTime);
+  putBlobWord(buf + pos + 2, _sleepTime);
+  putBlobWord(buf + pos + 4, _powerDownTime);
+  pos += 6;
+  buf[pos++] = _adaptivePower ? 1 : 0;
+  buf[pos++] = _throughputMode ? 1 : 0;
+  for (uint8_t p = 0; p < NR_PROFILES; ++p) {
+    memcpy(buf + pos, getProfileData(p), SENSOR_PROFILE_SIZE);
+    putBlobWord(buf + pos + SENSOR_PROFILE_SIZE, (uint16_t)_calQuad[p]);
+    pos += CONFIG_BLOB_PROFILE_SIZE;
+  }
+  uint16_t c = crc(buf, pos);
+  buf[pos++] = c & 0xFF;
+  buf[pos] = c >> 8;
+}
+
+// validates a configuration blob created by exportConfig (or a version 2 or 3 blob) and, only if
+// the version, length, checksum and all values are valid, applies and stores it
+// returns false if the blob was rejected
+bool ToninoConfig::importConfig(const uint8_t *buf, uint16_t len) {
+  // validate everything before anything is changed
+  // version 2 lacks the power times, adaptive power and throughput mode, which are left unchanged,
+  // versions 2 and 3 lack the quadratic calibration terms
+  uint8_t version = (len > CONFIG_BLOB_HEADER ? buf[0] : 0);
+  uint8_t settings = (version == 2 ? CONFIG_BLOB_V2_SETTINGS : CONFIG_BLOB_SETTINGS);
+  uint8_t profileSize = (version == CONFIG_BLOB_VERSION ? CONFIG_BLOB_PROFILE_SIZE : SENSOR_PROFILE_SIZE);
+  uint8_t payloadLen = settings + NR_PROFILES*profileSize;
+  uint16_t size = CONFIG_BLOB_HEADER + payloadLen + 2;
+  if (version < 2 || version > CONFIG_BLOB_VERSION || len != size || buf[1] != payloadLen) {
+    WRITEDEBUGLN("conf:version");
+    return false;
+  }
+  uint16_t c = crc(buf, size-2);
+  if ((c & 0xFF) != buf[size-2] || (c >> 8) != buf[size-1]) {
+    WRITEDEBUGLN("conf:crc");
+    return false;
+  }
+  const uint8_t *payload = buf + CONFIG_BLOB_HEADER;
+  if (payload[0] > 15 || payload[1] > 1 || payload[3] >= NR_PROFILES || payload[4] > 1) {
+    WRITEDEBUGLN("conf:range");
+    return false;
+  }
+  uint16_t dim = _dimTime, sleep = _sleepTime, powerDown = _powerDownTime;
+  bool adaptive = _adaptivePower, throughput = _throughputMode;
+  if (version != 2) {
+    dim = getBlobWord(payload + 5);
+    sleep = getBlobWord(payload + 7);
+    powerDown = getBlobWord(payload + 9);
+    adaptive = (payload[11] == 1);
+    throughput = (payload[12] == 1);
+    if (dim == 0 || dim >= sleep || sleep >= powerDown || payload[11] > 1 || payload[12] > 1) {
+      WRITEDEBUGLN("conf:settings");
+      return false;
+    }
+  }
+  sensorProfile profile;
+  for (uint8_t p = 0; p < NR_PROFILES; ++p) {
+    const uint8_t *data = payload + settings + p*profileSize;
+    memcpy(&profile, data, SENSOR_PROFILE_SIZE);
+    // the quadratic term is stored within +-32767, see setCalibration
+    if (!isValidProfile(&profile) ||
+        (profileSize == CONFIG_BLOB_PROFILE_SIZE && getBlobWord(data + SENSOR_PROFILE_SIZE) == 0x8000)) {
+      WRITEDEBUGLN("conf:profile");
+      return false;
+    }
+  }
+
+  // apply and store
+  setBrightness(payload[0]);
+  setCheckCalInit(payload[1] == 1);
+  setDelayTillUpTest(payload[2]);
+  setFastBoot(payload[4] == 1);
+  setPowerTimes(dim, sleep, powerDown);
+  setAdaptivePower(adaptive);
+  setThroughputMode(throughput);
+  for (uint8_t p = 0; p < NR_PROFILES; ++p) {
+    const uint8_t *data = payload + settings + p*profileSize;
+    memcpy(&profile, data, SENSOR_PROFILE_SIZE);
+    int16_t quad = (profileSize == CONFIG_BLOB_PROFILE_SIZE ? (int16_t)getBlobWord(data + SENSOR_PROFILE_SIZE) : 0);
+    useProfile(p);
+    setSampling(profile.sampling);
+    setColorMode(profile.colorMode);
+    setCalibration(profile.cal, quad / CAL_QUAD_SCALE);
+    setScaling(profile.scale);
+  }
+  _profilesLoaded = true;
+  selectProfile(payload[3]);
+  return true;
+}
+
+
+// start a session: from now on all setters only change the in-RAM state, nothing is written to EEPROM
+void ToninoConfig::beginSession() {
+  // profiles not yet loaded would otherwise be read (and possibly corrected) during the session
+  initDeferred();
+  _session = true;
+}
+
+// end the session and store the complete in-RAM state to EEPROM (only changed bytes are written)
+// returns false if no session is active
+bool ToninoConfig::commitSession() {
+  if (!_session) {
+    return false;
+  }
+  _session = false;
+  setBrightness(getBrightness());
+  setCheckCalInit(_doInitCal);
+  setDelayTillUpTest(_delayTillUpTest);
+  setFastBoot(_fastBoot);
+  setBaudRate(_baudRate);
+  setPowerTimes(_dimTime, _sleepTime, _powerDownTime);
+  setAdaptivePower(_adaptivePower);
+  setThroughputMode(_throughputMode);
+  uint8_t active = _activeProfile;
+  for (uint8_t p = 0; p < NR_PROFILES; ++p) {
+    useProfile(p);
+    sensorProfile *profile = getProfileData(p);
+    setSampling(profile->sampling);
+    setColorMode(profile->colorMode);
+    setCalibration(profile->cal, _calQuad[p] / CAL_QUAD_SCALE);
+    setScaling(profile->scale);
+  }
+  selectProfile(active);
+  return true;
+}
+
+// end the session and reload all settings from EEPROM, discarding all changes made since beginSession()
+// returns false if no session is active
+bool ToninoConfig::revertSession() {
+  if (!_session) {
+    return false;
+  }
+  _session = false;
+  readStoredParameters();
+  return true;
+}
+
+// true while a session is active
+bool ToninoConfig::inSession() {
+  return _session;
+}
 
 // stores default config values in EEPROM and sets local vars and sensor library values accordingly
 // should only be used if isEepromChanged() returned false
 void ToninoConfig::writeDefaults() {
   WRITEDEBUGLN("Store def");
-  WRITEDEBUG("Sampling: ");
-  setSampling(DEFAULT_SAMPLING);
   WRITEDEBUG("Bright: ");
   setBrightness(DEFAULT_BRIGHTNESS);
-  WRITEDEBUG("Col mode: ");
-  setColorMode(DEFAULT_COLORS);
   WRITEDEBUG("Do_init_cal: ");
   setCheckCalInit(DEFAULT_DOCALINIT);
   WRITEDEBUG("Delay_till_up: ");
   setDelayTillUpTest(DEFAULT_DELAYTILLUPTEST);
+  WRITEDEBUG("Fast_boot: ");
+  setFastBoot(DEFAULT_FASTBOOT);
+  WRITEDEBUG("Baud: ");
+  setBaudRate(DEFAULT_BAUDRATE);
+  WRITEDEBUG("Power: ");
+  setPowerTimes(TIME_TILL_DIM/1000, TIME_TILL_SLEEP/1000, TIME_TILL_POWERDOWN/1000);
+  setAdaptivePower(DEFAULT_ADAPTIVEPOWER);
+  WRITEDEBUG("Throughput: ");
+  setThroughputMode(DEFAULT_THROUGHPUT);
+
+  for (int8_t p = NR_PROFILES-1; p >= 0; --p) {
+    WRITEDEBUG("Profile ");
+    WRITEDEBUGLN(p);
+    useProfile(p);
+    writeProfileDefaults();
+  }
+  _profilesLoaded = true;
+  selectProfile(0);
+}
+
+// store default parameters to the currently used profile
+void ToninoConfig::writeProfileDefaults() {
+  WRITEDEBUG("Sampling: ");
+  setSampling(DEFAULT_SAMPLING);
+  WRITEDEBUG("Col mode: ");
+  setColorMode(DEFAULT_COLORS);
 
   float cal[MAX_CAL_VARS];
   #if NR_CAL_VALUES == 2
@@ -200,11 +619,22 @@ void ToninoConfig::writeDefaults() {
 }
 
 
+// distance between the redundant copies of the EEPROM block containing addr
+inline uint16_t ToninoConfig::eepromStride(uint16_t addr) {
+  return (addr < EEPROM_EXT_START_ADDRESS) ? EEPROM_SIZE : EEPROM_EXT_SIZE;
+}
+
 // writes val to EEPROM address addr but only if the stored value is different
-bool ToninoConfig::checkedEepromWrite(uint8_t addr, uint8_t val) {
+// nothing is written during a session
+bool ToninoConfig::checkedEepromWrite(uint16_t addr, uint8_t val) {
+  if (_session) {
+    // kept in RAM only until commitSession()
+    return false;
+  }
+
   // save that EEPROM has been changed
   for (uint8_t cyc = 0; cyc < EEPROM_REDUNDANT_CYCLES+1; cyc++) {
-    uint8_t raddr = EEPROM_CHANGED_ADDRESS + cyc*EEPROM_SIZE;
+    uint16_t raddr = EEPROM_CHANGED_ADDRESS + cyc*EEPROM_SIZE;
     if (EEPROM.read(raddr) != EEPROM_SET) {
       WRITEDEBUG("upd addr ");
       WRITEDEBUG(raddr);
@@ -220,8 +650,9 @@ bool ToninoConfig::checkedEepromWrite(uint8_t addr, uint8_t val) {
   WRITEDEBUGLN();
 
   bool changed = false;
+  uint16_t stride = eepromStride(addr);
   for (uint8_t cyc = 0; cyc < EEPROM_REDUNDANT_CYCLES+1; cyc++) {
-    uint8_t raddr = addr + (cyc*EEPROM_SIZE);
+    uint16_t raddr = addr + cyc*stride;
     WRITEDEBUG("read addr ");
     WRITEDEBUG(raddr);
     WRITEDEBUG(":");
@@ -279,11 +710,12 @@ bool ToninoConfig::getMostFrequent(uint8_t *vals, uint8_t *val) {
 }
 
 // reads value at given address
-uint8_t ToninoConfig::checkedEepromRead(uint8_t addr) {
+uint8_t ToninoConfig::checkedEepromRead(uint16_t addr) {
   uint8_t vals[EEPROM_REDUNDANT_CYCLES+1];
+  uint16_t stride = eepromStride(addr);
   WRITEDEBUG("read");
   for (uint8_t cyc = 0; cyc < EEPROM_REDUNDANT_CYCLES+1; cyc++) {
-    uint8_t raddr = addr + cyc*EEPROM_SIZE;
+    uint16_t raddr = addr + cyc*stride;
     WRITEDEBUG(" addr ");
     WRITEDEBUG(raddr);
     WRITEDEBUG(":");
@@ -319,16 +751,7 @@ inline bool ToninoConfig::isEepromChanged() {
 // if some settings have not been set, uses and stores default values
 void ToninoConfig::readStoredParameters() {
   WRITEDEBUGLN("Read EEPROM");
-  // sampling rate
-  WRITEDEBUG("Sampling:");
-  uint8_t value = checkedEepromRead(EEPROM_SAMPLING_ADDRESS);
-  if (value > 100) {
-    setSampling(DEFAULT_SAMPLING);
-  } else {
-    setSampling(value);
-  }
-  WRITEDEBUG(_colorSense->getSampling());
-  WRITEDEBUGLN();
+  uint8_t value;
 
   // display brightness
   WRITEDEBUG("Bright:");
@@ -345,17 +768,6 @@ void ToninoConfig::readStoredParameters() {
 	}
   WRITEDEBUGLN();
 
-  // color mode
-  WRITEDEBUG("Col mode:");
-  value = checkedEepromRead(EEPROM_CMODE_ADDRESS);
-  if (value == 0 || value > COLOR_FULL) {
-    setColorMode(DEFAULT_COLORS);
-  } else {
-    setColorMode(value);
-  }
-  WRITEDEBUG(_colorSense->getColorMode());
-  WRITEDEBUGLN();
-
   // setting for initial calibration
   WRITEDEBUG("Do_init_cal:");
   value = checkedEepromRead(EEPROM_CCI_ADDRESS);
@@ -378,31 +790,108 @@ void ToninoConfig::readStoredParameters() {
   WRITEDEBUG(_delayTillUpTest);
   WRITEDEBUGLN("*100ms");
 
-  // calibration
-  floatByteData_t data;
-  float cal[MAX_CAL_VARS];
+  // fast boot
+  WRITEDEBUG("Fast_boot:");
+  value = checkedEepromRead(EEPROM_FASTBOOT_ADDRESS);
+  if (value == 255) {
+    setFastBoot(DEFAULT_FASTBOOT);
+  } else {
+    setFastBoot(value == 0 ? false : true);
+  }
+  WRITEDEBUGLN(_fastBoot ? 1 : 0);
 
-  uint8_t addr = EEPROM_CAL_ADDRESS;
-  bool unknown = true;
-  WRITEDEBUGLN("Calib.:");
-  for (int c = 0; c < NR_CAL_VALUES; ++c) {
-    for (int b = 0; b < sizeof(data.f); ++b) {
-      data.b[b] = checkedEepromRead(addr++);
-      if (data.b[b] != 255) {
-        unknown = false;
-      }
-      WRITEDEBUG(data.b[b]);
-      WRITEDEBUG(SEPARATOR);
-    }
-    WRITEDEBUGLNF(data.f, 6);
-    if (isInvalidNumber(data.f)) {
-      unknown = true;
-      WRITEDEBUGLN("err->default");
-      break;
+  // serial baud rate
+  WRITEDEBUG("Baud:");
+  value = checkedEepromRead(EEPROM_BAUDRATE_ADDRESS);
+  if (value < NR_BAUDRATES && pgm_read_dword(&baudRates[value]) != 0) {
+    _baudRate = pgm_read_dword(&baudRates[value]);
+  } else {
+    setBaudRate(DEFAULT_BAUDRATE);
+  }
+  WRITEDEBUGLN(_baudRate);
+
+  // power times
+  WRITEDEBUG("Power:");
+  if (!setPowerTimes(readWord(EEPROM_POWER_ADDRESS), readWord(EEPROM_POWER_ADDRESS+2), readWord(EEPROM_POWER_ADDRESS+4))) {
+    // not set or invalid
+    setPowerTimes(TIME_TILL_DIM/1000, TIME_TILL_SLEEP/1000, TIME_TILL_POWERDOWN/1000);
+  }
+  WRITEDEBUG(_dimTime);
+  WRITEDEBUG(SEPARATOR);
+  WRITEDEBUG(_sleepTime);
+  WRITEDEBUG(SEPARATOR);
+  WRITEDEBUGLN(_powerDownTime);
+
+  // adaptive power
+  WRITEDEBUG("Adaptive_power:");
+  value = checkedEepromRead(EEPROM_ADAPTIVEPOWER_ADDRESS);
+  if (value == 255) {
+    setAdaptivePower(DEFAULT_ADAPTIVEPOWER);
+  } else {
+    setAdaptivePower(value == 0 ? false : true);
+  }
+  WRITEDEBUGLN(_adaptivePower ? 1 : 0);
+
+  // throughput mode
+  WRITEDEBUG("Throughput:");
+  value = checkedEepromRead(EEPROM_THROUGHPUT_ADDRESS);
+  if (value == 255) {
+    setThroughputMode(DEFAULT_THROUGHPUT);
+  } else {
+    setThroughputMode(value == 0 ? false : true);
+  }
+  WRITEDEBUGLN(_throughputMode ? 1 : 0);
+
+  // selected profile
+  WRITEDEBUG("Profile:");
+  value = checkedEepromRead(EEPROM_PROFILE_ADDRESS);
+  uint8_t active = (value < NR_PROFILES ? value : 0);
+  WRITEDEBUGLN(active);
+
+  // all profiles, unused ones are filled with default values;
+  // in fast boot mode only the selected one, the others are read by initDeferred()
+  for (int8_t p = NR_PROFILES-1; p >= 0; --p) {
+    if (!_fastBoot || p == active) {
+      WRITEDEBUG("Profile ");
+      WRITEDEBUGLN(p);
+      useProfile(p);
+      readProfileParameters();
     }
-    cal[c] = data.f;
   }
-  if (unknown) {
+  _profilesLoaded = !_fastBoot;
+  useProfile(active);
+  checkedEepromWrite(EEPROM_PROFILE_ADDRESS, active);
+}
+
+// read the parameters of the currently used profile from EEPROM
+// if some settings have not been set, uses and stores default values
+void ToninoConfig::readProfileParameters() {
+  // sampling rate
+  WRITEDEBUG("Sampling:");
+  uint8_t value = checkedEepromRead(profileAddress(_activeProfile, offsetof(sensorProfile, sampling)));
+  if (value > 100) {
+    setSampling(DEFAULT_SAMPLING);
+  } else {
+    setSampling(value);
+  }
+  WRITEDEBUG(_colorSense->getSampling());
+  WRITEDEBUGLN();
+
+  // color mode
+  WRITEDEBUG("Col mode:");
+  value = checkedEepromRead(profileAddress(_activeProfile, offsetof(sensorProfile, colorMode)));
+  if (value == 0 || value > COLOR_FULL) {
+    setColorMode(DEFAULT_COLORS);
+  } else {
+    setColorMode(value);
+  }
+  WRITEDEBUG(_colorSense->getColorMode());
+  WRITEDEBUGLN();
+
+  // calibration
+  float cal[MAX_CAL_VARS];
+  WRITEDEBUGLN("Calib.:");
+  if (!readFloats(profileAddress(_activeProfile, offsetof(sensorProfile, cal)), cal, NR_CAL_VALUES)) {
     // no calib has been written, use some default
     #if NR_CAL_VALUES == 2
       cal[0] = DEFAULT_CAL_0;
@@ -413,29 +902,11 @@ void ToninoConfig::readStoredParameters() {
       }
     #endif
   }
-  setCalibration(cal);
+  uint16_t quad = readWord(EEPROM_CALQUAD_ADDRESS + 2*_activeProfile);
+  setCalibration(cal, (quad == 0xFFFF ? 0.0 : (int16_t)quad / CAL_QUAD_SCALE));
 
-  addr = EEPROM_SCALE_ADDRESS;
-  unknown = true;
   WRITEDEBUGLN("Scale:");
-  for (int c = 0; c < NR_SCALE_VALUES; ++c) {
-    for (int b = 0; b < sizeof(data.f); ++b) {
-      data.b[b] = checkedEepromRead(addr++);
-      if (data.b[b] != 255) {
-        unknown = false;
-      }
-      WRITEDEBUG(data.b[b]);
-      WRITEDEBUG(SEPARATOR);
-    }
-    WRITEDEBUGLNF(data.f, 6);
-    if (isInvalidNumber(data.f)) {
-      unknown = true;
-      WRITEDEBUGLN("err->default");
-      break;
-    }
-    cal[c] = data.f;
-  }
-  if (unknown) {
+  if (!readFloats(profileAddress(_activeProfile, offsetof(sensorProfile, scale)), cal, NR_SCALE_VALUES)) {
 #if NR_SCALE_VALUES == 3
     cal[0] = DEFAULT_SCALE_0;
     cal[1] = DEFAULT_SCALE_1;
@@ -44,6 +44,10 @@
 
 // lib to access EEPROM, built-in, see http://arduino.cc/en/Reference/EEPROM
 #include <EEPROM.h>
+// for offsetof
+#include <stddef.h>
+// CRC for config blobs, part of avr-libc
+#include <util/crc16.h>
 
 
 #define EEPROM_SET 42
@@ -59,6 +63,48 @@
 #define EEPROM_SCALE_ADDRESS           (NR_CAL_VALUES*4+EEPROM_CAL_ADDRESS)
 #define EEPROM_SIZE                    (NR_SCALE_VALUES*4+EEPROM_SCALE_ADDRESS-EEPROM_START_ADDRESS)
 
+// extension block for settings added later; stored redundantly like the block above,
+// but with a fixed size such that new fields can be appended without moving existing data
+#define EEPROM_EXT_START_ADDRESS       (EEPROM_START_ADDRESS+(EEPROM_REDUNDANT_CYCLES+1)*EEPROM_SIZE)
+#define EEPROM_EXT_SIZE                100
+#define EEPROM_PROFILE_ADDRESS         (EEPROM_EXT_START_ADDRESS)
+#define EEPROM_PROFILES_ADDRESS        (EEPROM_PROFILE_ADDRESS+1)
+#define EEPROM_FASTBOOT_ADDRESS        (EEPROM_PROFILES_ADDRESS+(NR_PROFILES-1)*SENSOR_PROFILE_SIZE)
+#define EEPROM_BAUDRATE_ADDRESS        (EEPROM_FASTBOOT_ADDRESS+1)
+#define EEPROM_POWER_ADDRESS           (EEPROM_BAUDRATE_ADDRESS+1)
+#define EEPROM_ADAPTIVEPOWER_ADDRESS   (EEPROM_POWER_ADDRESS+3*2)
+#define EEPROM_THROUGHPUT_ADDRESS      (EEPROM_ADAPTIVEPOWER_ADDRESS+1)
+#define EEPROM_CALQUAD_ADDRESS         (EEPROM_THROUGHPUT_ADDRESS+1)
+// the quadratic calibration term of each profile is stored as 16 bit value in units of 1/CAL_QUAD_SCALE
+#define CAL_QUAD_SCALE 20000.0
+#define CAL_QUAD_MAX (32767/CAL_QUAD_SCALE)
+// first address after all copies of the extension block
+#define EEPROM_EXT_END_ADDRESS         (EEPROM_EXT_START_ADDRESS+(EEPROM_REDUNDANT_CYCLES+1)*EEPROM_EXT_SIZE)
+
+// number of supported serial baud rates (see setBaudRate)
+#define NR_BAUDRATES 9
+
+// number of parameter profiles (calibration, scaling, sampling, color mode)
+// profile 0 is stored in the original config block, all others in the extension block
+#define NR_PROFILES 4
+
+// binary export of the complete configuration (see exportConfig/importConfig):
+// version, payload length, brightness, check cal. init, delay till up test,
+// selected profile, fast boot, power times (3 words), adaptive power, throughput mode,
+// all profiles each followed by its quadratic calibration term (word, see CAL_QUAD_SCALE),
+// CRC-CCITT of all preceding bytes (LSB first)
+#define CONFIG_BLOB_VERSION 4
+#define CONFIG_BLOB_HEADER  2
+#define CONFIG_BLOB_SETTINGS 13
+#define CONFIG_BLOB_PROFILE_SIZE (SENSOR_PROFILE_SIZE+2)
+#define CONFIG_BLOB_PAYLOAD (CONFIG_BLOB_SETTINGS+NR_PROFILES*CONFIG_BLOB_PROFILE_SIZE)
+#define CONFIG_BLOB_SIZE    (CONFIG_BLOB_HEADER+CONFIG_BLOB_PAYLOAD+2)
+// version 3 blobs lack the quadratic terms, which importConfig sets to 0 as their calibrations are linear
+#define CONFIG_BLOB_V3_PAYLOAD (CONFIG_BLOB_SETTINGS+NR_PROFILES*SENSOR_PROFILE_SIZE)
+// version 2 blobs also end the settings after fast boot; importConfig keeps the newer settings for them
+#define CONFIG_BLOB_V2_SETTINGS 5
+#define CONFIG_BLOB_V2_PAYLOAD (CONFIG_BLOB_V2_SETTINGS+NR_PROFILES*SENSOR_PROFILE_SIZE)
+
 // used to convert a number from float to bytes and vv for EEPROM
 union floatByteData_t {
    float f;
@@ -73,11 +119,16 @@ class ToninoConfig {
     ~ToninoConfig(void);
 
     // look if EEPROM has been used and load values, or store defaults otherwise
+    // in fast boot mode only the selected profile is loaded, see initDeferred()
     void init();
+
+    // load everything skipped by init() in fast boot mode; does nothing otherwise
+    void initDeferred();
   
 
-    // store calibration data to sensor library and EEPROM
-    void setCalibration(float *cal);
+    // store calibration data and the quadratic term (within +-CAL_QUAD_MAX) to sensor library and EEPROM
+    // a linear calibration (quad 0) clears the quadratic term of the profile
+    void setCalibration(float *cal, float quad = 0.0);
 
     // store scaling data to sensor library and EEPROM
     void setScaling(float *cal);
@@ -94,6 +145,16 @@ class ToninoConfig {
     // store color mode setting to sensor library and EEPROM
     void setColorMode(uint8_t cmode);
 
+    // switch to profile p (0..NR_PROFILES-1) and store the selection to EEPROM
+    // returns false if p is out of range
+    bool selectProfile(uint8_t p);
+
+    // get the index of the currently used profile
+    uint8_t getProfile();
+
+    // get the parameters of profile p, NULL if p is out of range
+    sensorProfile *getProfileData(uint8_t p);
+
     // store whether initial calibration is tried setting to local variable and EEPROM
     void setCheckCalInit(bool iwc);
 
@@ -106,24 +167,129 @@ class ToninoConfig {
     // get delay time (ATTENTION: in 100ms i.e. 1/10sec) to wait between test measurements whether cup was lifted
     uint8_t getDelayTillUpTest();
 
+    // store whether to boot fast (no start animation, deferred loading) to local variable and EEPROM
+    void setFastBoot(bool fb);
+
+    // get fast boot setting
+    bool getFastBoot();
+
+    // store the serial baud rate to be used after reset to local variable and EEPROM
+    // returns false if the rate is not supported (9600 to 1000000)
+    bool setBaudRate(uint32_t baud);
+
+    // get serial baud rate used after reset
+    uint32_t getBaudRate();
+
+    // returns the index of baud within the supported baud rates or -1 if not supported
+    static int8_t baudRateIndex(uint32_t baud);
+
+    // store the times without action (in seconds) after which the display is dimmed, the Tonino
+    // goes to sleep and powers down to local variables and EEPROM
+    // returns false unless 0 < dim < sleep < powerDown
+    bool setPowerTimes(uint16_t dim, uint16_t sleep, uint16_t powerDown);
+
+    // get the time without action (in seconds) after which the display is dimmed
+    uint16_t getDimTime();
+
+    // get the time without action (in seconds) after which the Tonino goes to sleep
+    uint16_t getSleepTime();
+
+    // get the time without action (in seconds) after which the Tonino powers down
+    uint16_t getPowerDownTime();
+
+    // store whether the power times are adapted to the observed usage (see ToninoPower) to local variable and EEPROM
+    void setAdaptivePower(bool ap);
+
+    // get adaptive power setting
+    bool getAdaptivePower();
+
+    // store whether the throughput mode (scan without animations as soon as the can settled) is on to local variable and EEPROM
+    void setThroughputMode(bool tm);
+
+    // get throughput mode setting
+    bool getThroughputMode();
+
+    // writes the complete configuration as CONFIG_BLOB_SIZE bytes to buf
+    void exportConfig(uint8_t *buf);
+
+    // validates a configuration blob created by exportConfig (or a version 2 blob) and, only if
+    // the version, length, checksum and all values are valid, applies and stores it
+    // returns false if the blob was rejected
+    bool importConfig(const uint8_t *buf, uint16_t len);
+
+    // start a session: from now on all setters only change the in-RAM state, nothing is written to EEPROM
+    void beginSession();
+
+    // end the session and store the complete in-RAM state to EEPROM (only changed bytes are written)
+    // returns false if no session is active
+    bool commitSession();
+
+    // end the session and reload all settings from EEPROM, discarding all changes made since beginSession()
+    // returns false if no session is active
+    bool revertSession();
+
+    // true while a session is active
+    bool inSession();
+
     // stores default config values in EEPROM and sets local vars and sensor library values accordingly
     // should only be used if isEepromChanged() returned false
     void writeDefaults();
 
+    // CRC-CCITT checksum of n bytes
+    static uint16_t crc(const uint8_t *buf, uint16_t n);
+
   private:
     TCS3200 *_colorSense;
     LCD *_display;
     
     // returns true if the value is not a valid float
     static bool isInvalidNumber(float f);
+    // returns true if all values of the profile are within their valid ranges
+    static bool isValidProfile(const sensorProfile *profile);
     // whether or not to do initial white calibration
     bool _doInitCal;
     // delay between "can up" measurements
     uint8_t _delayTillUpTest;
-    // writes val to EEPROM address addr but only if the stored value is different
-    bool checkedEepromWrite(uint8_t addr, uint8_t val);
+    // whether to boot fast
+    bool _fastBoot;
+    // serial baud rate used after reset
+    uint32_t _baudRate;
+    // times without action (in seconds) till dim, sleep and power down
+    uint16_t _dimTime;
+    uint16_t _sleepTime;
+    uint16_t _powerDownTime;
+    // whether power times are adapted to the usage
+    bool _adaptivePower;
+    // whether scans are made without animations as soon as the can settled
+    bool _throughputMode;
+    // true while changes are kept in RAM only (see beginSession)
+    bool _session;
+    // false while profiles other than the selected one still need to be loaded from EEPROM
+    bool _profilesLoaded;
+    // index of the currently used profile
+    uint8_t _activeProfile;
+    // parameters of profiles 1..NR_PROFILES-1; profile 0 is the sensor's default profile
+    sensorProfile _profiles[NR_PROFILES-1];
+    // quadratic calibration terms of all profiles, in units of 1/CAL_QUAD_SCALE
+    int16_t _calQuad[NR_PROFILES];
+    // switch to profile p without storing the selection
+    void useProfile(uint8_t p);
+    // EEPROM address of a profile field given by its offset within sensorProfile
+    uint16_t profileAddress(uint8_t p, uint8_t offset);
+    // writes n floats starting at EEPROM address addr
+    void writeFloats(uint16_t addr, float *vals, uint8_t n);
+    // reads n floats starting at EEPROM address addr; returns false if not set or invalid
+    bool readFloats(uint16_t addr, float *vals, uint8_t n);
+    // writes a 16 bit value (LSB first) to EEPROM address addr
+    void writeWord(uint16_t addr, uint16_t val);
+    // reads a 16 bit value (LSB first) from EEPROM address addr; 0xFFFF if not set
+    uint16_t readWord(uint16_t addr);
+    // distance between the redundant copies of the EEPROM block containing addr
+    static uint16_t eepromStride(uint16_t addr);
+    // writes val to EEPROM address addr but only if the stored value is different; nothing is written during a session
+    bool checkedEepromWrite(uint16_t addr, uint8_t val);
     // reads val from EEPROM address addr
-    uint8_t checkedEepromRead(uint8_t addr);
+    uint8_t checkedEepromRead(uint16_t addr);
     // finds most frequent value in given array
     // return true if at least one value is different
     bool getMostFrequent(uint8_t *vals, uint8_t *val);
@@ -134,6 +300,10 @@ class ToninoConfig {
     // should only be used if isEepromChanged() returned true
     // if some settings have not been set, uses and stores default values
     void readStoredParameters();
+    // read the parameters of the currently used profile from EEPROM
+    void readProfileParameters();
+    // store default parameters to the currently used profile
+    void writeProfileDefaults();
 };
 
 #endif
\ No newline at end of file
@@ -303,62 +303,33 @@ void LCD::averaged(boolean dot) {
   writeDisplay();
 }
 
+// digit and segment lit in each frame of the rotating circle
+static const uint8_t circletable[CIRCLE_FRAMES][2] = {
+  { 0, 0b1 }, { 1, 0b1 }, { 3, 0b1 }, { 4, 0b1 }, { 4, 0b10 }, { 4, 0b100 },
+  { 4, 0b1000 }, { 3, 0b1000 }, { 1, 0b1000 }, { 0, 0b1000 }, { 0, 0b10000 }, { 0, 0b100000 }
+};
+
 // shows a rotating circle; total time =repeat*timePerCircle
 void LCD::circle(uint8_t repeat, uint16_t timePerCircle) {
-  int16_t dtime = timePerCircle / 12;
+  int16_t dtime = timePerCircle / CIRCLE_FRAMES;
 
-  for (int i = 0; i < repeat; ++i) {
-    writeDigitRaw(0, 0b1);
-    writeDisplay();
-    delay(dtime);
-    
-    writeDigitRaw(0, 0b0);
-    writeDigitRaw(1, 0b1);
-    writeDisplay();
-    delay(dtime);
-  
-    writeDigitRaw(1, 0b0);
-    writeDigitRaw(3, 0b1);
-    writeDisplay();
-    delay(dtime);
-  
-    writeDigitRaw(3, 0b0);
-    writeDigitRaw(4, 0b1);
-    writeDisplay();
-    delay(dtime);
-    writeDigitRaw(4, 0b10);
-    writeDisplay();
-    delay(dtime);
-    writeDigitRaw(4, 0b100);
-    writeDisplay();
-    delay(dtime);
-    writeDigitRaw(4, 0b1000);
-    writeDisplay();
-    delay(dtime);
-  
-    writeDigitRaw(4, 0b0);
-    writeDigitRaw(3, 0b1000);
-    writeDisplay();
-    delay(dtime);
-  
-    writeDigitRaw(3, 0b0);
-    writeDigitRaw(1, 0b1000);
-    writeDisplay();
-    delay(dtime);
-  
-    writeDigitRaw(1, 0b0);
-    writeDigitRaw(0, 0b1000);
-    writeDisplay();
-    delay(dtime);
-    writeDigitRaw(0, 0b10000);
-    writeDisplay();
-    delay(dtime);
-    writeDigitRaw(0, 0b100000);
-    writeDisplay();
+  for (int i = 0; i < repeat * CIRCLE_FRAMES; ++i) {
+    circleFrame(i % CIRCLE_FRAMES);
     delay(dtime);
   }
 }
 
+// shows frame (modulo CIRCLE_FRAMES) of the rotating circle, for animating it without blocking
+void LCD::circleFrame(uint8_t frame) {
+  frame %= CIRCLE_FRAMES;
+  writeDigitRaw(0, 0);
+  writeDigitRaw(1, 0);
+  writeDigitRaw(3, 0);
+  writeDigitRaw(4, 0);
+  writeDigitRaw(circletable[frame][0], circletable[frame][1]);
+  writeDisplay();
+}
+
 // displays a number; effect: each digit sequentially counts from 0
 void LCD::dropNumber(uint16_t num) {
   if (num > 9999) {
@@ -611,19 +582,20 @@ void LCD::calibration(bool circle) {
 
 // shows 'CAL1'
 void LCD::calibration1() {
-  writeDigitRaw(0, numbertable[12]); // C
-  writeDigitRaw(1, numbertable[10]); // A
-  writeDigitRaw(3, 0b00111000);      // L
-  writeDigitRaw(4, numbertable[1]);  // 1
-  writeDisplay();
+  calibrationPlate(1);
 }
 
 // shows 'CAL2'
 void LCD::calibration2() {
+  calibrationPlate(2);
+}
+
+// shows 'CALn' for n in 0..9
+void LCD::calibrationPlate(uint8_t n) {
   writeDigitRaw(0, numbertable[12]); // C
   writeDigitRaw(1, numbertable[10]); // A
   writeDigitRaw(3, 0b00111000);      // L
-  writeDigitRaw(4, numbertable[2]);  // 2
+  writeDigitRaw(4, numbertable[n % 10]);
   writeDisplay();
 }
 
@@ -50,6 +50,9 @@
 // i2c lib for LCD, built-in, see http://arduino.cc/en/Reference/Wire
 #include <Wire.h>
 
+// number of frames of one rotation of the circle, see circleFrame()
+#define CIRCLE_FRAMES 12
+
 
 class LCD {
   public:
@@ -111,6 +114,9 @@ class LCD {
     
     // shows a rotating circle; total time =repeat*timePerCircle
     void circle(uint8_t repeat = 1, uint16_t timePerCircle = 700);
+
+    // shows frame (modulo CIRCLE_FRAMES) of the rotating circle, for animating it without blocking
+    void circleFrame(uint8_t frame);
     
     // displays a number; effect: each digit sequentially counts from 0
     void dropNumber(uint16_t num);
@@ -142,6 +148,9 @@ class LCD {
     
     // shows 'CAL2'
     void calibration2();
+
+    // shows 'CALn' for n in 0..9
+    void calibrationPlate(uint8_t n);
     
     // shows 'done'
     void done();
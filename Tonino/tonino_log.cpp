@@ -0,0 +1,291 @@
+// tonino_log.cpp
+//----------------
+// library for Tonino scan history
+//
+// *** BSD License ***
+// ------------------------------------------------------------------------------------------
+// Copyright (c) 2016, Paul Holleis, Marko Luther
+// All rights reserved.
+//
+// Authors:  Paul Holleis, Marko Luther
+//
+// Redistribution and use in source and binary forms, with or without modification, are 
+// permitted provided that the following conditions are met:
+//
+//   Redistributions of source code must retain the above copyright notice, this list of 
+//   conditions and the following disclaimer.
+//
+//   Redistributions in binary form must reproduce the above copyright notice, this list 
+//   of conditions and the following disclaimer in the documentation and/or other materials 
+//   provided with the distribution.
+//
+//   Neither the name of the copyright holder(s) nor the names of its contributors may be 
+//   used to endorse or promote products derived from this software without specific prior 
+//   written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS 
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF 
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL 
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) 
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS 
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// ------------------------------------------------------------------------------------------
+
+
+
+#include <tonino_log.h>
+
+
+// zigzag encoding maps signed to unsigned values such that small differences stay small
+static inline uint32_t zigzag(int32_t v) {
+  return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static inline int32_t unzigzag(uint32_t v) {
+  return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+
+ToninoLog::ToninoLog() :
+  _page(LOG_EMPTY), _seq(LOG_EMPTY), _pos(LOG_PAGE_SIZE), _boot(true), _rPages(0), _rateSlot(0) {
+  memset(_rate, 0, sizeof(_rate));
+}
+
+ToninoLog::~ToninoLog() {
+  // empty
+}
+
+// finds the most recent page and its first free slot; a new page is only started
+// if the page is full or its last record got torn by a power loss
+void ToninoLog::init() {
+  _page = LOG_EMPTY;
+  for (uint8_t p = 0; p < LOG_NR_PAGES; ++p) {
+    uint8_t seq = EEPROM.read(pageAddress(p));
+    if (seq == LOG_EMPTY) {
+      continue;
+    }
+    // the most recent page is the one not followed by its successor
+    uint8_t nextSeq = EEPROM.read(pageAddress((p + 1) % LOG_NR_PAGES));
+    if (nextSeq != (seq + 1) % LOG_EMPTY) {
+      _page = p;
+      _seq = seq;
+      break;
+    }
+  }
+  _pos = LOG_PAGE_SIZE;
+  if (_page != LOG_EMPTY) {
+    // replay the records of the page to restore the values the next one is relative to
+    _rPage = _page;
+    _rPos = 1;
+    memset(&_rLast, 0, sizeof(_rLast));
+    uint8_t end = 1;
+    while (readRecord()) {
+      end = _rPos;
+    }
+    // the slot after the last complete record must be free, else a write got interrupted
+    if (end >= LOG_PAGE_SIZE || EEPROM.read(pageAddress(_page) + end) == LOG_EMPTY) {
+      _pos = end;
+      _last = _rLast;
+    }
+    _rPages = 0;
+  }
+  _boot = true;
+  WRITEDEBUG("log page:");
+  WRITEDEBUG(_page);
+  WRITEDEBUG(" pos:");
+  WRITEDEBUGLN(_pos);
+}
+
+// appends a record for the given scan result with the current time
+void ToninoLog::add(int32_t tval, sensorData *sd, boolean averaged) {
+  logRecord rec;
+  rec.tval = tval;
+  rec.red = sd->value[RED_IDX];
+  rec.blue = sd->value[BLUE_IDX];
+  rec.time = millis() / 1000;
+  rec.flags = (averaged ? LOG_AVERAGED : 0) | (_boot ? LOG_BOOT : 0);
+
+  uint8_t buf[LOG_MAX_RECORD];
+  uint8_t len = encode(&rec, buf);
+  if (_page == LOG_EMPTY || _pos + len > LOG_PAGE_SIZE) {
+    // start a new page with absolute values
+    newPage();
+    len = encode(&rec, buf);
+  }
+  uint16_t addr = pageAddress(_page) + _pos;
+  for (uint8_t i = 0; i < len; ++i) {
+    eepromUpdate(addr + i, buf[i]);
+  }
+  _pos += len;
+  _last = rec;
+  _boot = false;
+
+  advanceRate();
+  if (_rate[_rateSlot % LOG_RATE_SLOTS] < 255) {
+    _rate[_rateSlot % LOG_RATE_SLOTS]++;
+  }
+}
+
+// number of records added within the last minute
+uint16_t ToninoLog::scansPerMinute() {
+  advanceRate();
+  uint16_t sum = 0;
+  for (uint8_t i = 0; i < LOG_RATE_SLOTS; ++i) {
+    sum += _rate[i];
+  }
+  return sum;
+}
+
+// moves _rateSlot to the current time, clearing the slots passed
+void ToninoLog::advanceRate() {
+  uint32_t slot = millis() / LOG_RATE_SLOT;
+  if (slot - _rateSlot >= LOG_RATE_SLOTS) {
+    memset(_rate, 0, sizeof(_rate));
+    _rateSlot = slot;
+  }
+  while (_rateSlot != slot) {
+    _rate[++_rateSlot % LOG_RATE_SLOTS] = 0;
+  }
+}
+
+// start reading at the oldest record
+void ToninoLog::rewind() {
+  _rPages = 0;
+  if (_page == LOG_EMPTY) {
+    return;
+  }
+  // walk back from the most recent page as long as the sequence is continuous
+  _rPage = _page;
+  _rPages = 1;
+  uint8_t seq = _seq;
+  while (_rPages < LOG_NR_PAGES) {
+    uint8_t prev = (_rPage + LOG_NR_PAGES - 1) % LOG_NR_PAGES;
+    uint8_t prevSeq = EEPROM.read(pageAddress(prev));
+    if (prevSeq == LOG_EMPTY || (prevSeq + 1) % LOG_EMPTY != seq) {
+      break;
+    }
+    _rPage = prev;
+    seq = prevSeq;
+    _rPages++;
+  }
+  _rPos = 1;
+  memset(&_rLast, 0, sizeof(_rLast));
+}
+
+// reads the next record (oldest first); returns false if there are no more records
+bool ToninoLog::next(logRecord *rec) {
+  while (_rPages > 0) {
+    if (readRecord()) {
+      *rec = _rLast;
+      return true;
+    }
+    // continue with the first record of the next page
+    _rPage = (_rPage + 1) % LOG_NR_PAGES;
+    _rPos = 1;
+    _rPages--;
+    memset(&_rLast, 0, sizeof(_rLast));
+  }
+  return false;
+}
+
+// reads the record of page _rPage at _rPos and adds it to _rLast;
+// returns false at the end of the page or for an incomplete record
+bool ToninoLog::readRecord() {
+  if (_rPos >= LOG_PAGE_SIZE) {
+    return false;
+  }
+  uint8_t header = EEPROM.read(pageAddress(_rPage) + _rPos);
+  if (header == LOG_EMPTY) {
+    return false;
+  }
+  _rPos++;
+  uint32_t v[4];
+  for (uint8_t i = 0; i < 4; ++i) {
+    // a torn record ends in LOG_EMPTY bytes which never end a varint
+    if (!getVarint(&v[i])) {
+      return false;
+    }
+  }
+  _rLast.tval += unzigzag(v[0]);
+  _rLast.red += unzigzag(v[1]);
+  _rLast.blue += unzigzag(v[2]);
+  if (header & LOG_BOOT) {
+    _rLast.time = v[3];
+  } else {
+    _rLast.time += v[3];
+  }
+  _rLast.flags = header;
+  return true;
+}
+
+// EEPROM address of the first byte of page p
+inline uint16_t ToninoLog::pageAddress(uint8_t p) {
+  return LOG_START_ADDRESS + (uint16_t)p * LOG_PAGE_SIZE;
+}
+
+// clears the next page and gives it the next sequence number
+void ToninoLog::newPage() {
+  if (_page == LOG_EMPTY) {
+    _page = 0;
+    _seq = 0;
+  } else {
+    _page = (_page + 1) % LOG_NR_PAGES;
+    _seq = (_seq + 1) % LOG_EMPTY;
+  }
+  uint16_t addr = pageAddress(_page);
+  for (uint8_t i = 1; i < LOG_PAGE_SIZE; ++i) {
+    eepromUpdate(addr + i, LOG_EMPTY);
+  }
+  // sequence number last such that a page is only valid once it is cleared
+  eepromUpdate(addr, _seq);
+  _pos = 1;
+  memset(&_last, 0, sizeof(_last));
+}
+
+// encodes rec relative to _last into buf, the time of a boot record absolute; returns number of bytes
+uint8_t ToninoLog::encode(logRecord *rec, uint8_t *buf) {
+  uint8_t pos = 0;
+  buf[pos++] = rec->flags;
+  pos = putVarint(buf, pos, zigzag(rec->tval - _last.tval));
+  pos = putVarint(buf, pos, zigzag(rec->red - _last.red));
+  pos = putVarint(buf, pos, zigzag(rec->blue - _last.blue));
+  pos = putVarint(buf, pos, (rec->flags & LOG_BOOT) ? rec->time : rec->time - _last.time);
+  return pos;
+}
+
+// appends v as varint (7 bits per byte, least significant first) to buf at pos; returns new pos
+uint8_t ToninoLog::putVarint(uint8_t *buf, uint8_t pos, uint32_t v) {
+  while (v >= 0x80) {
+    buf[pos++] = (v & 0x7F) | 0x80;
+    v >>= 7;
+  }
+  buf[pos++] = v;
+  return pos;
+}
+
+// reads a varint from page _rPage at _rPos; returns false if beyond page end
+bool ToninoLog::getVarint(uint32_t *v) {
+  uint16_t addr = pageAddress(_rPage);
+  *v = 0;
+  for (uint8_t shift = 0; shift < 35; shift += 7) {
+    if (_rPos >= LOG_PAGE_SIZE) {
+      return false;
+    }
+    uint8_t b = EEPROM.read(addr + _rPos++);
+    *v |= (uint32_t)(b & 0x7F) << shift;
+    if ((b & 0x80) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// writes val to EEPROM address addr but only if the stored value is different
+inline void ToninoLog::eepromUpdate(uint16_t addr, uint8_t val) {
+  if (EEPROM.read(addr) != val) {
+    EEPROM.write(addr, val);
+  }
+}
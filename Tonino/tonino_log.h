@@ -0,0 +1,148 @@
+// tonino_log.h
+//----------------
+// library for Tonino scan history
+//
+// *** BSD License ***
+// ------------------------------------------------------------------------------------------
+// Copyright (c) 2016, Paul Holleis, Marko Luther
+// All rights reserved.
+//
+// Authors:  Paul Holleis, Marko Luther
+//
+// Redistribution and use in source and binary forms, with or without modification, are 
+// permitted provided that the following conditions are met:
+//
+//   Redistributions of source code must retain the above copyright notice, this list of 
+//   conditions and the following disclaimer.
+//
+//   Redistributions in binary form must reproduce the above copyright notice, this list 
+//   of conditions and the following disclaimer in the documentation and/or other materials 
+//   provided with the distribution.
+//
+//   Neither the name of the copyright holder(s) nor the names of its contributors may be 
+//   used to endorse or promote products derived from this software without specific prior 
+//   written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS 
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF 
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL 
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) 
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS 
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// ------------------------------------------------------------------------------------------
+
+
+
+#ifndef _TONINO_LOG_H
+#define _TONINO_LOG_H
+
+
+#include <tonino.h>
+#include <tonino_tcs3200.h>
+#include <tonino_config.h>
+
+// lib to access EEPROM, built-in, see http://arduino.cc/en/Reference/EEPROM
+#include <EEPROM.h>
+
+
+// the scan history uses the EEPROM behind the config blocks, divided into pages
+// each page starts with a sequence number (LOG_EMPTY if unused) followed by records
+// a record is a header byte and the zigzag varint encoded T-value, red, blue and time;
+// the first record of a page holds absolute values, all others the difference
+// to the previous record such that an overwritten page never breaks the next one;
+// the time of a LOG_BOOT record is always absolute as it restarts at power-on
+// after power-on, records continue at the first free slot of the most recent page
+#define LOG_START_ADDRESS EEPROM_EXT_END_ADDRESS
+#define LOG_PAGE_SIZE     32
+#define LOG_NR_PAGES      ((E2END+1-LOG_START_ADDRESS)/LOG_PAGE_SIZE)
+#define LOG_EMPTY         255
+// max. size of one record: header and 4 varints of up to 5 bytes
+#define LOG_MAX_RECORD    21
+
+// record header flags; bit 7 is never set such that LOG_EMPTY marks the end of a page
+#define LOG_AVERAGED 0b00000001 // T-value got averaged with the previous scan
+#define LOG_BOOT     0b00000010 // first record after power-on
+
+// scans per minute are counted in RAM in LOG_RATE_SLOTS slots of LOG_RATE_SLOT ms each
+#define LOG_RATE_SLOTS 6
+#define LOG_RATE_SLOT  10000
+
+
+// one entry of the scan history
+typedef struct {
+  int32_t tval;   // T-value
+  int32_t red;    // raw red reading
+  int32_t blue;   // raw blue reading
+  uint32_t time;  // seconds since power-on
+  uint8_t flags;  // LOG_xxx flags
+} logRecord;
+
+
+class ToninoLog {
+  public:
+    ToninoLog(void);
+    ~ToninoLog(void);
+
+    // finds the most recent page and its first free slot; a new page is only started
+    // if the page is full or its last record got torn by a power loss
+    void init();
+
+    // appends a record for the given scan result with the current time
+    // (may take several EEPROM write cycles, so call it after the display was updated)
+    void add(int32_t tval, sensorData *sd, boolean averaged);
+
+    // start reading at the oldest record
+    void rewind();
+
+    // reads the next record (oldest first); returns false if there are no more records
+    bool next(logRecord *rec);
+
+    // number of records added within the last minute
+    uint16_t scansPerMinute();
+
+  private:
+    // page written to, LOG_EMPTY if none
+    uint8_t _page;
+    // sequence number of that page
+    uint8_t _seq;
+    // next write position within the page
+    uint8_t _pos;
+    // true until the first record after power-on has been written
+    bool _boot;
+    // last written values to compute differences
+    logRecord _last;
+
+    // page and position to read from, number of pages left to read
+    uint8_t _rPage;
+    uint8_t _rPos;
+    uint8_t _rPages;
+    // last read values to add differences to
+    logRecord _rLast;
+
+    // records added per slot, the current slot is _rateSlot % LOG_RATE_SLOTS
+    uint8_t _rate[LOG_RATE_SLOTS];
+    uint32_t _rateSlot;
+
+    // moves _rateSlot to the current time, clearing the slots passed
+    void advanceRate();
+    // EEPROM address of the first byte of page p
+    static uint16_t pageAddress(uint8_t p);
+    // clears the next page and gives it the next sequence number
+    void newPage();
+    // encodes rec relative to _last into buf; returns number of bytes
+    uint8_t encode(logRecord *rec, uint8_t *buf);
+    // appends v as varint to buf at pos; returns new pos
+    static uint8_t putVarint(uint8_t *buf, uint8_t pos, uint32_t v);
+    // reads the record of page _rPage at _rPos and adds it to _rLast;
+    // returns false at the end of the page or for an incomplete record
+    bool readRecord();
+    // reads a varint from page _rPage at _rPos; returns false if beyond page end
+    bool getVarint(uint32_t *v);
+    // writes val to EEPROM address addr but only if the stored value is different
+    static void eepromUpdate(uint16_t addr, uint8_t val);
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,148 @@
+// tonino_power.cpp
+//----------------
+// power policy: times till dimming, sleep and power down
+//
+// *** BSD License ***
+// ------------------------------------------------------------------------------------------
+// Copyright (c) 2016, Paul Holleis, Marko Luther
+// All rights reserved.
+//
+// Authors:  Paul Holleis, Marko Luther
+//
+// Redistribution and use in source and binary forms, with or without modification, are 
+// permitted provided that the following conditions are met:
+//
+//   Redistributions of source code must retain the above copyright notice, this list of 
+//   conditions and the following disclaimer.
+//
+//   Redistributions in binary form must reproduce the above copyright notice, this list 
+//   of conditions and the following disclaimer in the documentation and/or other materials 
+//   provided with the distribution.
+//
+//   Neither the name of the copyright holder(s) nor the names of its contributors may be 
+//   used to endorse or promote products derived from this software without specific prior 
+//   written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS 
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF 
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL 
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) 
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS 
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// ------------------------------------------------------------------------------------------
+
+
+
+#include <tonino_power.h>
+
+
+ToninoPower::ToninoPower(ToninoConfig *tConfig) :
+  _tConfig(tConfig), _lastScan(0), _dims(0), _sleeps(0), _powerDowns(0) {
+  for (uint8_t i = 0; i < POWER_BUCKETS; ++i) {
+    _intervals[i] = 0;
+  }
+}
+
+ToninoPower::~ToninoPower() {
+  // empty
+}
+
+// time since reset in ms incl. time in power down
+uint32_t ToninoPower::now() {
+  return millis() + energyTime(ENERGY_SLEEP);
+}
+
+// to be called for every stand-alone scan; records the interval to the previous one
+void ToninoPower::scanned() {
+  uint32_t t = now();
+  if (_lastScan != 0) {
+    uint32_t seconds = (t - _lastScan) / 1000;
+    uint8_t b = 0;
+    while (seconds > 1 && b < POWER_BUCKETS-1) {
+      seconds >>= 1;
+      ++b;
+    }
+    if (_intervals[b] == 255) {
+      // forget older intervals gradually
+      for (uint8_t i = 0; i < POWER_BUCKETS; ++i) {
+        _intervals[i] >>= 1;
+      }
+    }
+    ++_intervals[b];
+  }
+  _lastScan = t;
+}
+
+// the configured time of seconds scaled by the share of intervals shorter than that,
+// but at least by 1/POWER_MIN_FACTOR; in ms
+// with scans in quick succession the configured times apply, with sparse usage the
+// Tonino dims and sleeps sooner as another scan is unlikely to follow soon
+uint32_t ToninoPower::adapt(uint16_t seconds) {
+  uint32_t ms = (uint32_t)seconds * 1000;
+  uint16_t total = getIntervals();
+  if (!_tConfig->getAdaptivePower() || total < POWER_MIN_INTERVALS) {
+    return ms;
+  }
+  // intervals in buckets that end before the given time
+  uint16_t shorter = 0;
+  for (uint8_t b = 0; b < POWER_BUCKETS && (2UL << b) <= seconds; ++b) {
+    shorter += _intervals[b];
+  }
+  if (shorter * POWER_MIN_FACTOR < total) {
+    return ms / POWER_MIN_FACTOR;
+  }
+  return ms / total * shorter;
+}
+
+// time without action in ms after which the display is dimmed
+uint32_t ToninoPower::dimTime() {
+  return adapt(_tConfig->getDimTime());
+}
+
+// time without action in ms after which the Tonino goes to sleep
+uint32_t ToninoPower::sleepTime() {
+  return adapt(_tConfig->getSleepTime());
+}
+
+// time without action in ms after which the Tonino powers down
+uint32_t ToninoPower::powerDownTime() {
+  return (uint32_t)_tConfig->getPowerDownTime() * 1000;
+}
+
+// to be called when the display was dimmed, the Tonino went to sleep or powered down; counted for the stats
+void ToninoPower::dimmed() {
+  ++_dims;
+}
+
+void ToninoPower::slept() {
+  ++_sleeps;
+}
+
+void ToninoPower::poweredDown() {
+  ++_powerDowns;
+}
+
+// number of intervals between scans taken into account for adapting the times
+uint16_t ToninoPower::getIntervals() {
+  uint16_t total = 0;
+  for (uint8_t i = 0; i < POWER_BUCKETS; ++i) {
+    total += _intervals[i];
+  }
+  return total;
+}
+
+// number of times the display was dimmed, the Tonino went to sleep or powered down since reset
+uint16_t ToninoPower::getDims() {
+  return _dims;
+}
+
+uint16_t ToninoPower::getSleeps() {
+  return _sleeps;
+}
+
+uint16_t ToninoPower::getPowerDowns() {
+  return _powerDowns;
+}
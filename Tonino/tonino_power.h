@@ -0,0 +1,103 @@
+// tonino_power.h
+//----------------
+// power policy: times till dimming, sleep and power down
+//
+// *** BSD License ***
+// ------------------------------------------------------------------------------------------
+// Copyright (c) 2016, Paul Holleis, Marko Luther
+// All rights reserved.
+//
+// Authors:  Paul Holleis, Marko Luther
+//
+// Redistribution and use in source and binary forms, with or without modification, are 
+// permitted provided that the following conditions are met:
+//
+//   Redistributions of source code must retain the above copyright notice, this list of 
+//   conditions and the following disclaimer.
+//
+//   Redistributions in binary form must reproduce the above copyright notice, this list 
+//   of conditions and the following disclaimer in the documentation and/or other materials 
+//   provided with the distribution.
+//
+//   Neither the name of the copyright holder(s) nor the names of its contributors may be 
+//   used to endorse or promote products derived from this software without specific prior 
+//   written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS 
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF 
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL 
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) 
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS 
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// ------------------------------------------------------------------------------------------
+
+
+
+#ifndef _TONINO_POWER_H
+#define _TONINO_POWER_H
+
+
+#include <tonino.h>
+#include <tonino_config.h>
+
+
+// intervals between scans are counted in buckets of powers of two seconds:
+// bucket i holds intervals of 2^i to 2^(i+1)-1 seconds (bucket 0 also 0s)
+#define POWER_BUCKETS 16
+// number of observed intervals needed before the times are adapted
+#define POWER_MIN_INTERVALS 8
+// adapted times are never shorter than the configured ones divided by this
+#define POWER_MIN_FACTOR 4
+
+
+class ToninoPower {
+  public:
+    ToninoPower(ToninoConfig *tConfig);
+    ~ToninoPower();
+
+    // to be called for every stand-alone scan; records the interval to the previous one
+    void scanned();
+
+    // time without action in ms after which the display is dimmed
+    uint32_t dimTime();
+
+    // time without action in ms after which the Tonino goes to sleep
+    uint32_t sleepTime();
+
+    // time without action in ms after which the Tonino powers down
+    uint32_t powerDownTime();
+
+    // to be called when the display was dimmed, the Tonino went to sleep or powered down; counted for the stats
+    void dimmed();
+    void slept();
+    void poweredDown();
+
+    // number of intervals between scans taken into account for adapting the times
+    uint16_t getIntervals();
+
+    // number of times the display was dimmed, the Tonino went to sleep or powered down since reset
+    uint16_t getDims();
+    uint16_t getSleeps();
+    uint16_t getPowerDowns();
+
+  private:
+    ToninoConfig *_tConfig;
+    // observed intervals between scans, see POWER_BUCKETS
+    uint8_t _intervals[POWER_BUCKETS];
+    // time of the last scan in ms incl. time in power down, 0 if none yet
+    uint32_t _lastScan;
+    // decision counters
+    uint16_t _dims;
+    uint16_t _sleeps;
+    uint16_t _powerDowns;
+    // time since reset in ms incl. time in power down
+    static uint32_t now();
+    // the configured time of seconds scaled by the share of intervals shorter than that,
+    // but at least by 1/POWER_MIN_FACTOR; in ms
+    uint32_t adapt(uint16_t seconds);
+};
+
+#endif
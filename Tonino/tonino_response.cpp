@@ -0,0 +1,155 @@
+// tonino_response.cpp
+//----------------
+// buffered formatting of serial responses
+//
+// *** BSD License ***
+// ------------------------------------------------------------------------------------------
+// Copyright (c) 2016, Paul Holleis, Marko Luther
+// All rights reserved.
+//
+// Authors:  Paul Holleis, Marko Luther
+//
+// Redistribution and use in source and binary forms, with or without modification, are 
+// permitted provided that the following conditions are met:
+//
+//   Redistributions of source code must retain the above copyright notice, this list of 
+//   conditions and the following disclaimer.
+//
+//   Redistributions in binary form must reproduce the above copyright notice, this list 
+//   of conditions and the following disclaimer in the documentation and/or other materials 
+//   provided with the distribution.
+//
+//   Neither the name of the copyright holder(s) nor the names of its contributors may be 
+//   used to endorse or promote products derived from this software without specific prior 
+//   written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS 
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF 
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL 
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) 
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS 
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// ------------------------------------------------------------------------------------------
+
+
+
+#include <tonino_response.h>
+
+
+// if tag is not NULL, it is inserted as CMD#tag behind the command (first word) of the response
+ToninoResponse::ToninoResponse(const char *tag) : _len(0), _tag(tag) {
+}
+
+// appends a null-terminated string
+void ToninoResponse::print(const char *s) {
+  while (*s != '\0') {
+    write(*s++);
+  }
+}
+
+// appends a null-terminated string stored in flash
+void ToninoResponse::print(const __FlashStringHelper *s) {
+  const char *p = reinterpret_cast<const char *>(s);
+  char c;
+  while ((c = pgm_read_byte(p++)) != '\0') {
+    write(c);
+  }
+}
+
+// appends an integer in decimal notation
+void ToninoResponse::print(int32_t v) {
+  if (v < 0) {
+    write('-');
+    printUnsigned(-(uint32_t)v);
+  } else {
+    printUnsigned(v);
+  }
+}
+
+// appends an unsigned integer in decimal notation
+void ToninoResponse::printUnsigned(uint32_t v) {
+  char digits[10];
+  uint8_t n = 0;
+  do {
+    digits[n++] = '0' + v % 10;
+    v /= 10;
+  } while (v != 0);
+  while (n > 0) {
+    write(digits[--n]);
+  }
+}
+
+// appends a float with the given number of decimals (max. 7), same format as Serial.print(f, digits)
+// the decimals are rounded to an integer once instead of extracting each digit by float operations
+void ToninoResponse::print(float f, uint8_t digits) {
+  if (isnan(f)) {
+    print(F("nan"));
+    return;
+  }
+  if (isinf(f)) {
+    print(F("inf"));
+    return;
+  }
+  if (f > 4294967040.0 || f < -4294967040.0) {
+    print(F("ovf"));
+    return;
+  }
+  if (f < 0.0) {
+    write('-');
+    f = -f;
+  }
+  if (digits > 7) {
+    digits = 7;
+  }
+  uint32_t scale = 1;
+  for (uint8_t i = 0; i < digits; ++i) {
+    scale *= 10;
+  }
+
+  // the integer part is split off exactly such that the scaled fraction fits the float mantissa
+  uint32_t intPart = (uint32_t)f;
+  uint32_t frac = (uint32_t)((f - intPart) * scale + 0.5);
+  if (frac >= scale) {
+    // rounded up to the next integer
+    ++intPart;
+    frac -= scale;
+  }
+  printUnsigned(intPart);
+  if (digits > 0) {
+    write('.');
+    char decimals[7];
+    for (uint8_t i = digits; i > 0; --i) {
+      decimals[i-1] = '0' + frac % 10;
+      frac /= 10;
+    }
+    for (uint8_t i = 0; i < digits; ++i) {
+      write(decimals[i]);
+    }
+  }
+}
+
+// appends a single character
+void ToninoResponse::write(char c) {
+  if (_tag != NULL && (c == ':' || c == ' ' || c == '\n')) {
+    // end of the command, insert the request ID
+    const char *tag = _tag;
+    _tag = NULL;
+    write('#');
+    print(tag);
+  }
+  if (_len == RESPONSE_BUFFER) {
+    send();
+  }
+  _buf[_len++] = c;
+}
+
+// writes the collected response to serial
+void ToninoResponse::send() {
+  if (_len > 0) {
+    Serial.write((const uint8_t*)_buf, _len);
+    _len = 0;
+  }
+}
@@ -0,0 +1,85 @@
+// tonino_response.h
+//----------------
+// buffered formatting of serial responses
+//
+// *** BSD License ***
+// ------------------------------------------------------------------------------------------
+// Copyright (c) 2016, Paul Holleis, Marko Luther
+// All rights reserved.
+//
+// Authors:  Paul Holleis, Marko Luther
+//
+// Redistribution and use in source and binary forms, with or without modification, are 
+// permitted provided that the following conditions are met:
+//
+//   Redistributions of source code must retain the above copyright notice, this list of 
+//   conditions and the following disclaimer.
+//
+//   Redistributions in binary form must reproduce the above copyright notice, this list 
+//   of conditions and the following disclaimer in the documentation and/or other materials 
+//   provided with the distribution.
+//
+//   Neither the name of the copyright holder(s) nor the names of its contributors may be 
+//   used to endorse or promote products derived from this software without specific prior 
+//   written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS 
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF 
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL 
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) 
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS 
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// ------------------------------------------------------------------------------------------
+
+
+
+#ifndef _TONINO_RESPONSE_H
+#define _TONINO_RESPONSE_H
+
+
+#include <tonino.h>
+
+
+// size of the response buffer; longer responses are written in several chunks
+// (same size as the TX ring buffer of the serial lib)
+#define RESPONSE_BUFFER 64
+
+
+// collects a serial response on the stack and writes it to serial in one go
+class ToninoResponse {
+  public:
+    // if tag is not NULL, it is inserted as CMD#tag behind the command (first word) of the response
+    ToninoResponse(const char *tag = NULL);
+
+    // appends a null-terminated string
+    void print(const char *s);
+
+    // appends a null-terminated string stored in flash, e.g. print(F("SCAN:"))
+    void print(const __FlashStringHelper *s);
+
+    // appends an integer in decimal notation
+    void print(int32_t v);
+
+    // appends a float with the given number of decimals (max. 7), same format as Serial.print(f, digits)
+    void print(float f, uint8_t digits);
+
+    // appends a single character
+    void write(char c);
+
+    // writes the collected response to serial
+    void send();
+
+  private:
+    // appends an unsigned integer in decimal notation
+    void printUnsigned(uint32_t v);
+
+    char _buf[RESPONSE_BUFFER];
+    uint8_t _len;
+    // request ID still to be inserted, NULL if none or done
+    const char *_tag;
+};
+
+#endif
@@ -0,0 +1,97 @@
+// tonino_scheduler.cpp
+//----------------
+// cooperative scheduler for the tasks of the main loop
+//
+// *** BSD License ***
+// ------------------------------------------------------------------------------------------
+// Copyright (c) 2016, Paul Holleis, Marko Luther
+// All rights reserved.
+//
+// Authors:  Paul Holleis, Marko Luther
+//
+// Redistribution and use in source and binary forms, with or without modification, are 
+// permitted provided that the following conditions are met:
+//
+//   Redistributions of source code must retain the above copyright notice, this list of 
+//   conditions and the following disclaimer.
+//
+//   Redistributions in binary form must reproduce the above copyright notice, this list 
+//   of conditions and the following disclaimer in the documentation and/or other materials 
+//   provided with the distribution.
+//
+//   Neither the name of the copyright holder(s) nor the names of its contributors may be 
+//   used to endorse or promote products derived from this software without specific prior 
+//   written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS 
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF 
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL 
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) 
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS 
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// ------------------------------------------------------------------------------------------
+
+
+
+#include <tonino_scheduler.h>
+
+
+// the task table is owned by the caller; tasks scheduled in the table are due immediately
+ToninoScheduler::ToninoScheduler(ToninoTask *tasks, uint8_t nrTasks) :
+  _tasks(tasks), _nrTasks(nrTasks) {
+  // empty
+}
+
+ToninoScheduler::~ToninoScheduler() {
+  // empty
+}
+
+// runs all due tasks once, in the order of the table
+// a task is unscheduled before it is run
+void ToninoScheduler::run() {
+  for (uint8_t i = 0; i < _nrTasks; ++i) {
+    // signed difference such that the millis() overflow after ~50 days is handled
+    if (_tasks[i].active && (int32_t)(millis() - _tasks[i].due) >= 0) {
+      _tasks[i].active = false;
+      _tasks[i].run();
+    }
+  }
+}
+
+// schedule task id to run after ms milliseconds (0: with the next run())
+void ToninoScheduler::after(uint8_t id, uint32_t ms) {
+  _tasks[id].due = millis() + ms;
+  _tasks[id].active = true;
+}
+
+// unschedule task id
+void ToninoScheduler::stop(uint8_t id) {
+  _tasks[id].active = false;
+}
+
+// true if task id is scheduled
+boolean ToninoScheduler::isScheduled(uint8_t id) {
+  return _tasks[id].active;
+}
+
+// milliseconds till the next task is due, 0 if one is due already,
+// SCHEDULER_IDLE_FOREVER if no task is scheduled
+uint32_t ToninoScheduler::idleTime() {
+  uint32_t now = millis();
+  uint32_t idle = SCHEDULER_IDLE_FOREVER;
+  for (uint8_t i = 0; i < _nrTasks; ++i) {
+    if (_tasks[i].active) {
+      int32_t left = (int32_t)(_tasks[i].due - now);
+      if (left <= 0) {
+        return 0;
+      }
+      if ((uint32_t)left < idle) {
+        idle = left;
+      }
+    }
+  }
+  return idle;
+}
@@ -0,0 +1,86 @@
+// tonino_scheduler.h
+//----------------
+// cooperative scheduler for the tasks of the main loop
+//
+// *** BSD License ***
+// ------------------------------------------------------------------------------------------
+// Copyright (c) 2016, Paul Holleis, Marko Luther
+// All rights reserved.
+//
+// Authors:  Paul Holleis, Marko Luther
+//
+// Redistribution and use in source and binary forms, with or without modification, are 
+// permitted provided that the following conditions are met:
+//
+//   Redistributions of source code must retain the above copyright notice, this list of 
+//   conditions and the following disclaimer.
+//
+//   Redistributions in binary form must reproduce the above copyright notice, this list 
+//   of conditions and the following disclaimer in the documentation and/or other materials 
+//   provided with the distribution.
+//
+//   Neither the name of the copyright holder(s) nor the names of its contributors may be 
+//   used to endorse or promote products derived from this software without specific prior 
+//   written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS 
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF 
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL 
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) 
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS 
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// ------------------------------------------------------------------------------------------
+
+
+
+#ifndef _TONINO_SCHEDULER_H
+#define _TONINO_SCHEDULER_H
+
+
+#include <tonino.h>
+
+
+// returned by idleTime() if no task is scheduled
+#define SCHEDULER_IDLE_FOREVER 0xFFFFFFFF
+
+// an entry of the task table; tasks are plain functions that must return quickly
+// and ask to be run again by calling after() with their index in the table
+typedef struct {
+  void (*run)(void);
+  uint32_t due;     // millis() at which the task is due
+  boolean active;   // false if the task is not scheduled
+} ToninoTask;
+
+
+class ToninoScheduler {
+  public:
+    // the task table is owned by the caller; tasks scheduled in the table are due immediately
+    ToninoScheduler(ToninoTask *tasks, uint8_t nrTasks);
+    ~ToninoScheduler();
+
+    // runs all due tasks once, in the order of the table
+    // a task is unscheduled before it is run
+    void run();
+
+    // schedule task id to run after ms milliseconds (0: with the next run())
+    void after(uint8_t id, uint32_t ms);
+
+    // unschedule task id
+    void stop(uint8_t id);
+
+    // true if task id is scheduled
+    boolean isScheduled(uint8_t id);
+
+    // milliseconds till the next task is due, 0 if one is due already,
+    // SCHEDULER_IDLE_FOREVER if no task is scheduled
+    uint32_t idleTime();
+
+  private:
+    ToninoTask *_tasks;
+    uint8_t _nrTasks;
+};
+
+#endif
@@ -42,14 +42,157 @@ SerialCommand ToninoSerial::_sCmd;
 TCS3200 *ToninoSerial::_colorSense;
 LCD *ToninoSerial::_display;
 ToninoConfig *ToninoSerial::_tConfig;
+ToninoLog *ToninoSerial::_log;
+ToninoPower *ToninoSerial::_power;
+ToninoCalibration *ToninoSerial::_calibration;
 const char *ToninoSerial::_version;
+uint8_t ToninoSerial::_buf[SERIAL_BUFFER];
+int16_t ToninoSerial::_bufLen;
+uint16_t ToninoSerial::_blobBits;
+uint8_t ToninoSerial::_blobNBits;
+boolean ToninoSerial::_subscribed = false;
+uint32_t ToninoSerial::_speed;
+uint32_t ToninoSerial::_oldSpeed = 0;
+uint32_t ToninoSerial::_speedChanged;
+boolean ToninoSerial::_persistSpeed;
+boolean ToninoSerial::_binary = false;
+uint32_t ToninoSerial::_lastRx;
+uint8_t ToninoSerial::_cobsLeft;
+boolean ToninoSerial::_cobsZero;
+uint8_t ToninoSerial::_queue[SERIAL_QUEUE];
+uint8_t ToninoSerial::_queueHead = 0;
+uint8_t ToninoSerial::_queueLen = 0;
 const uint32_t NOTSET = 4242424242;
 
-ToninoSerial::ToninoSerial(TCS3200 *colorSense, LCD *display, ToninoConfig *tConfig, const char *ver) {
+// alphabet for base64 encoding of binary data
+static const char base64Chars[] PROGMEM = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// serial commands and their handlers, stored in flash
+// commands are matched exactly; 'legacy' entries accept the 8 character forms
+// to which firmware up to v1.1.7 truncated all commands
+// ATTENTION: the table must be sorted by command (ASCII order) as it is searched binary
+static const char cmdBINARY[] PROGMEM = "BINARY";
+static const char cmdCALIBRATE[] PROGMEM = "CALIBRATE";
+static const char cmdCOMMIT[] PROGMEM = "COMMIT";
+static const char cmdD_SCAN[] PROGMEM = "D_SCAN";
+static const char cmdGETBOOT[] PROGMEM = "GETBOOT";
+static const char cmdGETBRIGHTNESS[] PROGMEM = "GETBRIGHTNESS";
+static const char cmdGETCAL[] PROGMEM = "GETCAL";
+static const char cmdGETCALINIT[] PROGMEM = "GETCALINIT";
+static const char cmdGETCALSTATS[] PROGMEM = "GETCALSTATS";
+static const char cmdGETCMODE[] PROGMEM = "GETCMODE";
+static const char cmdGETCONF[] PROGMEM = "GETCONF";
+static const char cmdGETENERGY[] PROGMEM = "GETENERGY";
+static const char cmdGETFASTBOOT[] PROGMEM = "GETFASTBOOT";
+static const char cmdGETLOG[] PROGMEM = "GETLOG";
+static const char cmdGETLTDELAY[] PROGMEM = "GETLTDELAY";
+static const char cmdGETPOWER[] PROGMEM = "GETPOWER";
+static const char cmdGETPROFILE[] PROGMEM = "GETPROFILE";
+static const char cmdGETSAMPLING[] PROGMEM = "GETSAMPLING";
+static const char cmdGETSCALING[] PROGMEM = "GETSCALING";
+static const char cmdGETSETTLE[] PROGMEM = "GETSETTLE";
+static const char cmdGETTHROUGHPUT[] PROGMEM = "GETTHROUGHPUT";
+static const char cmdII_SCAN[] PROGMEM = "II_SCAN";
+static const char cmdI_SCAN[] PROGMEM = "I_SCAN";
+static const char cmdREADPROFILE[] PROGMEM = "READPROFILE";
+static const char cmdRESETDEF[] PROGMEM = "RESETDEF";
+static const char cmdREVERT[] PROGMEM = "REVERT";
+static const char cmdSCAN[] PROGMEM = "SCAN";
+static const char cmdSCANX[] PROGMEM = "SCANX";
+static const char cmdSESSION[] PROGMEM = "SESSION";
+static const char cmdSETBRIGHTNESS[] PROGMEM = "SETBRIGHTNESS";
+static const char cmdSETCAL[] PROGMEM = "SETCAL";
+static const char cmdSETCALINIT[] PROGMEM = "SETCALINIT";
+static const char cmdSETCMODE[] PROGMEM = "SETCMODE";
+static const char cmdSETBAUD[] PROGMEM = "SETBAUD";
+static const char cmdSETCONF[] PROGMEM = "SETCONF";
+static const char cmdSETFASTBOOT[] PROGMEM = "SETFASTBOOT";
+static const char cmdSETLTDELAY[] PROGMEM = "SETLTDELAY";
+static const char cmdSETPOWER[] PROGMEM = "SETPOWER";
+static const char cmdSETPROFILE[] PROGMEM = "SETPROFILE";
+static const char cmdSETSAMPLING[] PROGMEM = "SETSAMPLING";
+static const char cmdSETSCALING[] PROGMEM = "SETSCALING";
+static const char cmdSETTHROUGHPUT[] PROGMEM = "SETTHROUGHPUT";
+static const char cmdSUBSCRIBE[] PROGMEM = "SUBSCRIBE";
+static const char cmdTONINO[] PROGMEM = "TONINO";
+// legacy 8 character forms
+static const char cmdGETBRIGH[] PROGMEM = "GETBRIGH";
+static const char cmdGETCALIN[] PROGMEM = "GETCALIN";
+static const char cmdGETLTDEL[] PROGMEM = "GETLTDEL";
+static const char cmdGETSAMPL[] PROGMEM = "GETSAMPL";
+static const char cmdGETSCALI[] PROGMEM = "GETSCALI";
+static const char cmdSETBRIGH[] PROGMEM = "SETBRIGH";
+static const char cmdSETCALIN[] PROGMEM = "SETCALIN";
+static const char cmdSETLTDEL[] PROGMEM = "SETLTDEL";
+static const char cmdSETSAMPL[] PROGMEM = "SETSAMPL";
+static const char cmdSETSCALI[] PROGMEM = "SETSCALI";
+
+static const SerialCommand::SerialCommandCallback commands[] PROGMEM = {
+  { cmdBINARY,        ToninoSerial::binary, NULL },
+  { cmdCALIBRATE,     ToninoSerial::calibrate, NULL },
+  { cmdCOMMIT,        ToninoSerial::commitSession, NULL },
+  { cmdD_SCAN,        ToninoSerial::d_scan, NULL },
+  { cmdGETBOOT,       ToninoSerial::getBootTimes, NULL },
+  { cmdGETBRIGH,      ToninoSerial::getBrightness, NULL },    // legacy
+  { cmdGETBRIGHTNESS, ToninoSerial::getBrightness, NULL },
+  { cmdGETCAL,        ToninoSerial::getCalibration, NULL },
+  { cmdGETCALIN,      ToninoSerial::getCheckCalInit, NULL },  // legacy
+  { cmdGETCALINIT,    ToninoSerial::getCheckCalInit, NULL },
+  { cmdGETCALSTATS,   ToninoSerial::getCalibrationStats, NULL },
+  { cmdGETCMODE,      ToninoSerial::getColorMode, NULL },
+  { cmdGETCONF,       ToninoSerial::getConfig, NULL },
+  { cmdGETENERGY,     ToninoSerial::getEnergy, NULL },
+  { cmdGETFASTBOOT,   ToninoSerial::getFastBoot, NULL },
+  { cmdGETLOG,        ToninoSerial::getLog, NULL },
+  { cmdGETLTDEL,      ToninoSerial::getDelayTillUpTest, NULL }, // legacy
+  { cmdGETLTDELAY,    ToninoSerial::getDelayTillUpTest, NULL },
+  { cmdGETPOWER,      ToninoSerial::getPower, NULL },
+  { cmdGETPROFILE,    ToninoSerial::getProfile, NULL },
+  { cmdGETSAMPL,      ToninoSerial::getSampling, NULL },      // legacy
+  { cmdGETSAMPLING,   ToninoSerial::getSampling, NULL },
+  { cmdGETSCALI,      ToninoSerial::getScaling, NULL },       // legacy
+  { cmdGETSCALING,    ToninoSerial::getScaling, NULL },
+  { cmdGETSETTLE,     ToninoSerial::getSettle, NULL },
+  { cmdGETTHROUGHPUT, ToninoSerial::getThroughput, NULL },
+  { cmdII_SCAN,       ToninoSerial::ii_scan, NULL },
+  { cmdI_SCAN,        ToninoSerial::i_scan, NULL },
+  { cmdREADPROFILE,   ToninoSerial::readProfile, NULL },
+  { cmdRESETDEF,      ToninoSerial::resetToDefaults, NULL },
+  { cmdREVERT,        ToninoSerial::revertSession, NULL },
+  { cmdSCAN,          ToninoSerial::scan, NULL },
+  { cmdSCANX,         ToninoSerial::scanx, NULL },
+  { cmdSESSION,       ToninoSerial::beginSession, NULL },
+  { cmdSETBAUD,       ToninoSerial::setBaud, NULL },
+  { cmdSETBRIGH,      ToninoSerial::setBrightness, NULL },    // legacy
+  { cmdSETBRIGHTNESS, ToninoSerial::setBrightness, NULL },
+  { cmdSETCAL,        ToninoSerial::setCalibration, NULL },
+  { cmdSETCALIN,      ToninoSerial::setCheckCalInit, NULL },  // legacy
+  { cmdSETCALINIT,    ToninoSerial::setCheckCalInit, NULL },
+  { cmdSETCMODE,      ToninoSerial::setColorMode, NULL },
+  { cmdSETCONF,       ToninoSerial::setConfig, ToninoSerial::setConfigArg },
+  { cmdSETFASTBOOT,   ToninoSerial::setFastBoot, NULL },
+  { cmdSETLTDEL,      ToninoSerial::setDelayTillUpTest, NULL }, // legacy
+  { cmdSETLTDELAY,    ToninoSerial::setDelayTillUpTest, NULL },
+  { cmdSETPOWER,      ToninoSerial::setPower, NULL },
+  { cmdSETPROFILE,    ToninoSerial::setProfile, NULL },
+  { cmdSETSAMPL,      ToninoSerial::setSampling, NULL },      // legacy
+  { cmdSETSAMPLING,   ToninoSerial::setSampling, NULL },
+  { cmdSETSCALI,      ToninoSerial::setScaling, NULL },       // legacy
+  { cmdSETSCALING,    ToninoSerial::setScaling, NULL },
+  { cmdSETTHROUGHPUT, ToninoSerial::setThroughput, NULL },
+  { cmdSUBSCRIBE,     ToninoSerial::subscribe, NULL },
+  { cmdTONINO,        ToninoSerial::getVersion, NULL }
+};
+
+ToninoSerial::ToninoSerial(TCS3200 *colorSense, LCD *display, ToninoConfig *tConfig, const char *ver, ToninoLog *log, ToninoPower *power,
+                           ToninoCalibration *calibration) {
   _colorSense = colorSense;
   _display = display;
   _tConfig = tConfig;
   _version = ver;
+  _log = log;
+  _power = power;
+  _calibration = calibration;
 }
 
 ToninoSerial::~ToninoSerial(void) {
@@ -61,14 +204,163 @@ boolean ToninoSerial::isInvalidNumber(float f) {
   return isnan(f) || isinf(f) || f > 4294967040.0 || f <-4294967040.0 || f == 0x7fffffff || f == (-0x7fffffff -1L);
 }
 
-// poll if there is an incoming serial command
+// poll if there is an incoming serial command; queued commands are executed in order, one per call
 boolean ToninoSerial::checkCommands() {
-   return _sCmd.readSerial();
+  boolean handled = false;
+  receive();
+  while (!handled && _queueLen > 0) {
+    uint8_t c = _queue[_queueHead];
+    _queueHead = (_queueHead + 1) % SERIAL_QUEUE;
+    --_queueLen;
+    if (_binary) {
+      _lastRx = millis();
+      handled = frameByte(c);
+    } else {
+      handled = _sCmd.processChar(c);
+    }
+    receive();
+  }
+  if (_oldSpeed != 0 && millis() - _speedChanged > BAUD_TIMEOUT) {
+    WRITEDEBUGLN("baud timeout");
+    setSpeed(_oldSpeed);
+    _oldSpeed = 0;
+    _queueLen = 0;
+    _sCmd.clearBuffer();
+  }
+  if (_binary && millis() - _lastRx > BIN_TIMEOUT) {
+    WRITEDEBUGLN("binary timeout");
+    _binary = false;
+    _sCmd.clearBuffer();
+  }
+  return handled;
+}
+
+// switches serial communication to the given baud rate
+void ToninoSerial::setSpeed(uint32_t speed) {
+  if (speed != _speed) {
+    Serial.flush();
+    Serial.begin(speed);
+    _speed = speed;
+    ToninoClock::init(speed);
+  }
+}
+
+// to be called after serial input woke up the Tonino from power down: as the first bytes
+// were lost while the UART was stopped, the rest of that line is discarded and answered with WAKE
+void ToninoSerial::resync() {
+  uint32_t lastRx = millis();
+  while (millis() - lastRx < WAKE_QUIET) {
+    if (Serial.available() > 0) {
+      lastRx = millis();
+      if (Serial.read() == '\n') {
+        break;
+      }
+    }
+  }
+  _queueLen = 0;
+  _sCmd.clearBuffer();
+  respond(F("WAKE"));
+}
+
+// moves received bytes from the serial lib to the command queue
+// called while waiting (see yield()) such that commands sent during a scan are not lost
+void ToninoSerial::receive() {
+  while (_queueLen < SERIAL_QUEUE && Serial.available() > 0) {
+    _queue[(_queueHead + _queueLen) % SERIAL_QUEUE] = Serial.read();
+    ++_queueLen;
+  }
+}
+
+// true if received input still needs to be processed by checkCommands()
+boolean ToninoSerial::pending() {
+  return _queueLen > 0 || Serial.available() > 0;
+}
+
+// starts an event line with the given name and the current time, e.g. !LIFT:52010
+void ToninoSerial::startEvent(ToninoResponse *event, const __FlashStringHelper *name) {
+  event->write('!');
+  event->print(name);
+  event->write(':');
+  event->print((int32_t)millis());
+}
+
+// a scan with its T-value and raw values, e.g. !SCAN:52310 63 8713 5120 3402 17530 63 0
+void ToninoSerial::pushScan(int32_t tval, sensorData *sd, boolean averaged) {
+  if (!_subscribed || _binary) {
+    return;
+  }
+  ToninoResponse event;
+  startEvent(&event, F("SCAN"));
+  event.print(SEPARATOR);
+  event.print(tval);
+  for (int i = 0; i < 5; ++i) {
+    event.print(SEPARATOR);
+    event.print(sd->value[i]);
+  }
+  event.print(SEPARATOR);
+  event.print(averaged ? 1 : 0);
+  event.write('\n');
+  event.send();
+}
+
+// the can has been lifted (1) or put down (0), e.g. !LIFT:52010 1
+void ToninoSerial::pushLift(boolean up) {
+  if (!_subscribed || _binary) {
+    return;
+  }
+  ToninoResponse event;
+  startEvent(&event, F("LIFT"));
+  event.print(SEPARATOR);
+  event.print(up ? 1 : 0);
+  event.write('\n');
+  event.send();
+}
+
+// the power state changed to one of POWER_STATE_*, e.g. !POWER:112310 1
+// waits until the event has been sent as the Tonino might go to sleep
+void ToninoSerial::pushPower(uint8_t state) {
+  if (!_subscribed || _binary) {
+    return;
+  }
+  ToninoResponse event;
+  startEvent(&event, F("POWER"));
+  event.print(SEPARATOR);
+  event.print(state);
+  event.write('\n');
+  event.send();
+  Serial.flush();
+}
+
+// the calibration entered one of the CAL_xxx states for the given plate, with a CAL_ERR_xxx reason if it failed, e.g. !CAL:20410 4 0 0
+void ToninoSerial::pushCalibration(uint8_t state, uint8_t plate, uint8_t reason) {
+  if (!_subscribed || _binary) {
+    return;
+  }
+  ToninoResponse event;
+  startEvent(&event, F("CAL"));
+  event.print(SEPARATOR);
+  event.print(state);
+  event.print(SEPARATOR);
+  event.print(plate);
+  event.print(SEPARATOR);
+  event.print(reason);
+  event.write('\n');
+  event.send();
+}
+
+// sends msg with the request ID of the current command followed by newline
+void ToninoSerial::respond(const __FlashStringHelper *msg) {
+  ToninoResponse reply(_sCmd.requestId());
+  reply.print(msg);
+  reply.write('\n');
+  reply.send();
 }
 
 // initializes serial communication and registers functions for serial commands
 void ToninoSerial::init(uint32_t speed) {
   Serial.begin(speed);
+  _speed = speed;
+  ToninoClock::init(speed);
 
 //  WRITEDEBUGLN("[Tonino]");
 //  WRITEDEBUGLN("Available Commands");
@@ -77,6 +369,7 @@ void ToninoSerial::init(uint32_t speed) {
 //  WRITEDEBUGLN("  I_SCAN : scan and return w/b");
 //  WRITEDEBUGLN("  II_SCAN : scan and return raw values");
 //  WRITEDEBUGLN("  D_SCAN : scan without LEDs and return raw values");
+//  WRITEDEBUGLN("  SCANX : scan with given parameters and return raw values");
 //  WRITEDEBUGLN("  SETCAL : store calibration values");
 //  WRITEDEBUGLN("  GETCAL : retrieve current calibration values");
 //  WRITEDEBUGLN("  SETSCALING : store scaling values");
@@ -92,55 +385,79 @@ void ToninoSerial::init(uint32_t speed) {
 //  WRITEDEBUGLN("  SETLTDELAY: set delay between can-up measurements, in 1/10sec");
 //  WRITEDEBUGLN("  GETLTDELAY: get delay between can-up measurements, in 1/10sec");
 //  WRITEDEBUGLN("  RESETDEF: reset settings back to defaults");
-  
-  // ATTENTION: only the first SERIALCOMMAND_MAXCOMMANDLENGTH (def=8) characters of the command are used
+//  WRITEDEBUGLN("  SETFASTBOOT: use (1) or not (0) fast boot");
+//  WRITEDEBUGLN("  GETFASTBOOT: is (1) or is not (0) fast boot used");
+//  WRITEDEBUGLN("  GETBOOT: get boot timeline in microseconds");
+//  WRITEDEBUGLN("  GETLOG: get scan history");
+//  WRITEDEBUGLN("  GETCONF: get complete configuration (base64)");
+//  WRITEDEBUGLN("  SETCONF: set complete configuration (base64)");
+//  WRITEDEBUGLN("  SETPROFILE: switch to profile");
+//  WRITEDEBUGLN("  GETPROFILE: get current profile and number of profiles");
+//  WRITEDEBUGLN("  READPROFILE: get parameters of profile");
+//  WRITEDEBUGLN("  BINARY: switch to binary mode");
+//  WRITEDEBUGLN("  SUBSCRIBE: send (1) or do not send (0) events");
+//  WRITEDEBUGLN("  SETBAUD: change baud rate");
+//  WRITEDEBUGLN("  SESSION: keep following settings in RAM only");
+//  WRITEDEBUGLN("  COMMIT: store settings of session to EEPROM");
+//  WRITEDEBUGLN("  REVERT: discard settings of session");
+//  WRITEDEBUGLN("  GETENERGY: get estimated charge per hour of each power state");
+//  WRITEDEBUGLN("  SETPOWER: set times till dim, sleep and power down, in sec");
+//  WRITEDEBUGLN("  GETPOWER: get power times and stats");
+//  WRITEDEBUGLN("  SETTHROUGHPUT: set throughput mode 0/1");
+//  WRITEDEBUGLN("  GETTHROUGHPUT: get throughput mode and scans per minute");
+//  WRITEDEBUGLN("  GETSETTLE: get settle time stats");
+//  WRITEDEBUGLN("  CALIBRATE: start (1) or abort (0) calibration");
+//  WRITEDEBUGLN("  GETCALSTATS: get r/b ratios and spread of last calibration");
   
   // setup callbacks for SerialCommand commands
-  _sCmd.addCommand("TONINO", getVersion);
-  _sCmd.addCommand("SCAN", scan);
-  _sCmd.addCommand("I_SCAN", i_scan);
-  _sCmd.addCommand("II_SCAN", ii_scan);
-  _sCmd.addCommand("D_SCAN", d_scan);
-  _sCmd.addCommand("SETCAL", setCalibration);
-  _sCmd.addCommand("GETCAL", getCalibration);
-  _sCmd.addCommand("SETSCALI", setScaling);
-  _sCmd.addCommand("GETSCALI", getScaling);
-  _sCmd.addCommand("SETBRIGH", setBrightness);
-  _sCmd.addCommand("GETBRIGH", getBrightness);
-  _sCmd.addCommand("SETSAMPL", setSampling);
-  _sCmd.addCommand("GETSAMPL", getSampling);
-  _sCmd.addCommand("SETCMODE", setColorMode);
-  _sCmd.addCommand("GETCMODE", getColorMode);
-  _sCmd.addCommand("SETCALIN", setCheckCalInit);
-  _sCmd.addCommand("GETCALIN", getCheckCalInit);
-  _sCmd.addCommand("SETLTDEL", setDelayTillUpTest);
-  _sCmd.addCommand("GETLTDEL", getDelayTillUpTest);
-  _sCmd.addCommand("RESETDEF", resetToDefaults);
+  _sCmd.setCommands(commands, sizeof(commands) / sizeof(commands[0]));
+  _sCmd.setDefaultHandler(unknownCommand);
+}
+
+// answer unknown commands with an error such that hosts do not wait for a timeout
+void ToninoSerial::unknownCommand(const char *command) {
+  WRITEDEBUG("unknown cmd ");
+  WRITEDEBUGLN(command);
+  ToninoResponse reply(_sCmd.requestId());
+  reply.print(command);
+  reply.print(F(" ERROR"));
+  reply.write('\n');
+  reply.send();
+}
+
+// shows a T-value on the LCD, animated if snake is true, or a line if out of range
+void ToninoSerial::displayValue(int32_t val, boolean snake) {
+  if (val < (snake ? 0 : -999) || val > 9999) {
+    _display->line();
+  } else if (snake) {
+    _display->snake(val);
+  } else {
+    _display->printNumber(val);
+  }
 }
 
 // print version to serial
 void ToninoSerial::getVersion() {
-  Serial.print("TONINO:");
-  Serial.print(_version);
-  Serial.print("\n");
+  ToninoResponse reply(_sCmd.requestId());
+  reply.print(F("TONINO:"));
+  reply.print(_version);
+  reply.write('\n');
+  reply.send();
   
   _display->connected();
 }
 
 // make a measurement and print result to serial (and LCD)
 void ToninoSerial::scan() {
-  sensorData col;
   int32_t val = _colorSense->scan();
 
-  Serial.print("SCAN:");
-  Serial.print(val);
-  Serial.print("\n");
+  ToninoResponse reply(_sCmd.requestId());
+  reply.print(F("SCAN:"));
+  reply.print(val);
+  reply.write('\n');
+  reply.send();
 
-  if (val < 0 || val > 9999) {
-    _display->line();
-  } else {
-    _display->snake(val);
-  }
+  displayValue(val, true);
 }
 
 // make a measurement and print calibrated, w/b value to serial 
@@ -149,15 +466,13 @@ void ToninoSerial::i_scan() {
   float ratio = 0.0;
   int32_t val = _colorSense->scan(&ratio);
   
-  Serial.print("I_SCAN:");
-  Serial.print(ratio, 6);
-  Serial.print("\n");
+  ToninoResponse reply(_sCmd.requestId());
+  reply.print(F("I_SCAN:"));
+  reply.print(ratio, 6);
+  reply.write('\n');
+  reply.send();
 
-  if (val < -999 || val > 9999) {
-    _display->line();
-  } else {
-    _display->printNumber(val);
-  }
+  displayValue(val);
 }
 
 // make a measurement and print raw color values to serial 
@@ -166,18 +481,16 @@ void ToninoSerial::ii_scan() {
   sensorData sd;
   int32_t val = _colorSense->scan(NULL, false, &sd);
   
-  Serial.print("II_SCAN:");
+  ToninoResponse reply(_sCmd.requestId());
+  reply.print(F("II_SCAN:"));
   for (int i = 0; i < 5; ++i) {
-    Serial.print(sd.value[i]);
-    Serial.print(SEPARATOR);
+    reply.print(sd.value[i]);
+    reply.print(SEPARATOR);
   }
-  Serial.print("\n");
+  reply.write('\n');
+  reply.send();
 
-  if (val < -999 || val > 9999) {
-    _display->line();
-  } else {
-    _display->printNumber(val);
-  }
+  displayValue(val);
 }
 
 // make a measurement with LEDs switched off and print raw color values to serial 
@@ -185,12 +498,55 @@ void ToninoSerial::d_scan() {
   sensorData sd;
   _colorSense->scan(NULL, false, &sd, false);
   
-  Serial.print("D_SCAN:");
+  ToninoResponse reply(_sCmd.requestId());
+  reply.print(F("D_SCAN:"));
   for (int i = 0; i < 4; ++i) {
-    Serial.print(sd.value[i]);
-    Serial.print(SEPARATOR);
+    reply.print(sd.value[i]);
+    reply.print(SEPARATOR);
+  }
+  reply.write('\n');
+  reply.send();
+}
+
+// make a measurement with the given parameters and print raw color values to serial
+// (and T-value to LCD if LEDs were on); neither the profile nor the EEPROM is changed
+// parameters: sampling colormode led ambient subgates, all optional
+void ToninoSerial::scanx() {
+  // defaults: sampling and color mode of profile, LEDs on, no ambient removal, one gate
+  static const int32_t defaults[5] = { 0, 0, 1, 0, 1 };
+  static const int32_t maxima[5] = { 100, COLOR_FULL, 1, 1, MAX_SUBGATES };
+  int32_t params[5];
+  for (uint8_t i = 0; i < 5; ++i) {
+    char *arg = _sCmd.next();
+    params[i] = (arg == NULL ? defaults[i] : strtol(arg, NULL, 10));
+    if (params[i] < 0 || params[i] > maxima[i] || (i == 4 && params[i] == 0)) {
+      WRITEDEBUG("SCANX ERR:range ");
+      WRITEDEBUGLN(params[i]);
+      respond(F("SCANX ERROR"));
+      return;
+    }
+  }
+  if (_sCmd.next() != NULL) {
+    respond(F("SCANX ERROR"));
+    return;
+  }
+
+  sensorData sd;
+  int32_t val = _colorSense->scan(NULL, false, &sd, params[2] == 1, params[3] == 1, NULL,
+                                  (uint8_t)params[0], (uint8_t)params[1], (uint8_t)params[4]);
+
+  ToninoResponse reply(_sCmd.requestId());
+  reply.print(F("SCANX:"));
+  for (int i = 0; i < 5; ++i) {
+    reply.print(sd.value[i]);
+    reply.print(SEPARATOR);
+  }
+  reply.write('\n');
+  reply.send();
+
+  if (params[2] == 1) {
+    displayValue(val);
   }
-  Serial.print("\n");
 }
 
 // store calibration data from serial to local vars and EEPROM
@@ -200,33 +556,46 @@ void ToninoSerial::setCalibration() {
   // parse input
   for (int c = 0; c < NR_CAL_VALUES; ++c) {
     char *arg = _sCmd.next();
-		cal[c] = atof(arg);
+    cal[c] = (arg == NULL ? NAN : atof(arg));
     if (isInvalidNumber(cal[c])) {
       WRITEDEBUG("SETCAL ERR:inv num ");
       WRITEDEBUGLN(cal[c]);
-      Serial.print("SETCAL ERROR");
-      Serial.print("\n");
+      respond(F("SETCAL ERROR"));
       return;
     }
     WRITEDEBUG(cal[c]);
     WRITEDEBUG(" ");
   }
-  WRITEDEBUGLN();
-  _tConfig->setCalibration(cal);
-  Serial.print("SETCAL");
-  Serial.print("\n");
+  // optional quadratic term
+  char *arg = _sCmd.next();
+  float quad = (arg == NULL ? 0.0 : atof(arg));
+  if (isInvalidNumber(quad) || abs(quad) > CAL_QUAD_MAX || _sCmd.next() != NULL) {
+    respond(F("SETCAL ERROR"));
+    return;
+  }
+  WRITEDEBUGLN(quad);
+  _tConfig->setCalibration(cal, quad);
+  respond(F("SETCAL"));
 }
 
 // print current calibration data to serial
 void ToninoSerial::getCalibration() {
   float cal[NR_CAL_VALUES];
   _colorSense->getCalibration(cal);
-  Serial.print("GETCAL:");
+  ToninoResponse reply(_sCmd.requestId());
+  reply.print(F("GETCAL:"));
   for (int i = 0; i < NR_CAL_VALUES; ++i) {
-    Serial.print(cal[i], 6);
-    Serial.print(SEPARATOR);
+    reply.print(cal[i], 6);
+    reply.print(SEPARATOR);
   }
-  Serial.print("\n");
+  // the quadratic term only if there is one such that the reply to linear calibrations stays the same
+  float quad = _colorSense->getQuadratic();
+  if (quad != 0.0) {
+    reply.print(quad, 6);
+    reply.print(SEPARATOR);
+  }
+  reply.write('\n');
+  reply.send();
 }
 
 // store scaling data from serial to local vars and EEPROM
@@ -237,12 +606,11 @@ void ToninoSerial::setScaling() {
   WRITEDEBUG("[scale] ");
   for (int c = 0; c < NR_SCALE_VALUES; ++c) {
     char *arg = _sCmd.next();
-    scal[c] = atof(arg);
+    scal[c] = (arg == NULL ? NAN : atof(arg));
     if (isInvalidNumber(scal[c])) {
       WRITEDEBUG("SETSCALING ERR:inv num ");
       WRITEDEBUGLN(scal[c]);
-      Serial.print("SETSCALING ERROR");
-      Serial.print("\n");
+      respond(F("SETSCALING ERROR"));
       return;
     }
     WRITEDEBUG(scal[c]);
@@ -250,171 +618,748 @@ void ToninoSerial::setScaling() {
   }
   WRITEDEBUGLN();
   _tConfig->setScaling(scal);
-  Serial.print("SETSCALING");
-  Serial.print("\n");
+  respond(F("SETSCALING"));
 }
 
 // print current scaling data to serial
 void ToninoSerial::getScaling() {
   float cal[NR_SCALE_VALUES];
   _colorSense->getScaling(cal);
-  Serial.print("GETSCALING:");
+  ToninoResponse reply(_sCmd.requestId());
+  reply.print(F("GETSCALING:"));
   for (int i = 0; i < NR_SCALE_VALUES; ++i) {
-    Serial.print(cal[i], 6);
-    Serial.print(SEPARATOR);
+    reply.print(cal[i], 6);
+    reply.print(SEPARATOR);
   }
-  Serial.print("\n");
+  reply.write('\n');
+  reply.send();
 }
 
 // sets the display brightness (0-15, 15=max brightness) and store in EEPROM
 void ToninoSerial::setBrightness() {
   // get from serial
   char *arg = _sCmd.next();
-  int32_t b = strtol(arg, NULL, 10);
+  int32_t b = (arg == NULL ? -1 : strtol(arg, NULL, 10));
   if (isInvalidNumber(b)) {
     WRITEDEBUG("SETBRIGHTNESS ERR:inv num ");
     WRITEDEBUGLN(b);
-    Serial.print("SETBRIGHTNESS ERROR");
-    Serial.print("\n");
+    respond(F("SETBRIGHTNESS ERROR"));
     return;
   }
   if (b < 0 || b > 15) {
     WRITEDEBUG("SETBRIGHTNESS ERR:range ");
     WRITEDEBUGLN(b);
-    Serial.print("SETBRIGHTNESS ERROR");
-    Serial.print("\n");
+    respond(F("SETBRIGHTNESS ERROR"));
   } else {
     _tConfig->setBrightness((uint8_t)b);
-    Serial.print("SETBRIGHTNESS");
-    Serial.print("\n");
+    respond(F("SETBRIGHTNESS"));
   }
 }
 
 // print current scaling data to serial
 void ToninoSerial::getBrightness() {
-  Serial.print("GETBRIGHTNESS:");
-  Serial.print(_display->getBrightness());
-  Serial.print("\n");
+  ToninoResponse reply(_sCmd.requestId());
+  reply.print(F("GETBRIGHTNESS:"));
+  reply.print(_display->getBrightness());
+  reply.write('\n');
+  reply.send();
 }
 
 // save sampling rate setting from serial to sensor library and EEPROM
 void ToninoSerial::setSampling() {
   // get from serial
   char *arg = _sCmd.next();
-  int32_t sampling = strtol(arg, NULL, 10);
+  int32_t sampling = (arg == NULL ? -1 : strtol(arg, NULL, 10));
   if (isInvalidNumber(sampling)) {
     WRITEDEBUG("SETSAMPLING ERR:inv num ");
     WRITEDEBUGLN(sampling);
-    Serial.print("SETSAMPLING ERROR");
-    Serial.print("\n");
+    respond(F("SETSAMPLING ERROR"));
     return;
   }
   if (sampling <= 0 || sampling > 100) {
     WRITEDEBUG("SETSAMPLING ERR:range ");
     WRITEDEBUGLN(sampling);
-    Serial.print("SETSAMPLING ERROR");
-    Serial.print("\n");
+    respond(F("SETSAMPLING ERROR"));
   } else {
     _tConfig->setSampling((uint8_t)sampling);
-    Serial.print("SETSAMPLING");
-    Serial.print("\n");
+    respond(F("SETSAMPLING"));
   }
 }
 
 // retrieve sampling rate setting from sensor library
 void ToninoSerial::getSampling() {
-  Serial.print("GETSAMPLING:");
-  Serial.print(_colorSense->getSampling());
-  Serial.print("\n");
+  ToninoResponse reply(_sCmd.requestId());
+  reply.print(F("GETSAMPLING:"));
+  reply.print(_colorSense->getSampling());
+  reply.write('\n');
+  reply.send();
 }
 
 // save color mode setting from serial to sensor library and EEPROM
 void ToninoSerial::setColorMode() {
   // get from serial
   char *arg = _sCmd.next();
-  int32_t cmode = strtol(arg, NULL, 10);
+  int32_t cmode = (arg == NULL ? -1 : strtol(arg, NULL, 10));
   if (isInvalidNumber(cmode)) {
     WRITEDEBUG("SETCMODE ERR:inv ");
     WRITEDEBUGLN(cmode);
-    Serial.print("SETCMODE ERROR");
-    Serial.print("\n");
+    respond(F("SETCMODE ERROR"));
     return;
   }
   if (cmode <= 0 || cmode > COLOR_FULL) {
     WRITEDEBUG("SETCMODE ERR:range ");
     WRITEDEBUGLN(cmode);
-    Serial.print("SETCMODE ERROR");
-    Serial.print("\n");
+    respond(F("SETCMODE ERROR"));
   } else {
     _tConfig->setColorMode((uint8_t)cmode);
-    Serial.print("SETCMODE");
-    Serial.print("\n");
+    respond(F("SETCMODE"));
   }
 }
 
 // retrieve color mode setting from sensor library
 void ToninoSerial::getColorMode() {
-  Serial.print("GETCMODE:");
-  Serial.print(_colorSense->getColorMode());
-  Serial.print("\n");
+  ToninoResponse reply(_sCmd.requestId());
+  reply.print(F("GETCMODE:"));
+  reply.print(_colorSense->getColorMode());
+  reply.write('\n');
+  reply.send();
 }
 
 // save initial calibration setting to EEPROM
 void ToninoSerial::setCheckCalInit() {
   // get from serial
   char *arg = _sCmd.next();
-  int16_t iwc = atoi(arg);
+  int16_t iwc = (arg == NULL ? -1 : atoi(arg));
   if (_sCmd.next() != NULL || (iwc != 0 && iwc != 1)) {
-    Serial.print("SETCALINIT ERROR");
-    Serial.print("\n");
+    respond(F("SETCALINIT ERROR"));
   } else {
     _tConfig->setCheckCalInit(iwc == 0 ? false : true);
-    Serial.print("SETCALINIT");
-    Serial.print("\n");
+    respond(F("SETCALINIT"));
   }
 }
 
 // retrieve initial wihte calibration setting
 void ToninoSerial::getCheckCalInit() {
-  Serial.print("GETCALINIT:");
-  Serial.print(_tConfig->getCheckCalInit() ? 1 : 0);
-  Serial.print("\n");
+  ToninoResponse reply(_sCmd.requestId());
+  reply.print(F("GETCALINIT:"));
+  reply.print(_tConfig->getCheckCalInit() ? 1 : 0);
+  reply.write('\n');
+  reply.send();
 }
 
 // save delay between can-up measurements, in 1/10sec to EEPROM
 void ToninoSerial::setDelayTillUpTest() {
   // get from serial
   char *arg = _sCmd.next();
-  int32_t ltdelay = strtol(arg, NULL, 10);
+  int32_t ltdelay = (arg == NULL ? -1 : strtol(arg, NULL, 10));
   if (isInvalidNumber(ltdelay)) {
     WRITEDEBUG("SETLTDELAY ERR:inv");
     WRITEDEBUGLN(ltdelay);
-    Serial.print("SETLTDELAY ERROR");
-    Serial.print("\n");
+    respond(F("SETLTDELAY ERROR"));
     return;
   }
   if (ltdelay < 0 || ltdelay >= 256) {
     WRITEDEBUG("SETLTDELAY ERR:range ");
     WRITEDEBUGLN(ltdelay);
-    Serial.print("SETLTDELAY ERROR");
-    Serial.print("\n");
+    respond(F("SETLTDELAY ERROR"));
   } else {
     _tConfig->setDelayTillUpTest((uint8_t)ltdelay);
-    Serial.print("SETLTDELAY");
-    Serial.print("\n");
+    respond(F("SETLTDELAY"));
   }
 }
 
 // retrieve initial wihte calibration setting
 void ToninoSerial::getDelayTillUpTest() {
-  Serial.print("GETLTDELAY:");
-  Serial.print(_tConfig->getDelayTillUpTest());
-  Serial.print("\n");
+  ToninoResponse reply(_sCmd.requestId());
+  reply.print(F("GETLTDELAY:"));
+  reply.print(_tConfig->getDelayTillUpTest());
+  reply.write('\n');
+  reply.send();
 }
 
 // reset settings back to defaults
 void ToninoSerial::resetToDefaults() {
   _tConfig->writeDefaults();
-  Serial.print("RESETDEF");
-  Serial.print("\n");
+  respond(F("RESETDEF"));
+}
+
+// save fast boot setting to EEPROM
+void ToninoSerial::setFastBoot() {
+  // get from serial
+  char *arg = _sCmd.next();
+  int16_t fb = (arg == NULL ? -1 : atoi(arg));
+  if (_sCmd.next() != NULL || (fb != 0 && fb != 1)) {
+    respond(F("SETFASTBOOT ERROR"));
+  } else {
+    _tConfig->setFastBoot(fb == 1);
+    respond(F("SETFASTBOOT"));
+  }
+}
+
+// send (1) or do not send (0) events for stand-alone scans, can lifting and power state changes
+void ToninoSerial::subscribe() {
+  // get from serial
+  char *arg = _sCmd.next();
+  int16_t sub = (arg == NULL ? -1 : atoi(arg));
+  if (_sCmd.next() != NULL || (sub != 0 && sub != 1)) {
+    respond(F("SUBSCRIBE ERROR"));
+  } else {
+    _subscribed = (sub == 1);
+    respond(F("SUBSCRIBE"));
+  }
+}
+
+// start (no argument or 1) or abort (0) the calibration with the calibration plates
+// or, if a model and target values are given, with that number of reference plates
+void ToninoSerial::calibrate() {
+  // get from serial
+  char *arg = _sCmd.next();
+  int16_t on = (arg == NULL ? 1 : atoi(arg));
+  arg = _sCmd.next();
+  int16_t model = (arg == NULL ? 0 : atoi(arg));
+  float targets[CAL_MAX_PLATES];
+  uint8_t plates = 0;
+  boolean invalid = false;
+  while ((arg = _sCmd.next()) != NULL) {
+    if (plates == CAL_MAX_PLATES) {
+      invalid = true;
+      break;
+    }
+    targets[plates] = atof(arg);
+    invalid = invalid || isInvalidNumber(targets[plates]);
+    ++plates;
+  }
+  if (_calibration == NULL || invalid || (on != 0 && on != 1) ||
+      (on == 0 && (model != 0 || !_calibration->active())) ||
+      (model != 0 && !ToninoCalibration::isValid(plates, model))) {
+    respond(F("CALIBRATE ERROR"));
+  } else {
+    // respond first such that the reply precedes the !CAL event
+    respond(F("CALIBRATE"));
+    if (on == 0) {
+      _calibration->abort();
+    } else if (model == 0) {
+      _calibration->start();
+    } else {
+      _calibration->start(plates, model, targets);
+    }
+  }
+}
+
+// print model and number of plates of the last calibration and for each plate the mean r/b ratio,
+// its standard deviation, the number of scans used after outlier rejection and the residual of the fit
+void ToninoSerial::getCalibrationStats() {
+  if (_calibration == NULL) {
+    respond(F("GETCALSTATS ERROR"));
+    return;
+  }
+  ToninoResponse reply(_sCmd.requestId());
+  reply.print(F("GETCALSTATS:"));
+  reply.print(_calibration->getModel());
+  reply.print(SEPARATOR);
+  reply.print(_calibration->getPlates());
+  for (uint8_t p = 0; p < _calibration->getPlates(); ++p) {
+    reply.print(SEPARATOR);
+    reply.print(_calibration->getRatio(p), 5);
+    reply.print(SEPARATOR);
+    reply.print(_calibration->getDeviation(p), 5);
+    reply.print(SEPARATOR);
+    reply.print((int32_t)_calibration->getScans(p));
+    reply.print(SEPARATOR);
+    reply.print(_calibration->getResidual(p), 5);
+  }
+  reply.write('\n');
+  reply.send();
+}
+
+// start a session in which settings are changed in RAM only
+void ToninoSerial::beginSession() {
+  if (_sCmd.next() != NULL) {
+    respond(F("SESSION ERROR"));
+  } else {
+    _tConfig->beginSession();
+    respond(F("SESSION"));
+  }
+}
+
+// store all settings changed during the session to EEPROM and end the session
+void ToninoSerial::commitSession() {
+  if (_sCmd.next() != NULL || !_tConfig->commitSession()) {
+    respond(F("COMMIT ERROR"));
+  } else {
+    respond(F("COMMIT"));
+  }
+}
+
+// discard all settings changed during the session and end the session
+void ToninoSerial::revertSession() {
+  if (_sCmd.next() != NULL || !_tConfig->revertSession()) {
+    respond(F("REVERT ERROR"));
+  } else {
+    respond(F("REVERT"));
+  }
+}
+
+// change the baud rate with confirmation at the new rate, see header
+void ToninoSerial::setBaud() {
+  // get from serial
+  char *arg = _sCmd.next();
+  uint32_t baud = (arg == NULL ? 0 : strtoul(arg, NULL, 10));
+  arg = _sCmd.next();
+  int16_t persist = (arg == NULL ? 0 : atoi(arg));
+  if (_sCmd.next() != NULL || ToninoConfig::baudRateIndex(baud) < 0 || (persist != 0 && persist != 1)) {
+    WRITEDEBUG("SETBAUD ERR:inv ");
+    WRITEDEBUGLN(baud);
+    respond(F("SETBAUD ERROR"));
+  } else if (_oldSpeed != 0 && baud == _speed) {
+    // confirmation at the new rate
+    _oldSpeed = 0;
+    if (_persistSpeed) {
+      _tConfig->setBaudRate(baud);
+    }
+    ToninoResponse reply(_sCmd.requestId());
+    reply.print(F("SETBAUD:"));
+    reply.print((int32_t)baud);
+    reply.write('\n');
+    reply.send();
+  } else {
+    // acknowledge at the old rate, then switch
+    respond(F("SETBAUD"));
+    if (_oldSpeed == 0) {
+      _oldSpeed = _speed;
+    }
+    _persistSpeed = (persist == 1);
+    _speedChanged = millis();
+    setSpeed(baud);
+  }
+}
+
+// retrieve fast boot setting
+void ToninoSerial::getFastBoot() {
+  ToninoResponse reply(_sCmd.requestId());
+  reply.print(F("GETFASTBOOT:"));
+  reply.print(_tConfig->getFastBoot() ? 1 : 0);
+  reply.write('\n');
+  reply.send();
+}
+
+// print the boot timeline in microseconds since reset
+void ToninoSerial::getBootTimes() {
+  ToninoResponse reply(_sCmd.requestId());
+  reply.print(F("GETBOOT:"));
+  for (uint8_t i = 0; i < NR_BOOT_STAGES; ++i) {
+    if (i > 0) {
+      reply.print(SEPARATOR);
+    }
+    reply.print(bootTimes[i]);
+  }
+  reply.write('\n');
+  reply.send();
+}
+
+// store the times without action (in seconds) till dimming, sleep and power down and, optionally,
+// whether they are adapted to the usage
+void ToninoSerial::setPower() {
+  // get from serial
+  uint32_t times[3];
+  for (uint8_t i = 0; i < 3; ++i) {
+    char *arg = _sCmd.next();
+    times[i] = (arg == NULL ? 0 : strtoul(arg, NULL, 10));
+  }
+  char *arg = _sCmd.next();
+  int16_t adaptive = (arg == NULL ? (_tConfig->getAdaptivePower() ? 1 : 0) : atoi(arg));
+  if (_sCmd.next() != NULL || times[0] >= times[1] || times[1] >= times[2] || times[2] > 0xFFFF ||
+      (adaptive != 0 && adaptive != 1) ||
+      !_tConfig->setPowerTimes(times[0], times[1], times[2])) {
+    WRITEDEBUGLN("SETPOWER ERR:inv");
+    respond(F("SETPOWER ERROR"));
+  } else {
+    _tConfig->setAdaptivePower(adaptive == 1);
+    respond(F("SETPOWER"));
+  }
+}
+
+// print power times, adaptive setting, times currently in effect, number of observed intervals
+// between scans and number of dims, sleeps and power downs
+void ToninoSerial::getPower() {
+  ToninoResponse reply(_sCmd.requestId());
+  reply.print(F("GETPOWER:"));
+  reply.print((int32_t)_tConfig->getDimTime());
+  reply.print(SEPARATOR);
+  reply.print((int32_t)_tConfig->getSleepTime());
+  reply.print(SEPARATOR);
+  reply.print((int32_t)_tConfig->getPowerDownTime());
+  reply.print(SEPARATOR);
+  reply.print(_tConfig->getAdaptivePower() ? 1 : 0);
+  if (_power != NULL) {
+    reply.print(SEPARATOR);
+    reply.print((int32_t)(_power->dimTime() / 1000));
+    reply.print(SEPARATOR);
+    reply.print((int32_t)(_power->sleepTime() / 1000));
+    reply.print(SEPARATOR);
+    reply.print((int32_t)_power->getIntervals());
+    reply.print(SEPARATOR);
+    reply.print((int32_t)_power->getDims());
+    reply.print(SEPARATOR);
+    reply.print((int32_t)_power->getSleeps());
+    reply.print(SEPARATOR);
+    reply.print((int32_t)_power->getPowerDowns());
+  }
+  reply.write('\n');
+  reply.send();
+}
+
+// save whether the throughput mode is on (1) or not (0) to EEPROM and config manager
+void ToninoSerial::setThroughput() {
+  // get from serial
+  char *arg = _sCmd.next();
+  int16_t tm = (arg == NULL ? -1 : atoi(arg));
+  if (_sCmd.next() != NULL || (tm != 0 && tm != 1)) {
+    respond(F("SETTHROUGHPUT ERROR"));
+  } else {
+    _tConfig->setThroughputMode(tm == 1);
+    respond(F("SETTHROUGHPUT"));
+  }
+}
+
+// print whether the throughput mode is on (1) or not (0) and the number of scans within the last minute
+void ToninoSerial::getThroughput() {
+  ToninoResponse reply(_sCmd.requestId());
+  reply.print(F("GETTHROUGHPUT:"));
+  reply.print(_tConfig->getThroughputMode() ? 1 : 0);
+  if (_log != NULL) {
+    reply.print(SEPARATOR);
+    reply.print((int32_t)_log->scansPerMinute());
+  }
+  reply.write('\n');
+  reply.send();
+}
+
+// print the number of settle detections per class of settle times and the total time saved (ms)
+// compared to waiting SETTLE_TIMEOUT
+void ToninoSerial::getSettle() {
+  ToninoResponse reply(_sCmd.requestId());
+  reply.print(F("GETSETTLE:"));
+  for (uint8_t i = 0; i < SETTLE_BUCKETS; ++i) {
+    reply.print((int32_t)_colorSense->getSettleCount(i));
+    reply.print(SEPARATOR);
+  }
+  reply.print((int32_t)_colorSense->getSettleSaved());
+  reply.write('\n');
+  reply.send();
+}
+
+// print the estimated charge drawn per hour in each energy state in mAs,
+// based on the share of time spent in that state since reset
+void ToninoSerial::getEnergy() {
+  static const uint16_t currents[NR_ENERGY_STATES] = { ENERGY_CURRENT_RUN, ENERGY_CURRENT_IDLE, ENERGY_CURRENT_SLEEP, ENERGY_CURRENT_IDLE_SLOW };
+  float total = 0.0;
+  for (uint8_t i = 0; i < NR_ENERGY_STATES; ++i) {
+    total += energyTime(i);
+  }
+  ToninoResponse reply(_sCmd.requestId());
+  reply.print(F("GETENERGY:"));
+  for (uint8_t i = 0; i < NR_ENERGY_STATES; ++i) {
+    if (i > 0) {
+      reply.print(SEPARATOR);
+    }
+    // uA * 3600s / 1000 = mAs per hour; no time counted yet right after reset
+    int32_t mAs = 0;
+    if (total > 0.0) {
+      mAs = (int32_t)(currents[i] * 3.6 * energyTime(i) / total + 0.5);
+    }
+    reply.print(mAs);
+  }
+  reply.write('\n');
+  reply.send();
+}
+
+// print the scan history, oldest first
+void ToninoSerial::getLog() {
+  ToninoResponse reply(_sCmd.requestId());
+  reply.print(F("GETLOG:"));
+  if (_log != NULL) {
+    logRecord rec;
+    bool first = true;
+    _log->rewind();
+    while (_log->next(&rec)) {
+      if (!first) {
+        reply.print(SEPARATOR);
+      }
+      first = false;
+      reply.print(rec.time);
+      reply.print(SEPARATOR);
+      reply.print(rec.tval);
+      reply.print(SEPARATOR);
+      reply.print(rec.red);
+      reply.print(SEPARATOR);
+      reply.print(rec.blue);
+      reply.print(SEPARATOR);
+      reply.print(rec.flags);
+    }
+  }
+  reply.write('\n');
+  reply.send();
+}
+
+// appends n bytes base64 encoded to reply
+void ToninoSerial::printBase64(ToninoResponse *reply, const uint8_t *buf, uint16_t n) {
+  for (uint16_t i = 0; i < n; i += 3) {
+    uint32_t triple = (uint32_t)buf[i] << 16;
+    if (i+1 < n) triple |= (uint32_t)buf[i+1] << 8;
+    if (i+2 < n) triple |= buf[i+2];
+    reply->write(pgm_read_byte(&base64Chars[(triple >> 18) & 0x3F]));
+    reply->write(pgm_read_byte(&base64Chars[(triple >> 12) & 0x3F]));
+    reply->write(i+1 < n ? pgm_read_byte(&base64Chars[(triple >> 6) & 0x3F]) : '=');
+    reply->write(i+2 < n ? pgm_read_byte(&base64Chars[triple & 0x3F]) : '=');
+  }
+}
+
+// print the complete configuration as base64 encoded blob
+void ToninoSerial::getConfig() {
+  // _buf is free as long as no SETCONF or binary frame is being received, which cannot
+  // happen while this command is executed; saves the blob on the stack next to the reply
+  _tConfig->exportConfig(_buf);
+  ToninoResponse reply(_sCmd.requestId());
+  reply.print(F("GETCONF:"));
+  printBase64(&reply, _buf, CONFIG_BLOB_SIZE);
+  reply.write('\n');
+  reply.send();
+}
+
+// validate and store a complete configuration given as base64 encoded blob
+void ToninoSerial::setConfig() {
+  if (_bufLen < 0 || !_tConfig->importConfig(_buf, _bufLen)) {
+    WRITEDEBUG("SETCONF ERR:inv ");
+    WRITEDEBUGLN(_bufLen);
+    respond(F("SETCONF ERROR"));
+  } else {
+    respond(F("SETCONF"));
+  }
+}
+
+// receives the base64 encoded blob of SETCONF character by character (streamed by SerialCommand)
+void ToninoSerial::setConfigArg(char c) {
+  if (c == '\0') {
+    // start of a new blob
+    _bufLen = 0;
+    _blobBits = 0;
+    _blobNBits = 0;
+    return;
+  }
+  if (_bufLen < 0 || c == ' ' || c == '=') {
+    // skip separators and padding, ignore all input after an error
+    return;
+  }
+  const char *b = strchr_P(base64Chars, c);
+  if (b == NULL) {
+    _bufLen = -1;
+    return;
+  }
+  _blobBits = (_blobBits << 6) | (b - base64Chars);
+  _blobNBits += 6;
+  if (_blobNBits >= 8) {
+    _blobNBits -= 8;
+    if (_bufLen >= (int16_t)SERIAL_BUFFER) {
+      _bufLen = -1;
+      return;
+    }
+    _buf[_bufLen++] = (_blobBits >> _blobNBits) & 0xFF;
+  }
+}
+
+// switch to the given profile and store the selection to EEPROM
+void ToninoSerial::setProfile() {
+  // get from serial
+  char *arg = _sCmd.next();
+  if (arg == NULL) {
+    respond(F("SETPROFILE ERROR"));
+    return;
+  }
+  int32_t p = strtol(arg, NULL, 10);
+  if (p < 0 || p >= NR_PROFILES) {
+    WRITEDEBUG("SETPROFILE ERR:range ");
+    WRITEDEBUGLN(p);
+    respond(F("SETPROFILE ERROR"));
+  } else {
+    _tConfig->selectProfile((uint8_t)p);
+    respond(F("SETPROFILE"));
+  }
+}
+
+// retrieve the index of the current profile and the number of profiles
+void ToninoSerial::getProfile() {
+  ToninoResponse reply(_sCmd.requestId());
+  reply.print(F("GETPROFILE:"));
+  reply.print(_tConfig->getProfile());
+  reply.print(SEPARATOR);
+  reply.print(NR_PROFILES);
+  reply.write('\n');
+  reply.send();
+}
+
+// print all parameters of the given profile
+void ToninoSerial::readProfile() {
+  char *arg = _sCmd.next();
+  int32_t p = (arg == NULL ? -1 : strtol(arg, NULL, 10));
+  sensorProfile *profile = ((p < 0 || p >= NR_PROFILES) ? NULL : _tConfig->getProfileData((uint8_t)p));
+  if (profile == NULL) {
+    respond(F("READPROFILE ERROR"));
+    return;
+  }
+  ToninoResponse reply(_sCmd.requestId());
+  reply.print(F("READPROFILE:"));
+  reply.print(p);
+  reply.print(SEPARATOR);
+  reply.print(profile->sampling);
+  reply.print(SEPARATOR);
+  reply.print(profile->colorMode);
+  for (int i = 0; i < NR_CAL_VALUES; ++i) {
+    reply.print(SEPARATOR);
+    reply.print(profile->cal[i], 6);
+  }
+  for (int i = 0; i < NR_SCALE_VALUES; ++i) {
+    reply.print(SEPARATOR);
+    reply.print(profile->scale[i], 6);
+  }
+  reply.write('\n');
+  reply.send();
+}
+
+// switch to binary mode after responding BINARY; left with BIN_ASCII, after BIN_TIMEOUT or on reset
+void ToninoSerial::binary() {
+  respond(F("BINARY"));
+  _binary = true;
+  _bufLen = 0;
+  _cobsLeft = 0;
+  _cobsZero = false;
+  _lastRx = millis();
+}
+
+// decodes one byte of an incoming binary frame, returns true if a frame has been handled
+boolean ToninoSerial::frameByte(uint8_t b) {
+  boolean handled = false;
+  if (b == 0) {
+    // end of frame
+    if (_cobsLeft > 0) {
+      _bufLen = -1;
+    }
+    if (_bufLen != 0) {
+      handleFrame();
+      handled = true;
+    }
+    _bufLen = 0;
+    _cobsLeft = 0;
+    _cobsZero = false;
+  } else if (_bufLen < 0) {
+    // skip the rest of a frame that does not fit into the buffer
+  } else if (_cobsLeft == 0) {
+    // COBS code: the previous block ends in a zero unless it was a full block
+    if (_cobsZero) {
+      _buf[_bufLen++] = 0;
+    }
+    _cobsLeft = b - 1;
+    _cobsZero = (b < 0xFF);
+  } else {
+    _buf[_bufLen++] = b;
+    --_cobsLeft;
+  }
+  if (_bufLen >= (int16_t)SERIAL_BUFFER) {
+    _bufLen = -1;
+  }
+  return handled;
+}
+
+// executes the binary command in _buf and sends the response
+void ToninoSerial::handleFrame() {
+  uint8_t cmd = (_bufLen > 0 ? _buf[0] : 0);
+  if (_bufLen < 3 || ToninoConfig::crc(_buf, _bufLen-2) != (_buf[_bufLen-2] | (_buf[_bufLen-1] << 8))) {
+    sendFrame(cmd, BIN_ERR_CRC, 0);
+    return;
+  }
+
+  // response payload follows command and status
+  uint8_t *payload = &_buf[2];
+  uint8_t len = 0;
+  uint8_t status = BIN_OK;
+  int32_t val;
+  float ratio;
+  sensorData sd;
+  switch (cmd) {
+    case BIN_TONINO:
+      len = strlen(_version);
+      memcpy(payload, _version, len);
+      _display->connected();
+      break;
+    case BIN_SCAN:
+      val = _colorSense->scan();
+      memcpy(payload, &val, sizeof(val));
+      len = sizeof(val);
+      break;
+    case BIN_I_SCAN:
+      ratio = 0.0;
+      val = _colorSense->scan(&ratio);
+      memcpy(payload, &ratio, sizeof(ratio));
+      len = sizeof(ratio);
+      break;
+    case BIN_II_SCAN:
+      val = _colorSense->scan(NULL, false, &sd);
+      memcpy(payload, &sd, sizeof(sd));
+      len = sizeof(sd);
+      break;
+    case BIN_D_SCAN:
+      _colorSense->scan(NULL, false, &sd, false);
+      memcpy(payload, &sd, sizeof(sd));
+      len = sizeof(sd);
+      break;
+    case BIN_GETCONF:
+      _tConfig->exportConfig(payload);
+      len = CONFIG_BLOB_SIZE;
+      break;
+    case BIN_SETCONF:
+      // request payload follows the command
+      if (!_tConfig->importConfig(&_buf[1], _bufLen-3)) {
+        status = BIN_ERROR;
+      }
+      break;
+    case BIN_ASCII:
+      _binary = false;
+      _sCmd.clearBuffer();
+      break;
+    default:
+      status = BIN_ERR_CMD;
+  }
+  sendFrame(cmd, status, len);
+
+  // as in ASCII mode the display follows the response, the snake animation takes a while
+  if (cmd == BIN_SCAN || cmd == BIN_I_SCAN || cmd == BIN_II_SCAN) {
+    displayValue(val, cmd == BIN_SCAN);
+  }
+}
+
+// sends _buf as response frame to cmd with given status and len payload bytes starting at _buf[2]
+void ToninoSerial::sendFrame(uint8_t cmd, uint8_t status, uint8_t len) {
+  _buf[0] = cmd;
+  _buf[1] = status;
+  uint8_t n = len + 2;
+  uint16_t c = ToninoConfig::crc(_buf, n);
+  _buf[n++] = c & 0xFF;
+  _buf[n++] = c >> 8;
+
+  // COBS: each block of up to 254 non-zero bytes is preceded by its length+1
+  // and replaces the following zero
+  uint8_t start = 0;
+  for (;;) {
+    uint8_t end = start;
+    while (end < n && _buf[end] != 0 && end - start < 254) {
+      ++end;
+    }
+    Serial.write((uint8_t)(end - start + 1));
+    Serial.write(&_buf[start], end - start);
+    if (end == n) {
+      break;
+    }
+    start = (end - start == 254 ? end : end + 1);
+  }
+  Serial.write((uint8_t)0);
 }
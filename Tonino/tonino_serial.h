@@ -47,22 +47,96 @@
 #include <tonino.h>
 #include <tonino_config.h>
 #include <tonino_lcd.h>
+#include <tonino_log.h>
+#include <tonino_response.h>
+#include <tonino_clock.h>
+#include <tonino_power.h>
+#include <tonino_calibration.h>
+
+// binary mode (see Tonino-Serial.md)
+// frames are COBS encoded and terminated by 0x00, decoded they consist of
+// command, status (responses only), payload and CRC-CCITT (LSB first)
+#define BIN_TONINO  0x01
+#define BIN_SCAN    0x02
+#define BIN_I_SCAN  0x03
+#define BIN_II_SCAN 0x04
+#define BIN_D_SCAN  0x05
+#define BIN_GETCONF 0x06
+#define BIN_SETCONF 0x07
+#define BIN_ASCII   0x7F
+
+// status of binary responses
+#define BIN_OK      0
+#define BIN_ERROR   1
+#define BIN_ERR_CRC 2
+#define BIN_ERR_CMD 3
+
+// binary mode is left if nothing is received for this time in ms
+#define BIN_TIMEOUT 10000
+
+// a baud rate change by SETBAUD is reverted if not confirmed within this time in ms
+#define BAUD_TIMEOUT 2000
+
+// after waking up from power down by serial input, the rest of the (incomplete) line
+// is discarded until its end or until no input arrived for this time in ms
+#define WAKE_QUIET 5
+
+// power states reported by !POWER events
+#define POWER_STATE_ACTIVE 0
+#define POWER_STATE_DIM    1
+#define POWER_STATE_SLEEP  2
+#define POWER_STATE_OFF    3
+
+// size of the queue for received bytes, in addition to the RX buffer of the serial lib
+#define SERIAL_QUEUE 64
+
+// size of the buffer for SETCONF and binary frames; must hold command, status, config blob and CRC
+#define SERIAL_BUFFER (CONFIG_BLOB_SIZE+4)
 
 
 class ToninoSerial {
   public:
-    // constructor taking pointers to color sensor, display, configuration, and a version string
-    ToninoSerial(TCS3200 *colorSense, LCD *display, ToninoConfig *tConfig, const char *ver);
+    // constructor taking pointers to color sensor, display, configuration, a version string,
+    // and optionally the scan history, power policy and calibration
+    ToninoSerial(TCS3200 *colorSense, LCD *display, ToninoConfig *tConfig, const char *ver, ToninoLog *log = NULL, ToninoPower *power = NULL,
+                 ToninoCalibration *calibration = NULL);
     ~ToninoSerial(void);
 
     // initializes serial communication and registers functions for serial commands
     void init(uint32_t speed);
 
-    // poll if there is an incoming serial command
+    // switches serial communication to the given baud rate
+    static void setSpeed(uint32_t speed);
+
+    // to be called after serial input woke up the Tonino from power down: as the first bytes
+    // were lost while the UART was stopped, the rest of that line is discarded and answered with WAKE
+    static void resync();
+
+    // poll if there is an incoming serial command; queued commands are executed in order, one per call
     static boolean checkCommands();
+
+    // push events for stand-alone operation, sent only after SUBSCRIBE 1 (see Tonino-Serial.md)
+    // a scan with its T-value and raw values, e.g. !SCAN:52310 63 8713 5120 3402 17530 63 0
+    static void pushScan(int32_t tval, sensorData *sd, boolean averaged);
+    // the can has been lifted (1) or put down (0), e.g. !LIFT:52010 1
+    static void pushLift(boolean up);
+    // the power state changed to one of POWER_STATE_*, e.g. !POWER:112310 1
+    static void pushPower(uint8_t state);
+    // the calibration entered one of the CAL_xxx states for the given plate, with a CAL_ERR_xxx reason if it failed, e.g. !CAL:20410 4 0 0
+    static void pushCalibration(uint8_t state, uint8_t plate, uint8_t reason);
+
+    // moves received bytes from the serial lib to the command queue
+    // called while waiting (see yield()) such that commands sent during a scan are not lost
+    static void receive();
+
+    // true if received input still needs to be processed by checkCommands()
+    static boolean pending();
     
     // following methods need to be static for SerialCommand lib
 
+    // answer unknown commands with CMD ERROR, e.g. FOO ERROR
+    static void unknownCommand(const char *command);
+
     // print version to serial, e.g. TONINO:0 3 002
     static void getVersion();
 
@@ -78,10 +152,14 @@ class ToninoSerial {
     // make a full scan with LEDs switched off and print raw measurement to serial, e.g. D_SCAN:100 50
     static void d_scan();
 
-    // store calibration data from serial to local vars and EEPROM; response: SETCAL
+    // make a scan with per-request parameters (sampling colormode led ambient subgates) and print raw measurement to serial,
+    // e.g. SCANX:216575 86428 ... ; profile and EEPROM settings are not changed
+    static void scanx();
+
+    // store calibration data and an optional quadratic term from serial to local vars and EEPROM; response: SETCAL
     static void setCalibration();
 
-    // print current calibration data to serial, e.g. GETCAL:0.95 1.12 1.32 0.89
+    // print current calibration data to serial, followed by the quadratic term if not 0, e.g. GETCAL:0.95 1.12 1.32 0.89
     static void getCalibration();
 
     // store scaling data from serial to local vars and EEPROM; response: SETSCALING
@@ -129,6 +207,99 @@ class ToninoSerial {
     // reset settings back to defaults
     static void resetToDefaults();
 
+    // save whether to boot fast (1) or not (0) to EEPROM and config manager; response SETFASTBOOT
+    // responds with SETFASTBOOT ERROR if not 0 or 1
+    static void setFastBoot();
+
+    // retrieve whether fast boot is enabled (1) or not (0), e.g. GETFASTBOOT:1
+    static void getFastBoot();
+
+    // store the times without action (in seconds) till dimming, sleep and power down and, optionally,
+    // whether they are adapted to the usage; response SETPOWER, SETPOWER ERROR unless 0 < dim < sleep < powerdown
+    static void setPower();
+
+    // print power times, adaptive setting, times currently in effect, number of observed intervals between
+    // scans and number of dims, sleeps and power downs, e.g. GETPOWER:120 600 7200 1 30 150 12 3 1 0
+    static void getPower();
+
+    // save whether scans are made without animations as soon as the can settled (1) or not (0); response SETTHROUGHPUT
+    // responds with SETTHROUGHPUT ERROR if not 0 or 1
+    static void setThroughput();
+
+    // retrieve whether the throughput mode is on (1) or not (0) and the number of scans within the last minute, e.g. GETTHROUGHPUT:1 14
+    static void getThroughput();
+
+    // print the number of times the can settled within 50, 100, 200, 500 and 1000ms, the number of timeouts
+    // and the total time saved (ms) compared to a fixed wait, e.g. GETSETTLE:0 5 0 2 1 0 6658
+    static void getSettle();
+
+    // print the estimated charge drawn per hour in each energy state (run, idle, sleep, slow idle) in mAs, e.g. GETENERGY:30512 7140 0 0
+    static void getEnergy();
+
+    // start (no argument or 1) or abort (0) the calibration with the calibration plates or, if followed by a model
+    // (1 linear, 2 quadratic) and 2 to 6 target values, with that number of reference plates; progress is reported
+    // by !CAL events; response CALIBRATE, CALIBRATE ERROR if invalid or if no calibration is running to abort
+    static void calibrate();
+
+    // print model and number of plates of the last calibration and for each plate the mean r/b ratio, its standard
+    // deviation, the number of scans used after outlier rejection (0 if not scanned) and the residual of the fit,
+    // e.g. GETCALSTATS:1 2 1.62481 0.00213 5 0.00000 4.16012 0.00484 4 0.00000
+    static void getCalibrationStats();
+
+    // start a session: all following SET* commands, SETCONF and RESETDEF change the settings in RAM only; response SESSION
+    static void beginSession();
+
+    // store the settings of the session to EEPROM and end the session; response COMMIT, COMMIT ERROR if no session is active
+    static void commitSession();
+
+    // discard the settings of the session by reloading them from EEPROM and end the session;
+    // response REVERT, REVERT ERROR if no session is active
+    static void revertSession();
+
+    // send (1) or do not send (0) events for stand-alone scans, can lifting and power state changes;
+    // response SUBSCRIBE, responds with SUBSCRIBE ERROR if not 0 or 1
+    static void subscribe();
+
+    // change the baud rate: SETBAUD rate [persist] is answered with SETBAUD at the old rate,
+    // then the Tonino switches and waits BAUD_TIMEOUT for SETBAUD rate at the new rate, which is
+    // answered by SETBAUD:rate; if persist is 1 the rate is then also used after reset
+    // without confirmation the old rate is restored; responds with SETBAUD ERROR if the rate is not supported
+    static void setBaud();
+
+    // print the boot timeline in microseconds since reset, 0 for stages not (yet) reached
+    // e.g. GETBOOT:64 1208 2412 2480 4016 4096 121544 122760
+    static void getBootTimes();
+
+    // switch to the given profile and store the selection to EEPROM; response SETPROFILE
+    // responds with SETPROFILE ERROR if not in [0..NR_PROFILES-1]
+    static void setProfile();
+
+    // retrieve the index of the current profile and the number of profiles, e.g. GETPROFILE:1 4
+    static void getProfile();
+
+    // print the scan history, oldest first, 5 values per scan:
+    // seconds since power-on, T-value, red, blue, flags (1=averaged, 2=first after power-on)
+    // e.g. GETLOG:12 63 8713 3402 2 40 64 8702 3390 1
+    static void getLog();
+
+    // print the complete configuration as base64 encoded blob (see ToninoConfig::exportConfig)
+    // e.g. GETCONF:AWwKAQoAAgrc...
+    static void getConfig();
+
+    // validate and store a complete configuration given as base64 encoded blob; response SETCONF
+    // responds with SETCONF ERROR if the blob is malformed or any value is invalid
+    static void setConfig();
+    // receives the base64 encoded blob of SETCONF character by character (streamed by SerialCommand)
+    static void setConfigArg(char c);
+
+    // switch to binary mode after responding BINARY; left with BIN_ASCII, after BIN_TIMEOUT or on reset
+    static void binary();
+
+    // print all parameters of the given profile, e.g.
+    // READPROFILE:1 2 10 1.011949 -0.094599 0.000000 0.000000 102.272727 -128.409091
+    // (index, sampling, color mode, calibration values, scaling values)
+    static void readProfile();
+
     
   private:
     // object for lib that calls methods according to serial input
@@ -136,6 +307,22 @@ class ToninoSerial {
 
     // returns true if the value is not a valid float
     static boolean isInvalidNumber(float f);
+    // appends n bytes base64 encoded to reply
+    static void printBase64(ToninoResponse *reply, const uint8_t *buf, uint16_t n);
+    // shows a T-value on the LCD, animated if snake is true, or a line if out of range
+    static void displayValue(int32_t val, boolean snake = false);
+
+    // sends msg with the request ID of the current command followed by newline
+    static void respond(const __FlashStringHelper *msg);
+    // starts an event line with the given name and the current time, e.g. !LIFT:52010
+    static void startEvent(ToninoResponse *event, const __FlashStringHelper *name);
+
+    // decodes one byte of an incoming binary frame, returns true if a frame has been handled
+    static boolean frameByte(uint8_t b);
+    // executes the binary command in _buf and sends the response
+    static void handleFrame();
+    // sends _buf as response frame to cmd with given status and len payload bytes starting at _buf[2]
+    static void sendFrame(uint8_t cmd, uint8_t status, uint8_t len);
 
     // object for communication with the color sensor
     static TCS3200 *_colorSense;
@@ -143,8 +330,46 @@ class ToninoSerial {
     static LCD *_display;
     // object for communication with the configuration manager
     static ToninoConfig *_tConfig;
+    // scan history, may be NULL
+    static ToninoLog *_log;
+    // power policy, may be NULL
+    static ToninoPower *_power;
+    // calibration workflow, may be NULL
+    static ToninoCalibration *_calibration;
     // version string passed by main program
     static const char *_version;
+
+    // config blob decoded by setConfigArg or exported by getConfig, or binary frame
+    static uint8_t _buf[SERIAL_BUFFER];
+    // number of decoded bytes of _buf or -1 if the input was malformed or too long
+    static int16_t _bufLen;
+    // base64 bits not yet decoded to _buf
+    static uint16_t _blobBits;
+    static uint8_t _blobNBits;
+
+    // true if events are to be sent
+    static boolean _subscribed;
+    // current baud rate
+    static uint32_t _speed;
+    // baud rate to restore if a change is not confirmed, 0 if no change is pending
+    static uint32_t _oldSpeed;
+    // time of the baud rate change
+    static uint32_t _speedChanged;
+    // true if the pending baud rate is to be stored once confirmed
+    static boolean _persistSpeed;
+    // true while in binary mode
+    static boolean _binary;
+    // time of the last byte received in binary mode
+    static uint32_t _lastRx;
+    // bytes left in the current COBS block
+    static uint8_t _cobsLeft;
+    // true if the current COBS block is followed by a zero
+    static boolean _cobsZero;
+
+    // received bytes not yet parsed (ring buffer)
+    static uint8_t _queue[SERIAL_QUEUE];
+    static uint8_t _queueHead;
+    static uint8_t _queueLen;
 };
 
 #endif
\ No newline at end of file
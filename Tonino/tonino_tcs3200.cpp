@@ -47,30 +47,34 @@ LCD *TCS3200::_display;
 
 TCS3200::TCS3200(uint8_t s2, uint8_t s3, uint8_t led, uint8_t power, LCD *display) :
   _S2(s2), _S3(s3), _LED(led), _POWER(power),
-  _readDiv(NORMAL_SAMPLING), _colorMode(COLOR_FULL) {
+  _readDiv(NORMAL_SAMPLING), _quad(0.0), _profile(&_defaultProfile),
+  _settleStart(0), _settleWhite(0), _settleLed(0), _settleStable(1), _settleRecord(false), _settleSaved(0) {
   
   _display = display;
+  memset(_settleCounts, 0, sizeof(_settleCounts));
   
+  _defaultProfile.sampling = NORMAL_SAMPLING;
+  _defaultProfile.colorMode = COLOR_FULL;
   #if NR_CAL_VALUES == 2
-    _cal[0] = DEFAULT_CAL_0;
-    _cal[1] = DEFAULT_CAL_1;
+    _defaultProfile.cal[0] = DEFAULT_CAL_0;
+    _defaultProfile.cal[1] = DEFAULT_CAL_1;
   #else
     for (int i = 0; i < NR_CAL_VALUES; ++i) {
-      _cal[i] = 1.0;
+      _defaultProfile.cal[i] = 1.0;
     }
   #endif
   #if NR_SCALE_VALUES == 3
-    _scale[0] = DEFAULT_SCALE_0;
-    _scale[1] = DEFAULT_SCALE_1;
-    _scale[2] = DEFAULT_SCALE_2;
+    _defaultProfile.scale[0] = DEFAULT_SCALE_0;
+    _defaultProfile.scale[1] = DEFAULT_SCALE_1;
+    _defaultProfile.scale[2] = DEFAULT_SCALE_2;
   #elif NR_SCALE_VALUES == 4
-    _scale[0] = DEFAULT_SCALE_0;
-    _scale[1] = DEFAULT_SCALE_1;
-    _scale[2] = DEFAULT_SCALE_2;
-    _scale[3] = DEFAULT_SCALE_3;
+    _defaultProfile.scale[0] = DEFAULT_SCALE_0;
+    _defaultProfile.scale[1] = DEFAULT_SCALE_1;
+    _defaultProfile.scale[2] = DEFAULT_SCALE_2;
+    _defaultProfile.scale[3] = DEFAULT_SCALE_3;
   #else
     for (int i = 0; i < NR_SCALE_VALUES; ++i) {
-      _scale[i] = 0.001;
+      _defaultProfile.scale[i] = 0.001;
     }
   #endif
 }
@@ -107,7 +111,8 @@ int32_t TCS3200::fitValue(sensorData *sd, float* raw, uint8_t colorMode, boolean
   // calibrate
   float r = (float)sd->value[RED_IDX];
   float b = (float)sd->value[BLUE_IDX];
-  float v = (r / b) * _cal[0] + _cal[1];
+  float v = r / b;
+  v = (_quad * v + _profile->cal[0]) * v + _profile->cal[1];
   
   // averaging
   if (raw != NULL && *raw != 0.0 && abs(v - *raw) < AVERAGE_THRESHOLD) {
@@ -128,7 +133,8 @@ int32_t TCS3200::fitValue(sensorData *sd, float* raw, uint8_t colorMode, boolean
   WRITEDEBUG(v);
   WRITEDEBUG(SEPARATOR);
   // scale
-  int32_t tval = (int32_t)(_scale[0] * v*v*v + _scale[1] * v*v + _scale[2] * v + _scale[3] + 0.5);
+  float *scale = _profile->scale;
+  int32_t tval = (int32_t)(scale[0] * v*v*v + scale[1] * v*v + scale[2] * v + scale[3] + 0.5);
   WRITEDEBUG("=");
   WRITEDEBUGLN(tval);
   if (raw != NULL) {
@@ -140,8 +146,18 @@ int32_t TCS3200::fitValue(sensorData *sd, float* raw, uint8_t colorMode, boolean
 // makes the actual measurement with LEDs on
 // according to current sampling and color mode settings
 // displayAnim if true, the display shows a "progress bar"
-int32_t TCS3200::scan(float *raw, bool displayAnim, sensorData *outersd, boolean ledon, boolean removeExtLight, boolean *averaged) {
+// sampling and colorMode override the settings of the current profile for this scan if not 0
+int32_t TCS3200::scan(float *raw, bool displayAnim, sensorData *outersd, boolean ledon, boolean removeExtLight, boolean *averaged,
+                      uint8_t sampling, uint8_t colorMode, uint8_t subGates) {
   uint8_t animPos = 0;
+  uint8_t profileReadDiv = _readDiv;
+  if (sampling != 0) {
+    _readDiv = sampling;
+  }
+  if (colorMode == 0) {
+    colorMode = _profile->colorMode;
+  }
+  subGates = constrain(subGates, 1, MAX_SUBGATES);
   sensorData sd;
   for (uint8_t i = 0; i < 5; ++i) {
     sd.value[i] = 0;
@@ -158,14 +174,14 @@ int32_t TCS3200::scan(float *raw, bool displayAnim, sensorData *outersd, boolean
   }
   delay(SENSOR_ON_DELAY);
   
-  if (_colorMode & COLOR_WHITE) {
+  if (colorMode & COLOR_WHITE) {
     if (displayAnim && _display != NULL) {
       _display->lineAnim(animPos++, 0);
     }
     setFilter(WHITE_IDX); // white sensor
-    sd.value[WHITE_IDX] = readSingle();
+    sd.value[WHITE_IDX] = readSingle(subGates);
   }
-  if (_colorMode & COLOR_RED) {
+  if (colorMode & COLOR_RED) {
     if (displayAnim && _display != NULL) {
       _display->lineAnim(animPos++, 0);
       if (animPos == 2) animPos++;
@@ -173,23 +189,23 @@ int32_t TCS3200::scan(float *raw, bool displayAnim, sensorData *outersd, boolean
     setFilter(RED_IDX); // red sensor
     uint8_t samplingBackup = _readDiv;
     _readDiv = min(REDSAMPLING_FACTOR*samplingBackup, 100);
-    sd.value[RED_IDX] = readSingle();
+    sd.value[RED_IDX] = readSingle(subGates);
     _readDiv = samplingBackup;
   }
-  if (_colorMode & COLOR_BLUE) {
+  if (colorMode & COLOR_BLUE) {
     if (displayAnim && _display != NULL) {
       _display->lineAnim(animPos, 0);
       if (animPos == 2) animPos++;
     }
     setFilter(BLUE_IDX); // blue sensor
-    sd.value[BLUE_IDX] = readSingle();
+    sd.value[BLUE_IDX] = readSingle(subGates);
   }
-  if (_colorMode & COLOR_GREEN) {
+  if (colorMode & COLOR_GREEN) {
     if (displayAnim && _display != NULL) {
       _display->lineAnim(animPos++, 0);
     }
     setFilter(GREEN_IDX); // green sensor
-    sd.value[GREEN_IDX] = readSingle();
+    sd.value[GREEN_IDX] = readSingle(subGates);
   }
 
   sensorOff();
@@ -201,30 +217,30 @@ int32_t TCS3200::scan(float *raw, bool displayAnim, sensorData *outersd, boolean
 		
 		WRITEDEBUG("ext light:");
 		uint32_t ds;
-		if (_colorMode & COLOR_WHITE) {
+		if (colorMode & COLOR_WHITE) {
 			setFilter(WHITE_IDX); // white sensor
-			ds = readSingle();
+			ds = readSingle(subGates);
 			WRITEDEBUG(ds);
 			WRITEDEBUG(" ");
 			sd.value[WHITE_IDX] -= ds;
 		}
-		if (_colorMode & COLOR_RED) {
+		if (colorMode & COLOR_RED) {
 			setFilter(RED_IDX); // red sensor
-			ds = readSingle();
+			ds = readSingle(subGates);
 			WRITEDEBUG(ds);
 			WRITEDEBUG(" ");
 			sd.value[RED_IDX] -= ds;
 		}
-		if (_colorMode & COLOR_BLUE) {
+		if (colorMode & COLOR_BLUE) {
 			setFilter(BLUE_IDX); // blue sensor
-			ds = readSingle();
+			ds = readSingle(subGates);
 			WRITEDEBUG(ds);
 			WRITEDEBUG(" ");
 			sd.value[BLUE_IDX] -= ds;
 		}
-		if (_colorMode & COLOR_GREEN) {
+		if (colorMode & COLOR_GREEN) {
 			setFilter(GREEN_IDX); // green sensor
-			ds = readSingle();
+			ds = readSingle(subGates);
 			WRITEDEBUG(ds);
 			WRITEDEBUG(" ");
 			sd.value[GREEN_IDX] -= ds;
@@ -233,8 +249,10 @@ int32_t TCS3200::scan(float *raw, bool displayAnim, sensorData *outersd, boolean
 		WRITEDEBUGLN();
 	} // if (removeExtLight)
 
+  _readDiv = profileReadDiv;
+
   // calculate T-value according to current formula
-  int32_t tval = fitValue(&sd, raw, _colorMode, averaged);
+  int32_t tval = fitValue(&sd, raw, colorMode, averaged);
   
   if (outersd != NULL) {
     for (int i = 0; i < 4; ++i) {
@@ -299,12 +317,12 @@ uint8_t TCS3200::isCalibrating() {
   return cal;
 }
 
-// returns true if quick sample without LEDs returns a rather high value
-bool TCS3200::isLight() {
+// quick sample of the white channel; with LEDs off this is the ambient light reaching the sensor
+uint32_t TCS3200::readWhite(boolean ledon) {
   uint8_t samplingBackup = _readDiv;
   _readDiv = QUICK_SAMPLING;
 
-  digitalWrite(_LED, LOW);
+  digitalWrite(_LED, ledon ? HIGH : LOW);
   digitalWrite(_POWER, HIGH);
   setFilter(WHITE_IDX); // white sensor
   delay(SENSOR_ON_DELAY);
@@ -312,6 +330,12 @@ bool TCS3200::isLight() {
   uint32_t val = readSingle();
   sensorOff();
   _readDiv = samplingBackup;
+  return val;
+}
+
+// returns true if quick sample without LEDs returns a rather high value
+bool TCS3200::isLight() {
+  uint32_t val = readWhite();
 
   WRITEDEBUG("isLight:");
   WRITEDEBUG(val);
@@ -326,14 +350,87 @@ bool TCS3200::isDark() {
    return !isLight();
 }  
 
-// blocking read of a single sensor value
-uint32_t TCS3200::readSingle(void) {
+// starts the settle detection, to be called when the can was put down; unless record is false
+// the settle time is counted in the statistics
+void TCS3200::startSettle(bool record) {
+  _settleStart = millis();
+  _settleStable = 1;
+  _settleRecord = record;
+  _settleWhite = readWhite();
+  if (SETTLE_LED_PROBE) {
+    _settleLed = readWhite(true);
+  }
+}
+
+// takes the next probe of the settle detection; true if the can has settled, see SETTLE_xxx constants
+bool TCS3200::settled() {
+  static const uint16_t bounds[SETTLE_BUCKETS-2] = { 50, 100, 200, 500 };
+
+  uint32_t white = readWhite();
+  bool stable = (white == _settleWhite && (!SETTLE_DARK || white == 0));
+  _settleWhite = white;
+  if (SETTLE_LED_PROBE) {
+    uint32_t led = readWhite(true);
+    uint32_t delta = (led > _settleLed ? led - _settleLed : _settleLed - led);
+    stable = stable && delta <= QUICK_SAMPLING + max(led, _settleLed) / SETTLE_LED_RATIO;
+    _settleLed = led;
+  }
+  _settleStable = (stable ? _settleStable + 1 : 1);
+
+  uint32_t elapsed = millis() - _settleStart;
+  if (_settleStable < SETTLE_READINGS && elapsed < SETTLE_TIMEOUT) {
+    return false;
+  }
+  WRITEDEBUG("settled:");
+  WRITEDEBUGLN(elapsed);
+  if (!_settleRecord) {
+    return true;
+  }
+  uint8_t bucket = 0;
+  if (elapsed >= SETTLE_TIMEOUT) {
+    bucket = SETTLE_BUCKETS-1;
+  } else {
+    while (bucket < SETTLE_BUCKETS-2 && elapsed >= bounds[bucket]) {
+      ++bucket;
+    }
+    _settleSaved += SETTLE_TIMEOUT - elapsed;
+  }
+  if (_settleCounts[bucket] < 0xFFFF) {
+    _settleCounts[bucket]++;
+  }
+  return true;
+}
+
+// number of settle detections since reset that ended in the given class of settle times (0..SETTLE_BUCKETS-1)
+uint16_t TCS3200::getSettleCount(uint8_t bucket) {
+  return (bucket < SETTLE_BUCKETS ? _settleCounts[bucket] : 0);
+}
+
+// total time (ms) saved by the settle detections since reset compared to waiting SETTLE_TIMEOUT
+uint32_t TCS3200::getSettleSaved() {
+  return _settleSaved;
+}
+
+// blocking read of a single sensor value in Hz, counted in subGates shorter gates
+uint32_t TCS3200::readSingle(uint8_t subGates) {
   delay(SENSOR_SWITCH_DELAY);
-  FreqCount.begin(1000/_readDiv);    // start
-  while (!FreqCount.available());   // wait
-  FreqCount.end();                  // stop
+  // _readDiv <= 100 and subGates <= MAX_SUBGATES keep the gate at 1ms or above
+  uint16_t gate = 1000/(_readDiv*subGates);
+  uint32_t count = 0;
+  for (uint8_t i = 0; i < subGates; ++i) {
+    FreqCount.begin(gate);             // start
+    while (!FreqCount.available()) yield();   // wait
+    FreqCount.end();                  // stop
+    count += FreqCount.read();
+  }
 
-  return(FreqCount.read() * _readDiv);
+  if (subGates == 1) {
+    // as ever, such that the raw values and existing calibrations stay valid
+    return count * _readDiv;
+  }
+  // scale to Hz by the time actually counted as gate is rounded down unless _readDiv*subGates divides 1000
+  uint16_t total = gate * subGates;
+  return (count * 1000 + total / 2) / total;
 }
 
 // set the sensor color filter
@@ -365,34 +462,45 @@ void TCS3200::setFilter(uint8_t f) {
 // store new calibration data
 void TCS3200::setCalibration(float *cal) {
   for (int i = 0; i < NR_CAL_VALUES; ++i) {
-    _cal[i] = cal[i];
+    _profile->cal[i] = cal[i];
   }
 }
 
 // retrieve current calibration data
 void TCS3200::getCalibration(float *cal) {
   for (int i = 0; i < NR_CAL_VALUES; ++i) {
-    cal[i] = _cal[i];
+    cal[i] = _profile->cal[i];
   }
 }
 
+// set the quadratic term of the calibration
+void TCS3200::setQuadratic(float quad) {
+  _quad = quad;
+}
+
+// get the quadratic term of the calibration
+float TCS3200::getQuadratic() {
+  return _quad;
+}
+
 // store new scaling data
 void TCS3200::setScaling(float *scale) {
   for (int i = 0; i < NR_SCALE_VALUES; ++i) {
-    _scale[i] = scale[i];
+    _profile->scale[i] = scale[i];
   }
 }
 
 // retrieve current scaling data
 void TCS3200::getScaling(float *scale) {
   for (int i = 0; i < NR_SCALE_VALUES; ++i) {
-    scale[i] = _scale[i];
+    scale[i] = _profile->scale[i];
   }
 }
 
 // store new sampling value, [0..100]
 void TCS3200::setSampling(uint8_t sampling) {
   _readDiv = ((sampling > 0 && sampling <= 100) ? sampling : _readDiv);
+  _profile->sampling = _readDiv;
 }
 
 // retrieve current sampling value
@@ -407,10 +515,27 @@ void TCS3200::setColorMode(uint8_t colorMode) {
     WRITEDEBUGLN(colorMode);
     return;
   }
-  _colorMode = colorMode;
+  _profile->colorMode = colorMode;
 }
 
 // retrieve current colorMode
 uint8_t TCS3200::getColorMode() {
-  return _colorMode;
+  return _profile->colorMode;
+}
+
+// use the given parameter set for all further scans; only the pointer is stored
+// NULL selects the built-in default profile
+void TCS3200::setProfile(sensorProfile *profile) {
+  _profile = (profile != NULL ? profile : &_defaultProfile);
+  _readDiv = _profile->sampling;
+}
+
+// get the currently used parameter set
+sensorProfile *TCS3200::getProfile() {
+  return _profile;
+}
+
+// get the built-in default parameter set
+sensorProfile *TCS3200::getDefaultProfile() {
+  return &_defaultProfile;
 }
@@ -59,6 +59,9 @@
 // RED color will be measured longer by this factor
 #define REDSAMPLING_FACTOR 2
 
+// max. number of gates a single color reading can be split into (see scan)
+#define MAX_SUBGATES 10
+
 // flags for selecting which colors are measured
 #define COLOR_WHITE  0b00000001
 #define COLOR_RED    0b00000010
@@ -87,6 +90,22 @@
 // threshold for detecting can lifting and replacing
 #define LIGHT_MIN 199
 
+// settle detection after the can was put down (see settled): it might already be dark before the can
+// is fully placed on the surface, thus the white channel is read every SETTLE_PROBE_INTERVAL ms
+// until SETTLE_READINGS successive readings are equal (below LIGHT_MIN a reading is only 0 or 100),
+// and 0 if SETTLE_DARK is true, as a faint leak under a can still moving reads a steady 100
+// and, if SETTLE_LED_PROBE is true, the readings with LEDs on differ by no more than one count
+// plus 1/SETTLE_LED_RATIO; the can counts as settled after SETTLE_TIMEOUT ms in any case
+// the values are the fastest without any early scan on the put-down traces of test/test_settle.cpp
+#define SETTLE_PROBE_INTERVAL 0
+#define SETTLE_READINGS 5
+#define SETTLE_DARK true
+#define SETTLE_LED_PROBE false
+#define SETTLE_LED_RATIO 32
+#define SETTLE_TIMEOUT 1000
+// number of settle time classes counted: < 50, 100, 200, 500ms, < SETTLE_TIMEOUT, timeout
+#define SETTLE_BUCKETS 6
+
 // calibration plates (see isCalibrating method)
 #define LOW_PLATE  1  // first, low, dark, brown, calibration plate
 #define HIGH_PLATE 2  // second, high, bright, red, calibration plate
@@ -112,6 +131,16 @@ typedef struct {
   int32_t value[5];
 } sensorData;
 
+// one set of measurement parameters (calibration, scaling, sampling, color mode)
+typedef struct {
+  float cal[NR_CAL_VALUES];
+  float scale[NR_SCALE_VALUES];
+  uint8_t sampling;
+  uint8_t colorMode;
+} sensorProfile;
+// size of a profile in EEPROM and config blobs; sizeof(sensorProfile) adds padding on other platforms
+#define SENSOR_PROFILE_SIZE ((NR_CAL_VALUES+NR_SCALE_VALUES)*4+2)
+
 
 class TCS3200 {
   public:
@@ -130,7 +159,10 @@ class TCS3200 {
     // with the T-value at T_IDX
     // if ledon is true, LEDs are switched on during measurement
     // if removeExtLight is true, additional 'dark' measurement is done
-    int32_t scan(float *raw = NULL, bool displayAnim = false, sensorData *sd = NULL, boolean ledon = true, boolean removeExtLight = false, boolean *averaged = NULL);
+    // sampling and colorMode override the settings of the current profile for this scan if not 0
+    // each color is read in subGates consecutive gates of 1/subGates of the sampling time which are summed up
+    int32_t scan(float *raw = NULL, bool displayAnim = false, sensorData *sd = NULL, boolean ledon = true, boolean removeExtLight = false, boolean *averaged = NULL,
+                 uint8_t sampling = 0, uint8_t colorMode = 0, uint8_t subGates = 1);
     
     // switch sensor completely off
     void sensorOff();
@@ -138,10 +170,22 @@ class TCS3200 {
     // returns 1 if the first, darker, 2 if the second, lighter calibration plate is detected
     // 0 otherwise; a quick sampling with LEDs in conducted
     uint8_t isCalibrating();
+    // quick reading of the white channel; with LEDs off this is the ambient light reaching the sensor
+    uint32_t readWhite(boolean ledon = false);
     // true if it detects that the can was lifted
     bool isLight();
     // true if it detects that can is not lifted
     bool isDark();
+    // starts the settle detection, to be called when the can was put down; unless record is false
+    // the settle time is counted in the statistics
+    void startSettle(bool record = true);
+    // takes the next probe of the settle detection; true if the can has settled, see SETTLE_xxx constants
+    // to be called every SETTLE_PROBE_INTERVAL ms after startSettle() until it returns true
+    bool settled();
+    // number of settle detections since reset that ended in the given class of settle times (0..SETTLE_BUCKETS-1)
+    uint16_t getSettleCount(uint8_t bucket);
+    // total time (ms) saved by the settle detections since reset compared to waiting SETTLE_TIMEOUT
+    uint32_t getSettleSaved();
 
     // set the NR_SCALE_VALUES values to derive T-value
     void setScaling(float *scale);
@@ -151,6 +195,10 @@ class TCS3200 {
     void setCalibration(float *cal);
     // get the NR_CAL_VALUES values for calibration
     void getCalibration(float *cal);
+    // set the quadratic term of the calibration, added to the linear one given by the NR_CAL_VALUES values
+    void setQuadratic(float quad);
+    // get the quadratic term of the calibration
+    float getQuadratic();
     // set sampling rate, see xxx_SAMPLING constants, [0..100]
     void setSampling(uint8_t sampling);
     // get sampling rate
@@ -159,6 +207,13 @@ class TCS3200 {
     void setColorMode(uint8_t mode);
     // get color mode, see COLOR_xxx constants
     uint8_t getColorMode();
+    // use the given parameter set for all further scans; only the pointer is stored
+    // NULL selects the built-in default profile
+    void setProfile(sensorProfile *profile);
+    // get the currently used parameter set
+    sensorProfile *getProfile();
+    // get the built-in default parameter set
+    sensorProfile *getDefaultProfile();
 
       
   private:
@@ -174,15 +229,27 @@ class TCS3200 {
     
     // sampling rate, i.e. fraction of 1 second read
     uint8_t _readDiv;
-    // specifies which color sensors are used
-    uint8_t _colorMode;
-    // scaling data
-    float _scale[NR_SCALE_VALUES];
-    // calibration data
-    float _cal[NR_CAL_VALUES];
+    // quadratic term of the calibration; not part of sensorProfile to keep its layout
+    float _quad;
+    // built-in parameter set, used unless another one is selected
+    sensorProfile _defaultProfile;
+    // current parameter set (scaling, calibration, sampling and color mode)
+    sensorProfile *_profile;
+
+    // start time and last readings of the settle detection
+    uint32_t _settleStart;
+    uint32_t _settleWhite;
+    uint32_t _settleLed;
+    // number of successive stable readings
+    uint8_t _settleStable;
+    // whether the current settle detection is counted in the statistics
+    bool _settleRecord;
+    // settle statistics, see getSettleCount and getSettleSaved
+    uint16_t _settleCounts[SETTLE_BUCKETS];
+    uint32_t _settleSaved;
     
-    // synchronously (blocking) read a value
-    uint32_t readSingle();
+    // synchronously (blocking) read the frequency in Hz, counted in subGates shorter gates
+    uint32_t readSingle(uint8_t subGates = 1);
     // set the photodiode filter, must be one of xxx_IDX constants
     void setFilter(uint8_t f);
     // convert raw sensor data (in sd) into T-value using calibration and scaling
@@ -0,0 +1,409 @@
+// bench.cpp
+//----------
+// host micro-benchmarks of the serial command dispatch, of the formatting of replies and of the
+// hot paths of scan and config;
+// the times are those of the host CPU and only comparable with each other, the counts of
+// comparisons and EEPROM reads carry over to the ATmega328P
+//
+//   tonino_bench [iterations]
+
+#include <mock.h>
+#include <EEPROM.h>
+#include <SerialCommand.h>
+#include <stdio.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+// the bench calls the private hot paths of the sensor and config directly
+#define private public
+#include <tonino_tcs3200.h>
+#include <tonino_config.h>
+#include <tonino_lcd.h>
+#include <tonino_response.h>
+#undef private
+
+// the commands as registered by ToninoSerial
+static const char* const names[] = {
+  "BINARY", "CALIBRATE", "COMMIT", "D_SCAN", "GETBOOT", "GETBRIGH", "GETBRIGHTNESS", "GETCAL",
+  "GETCALIN", "GETCALINIT", "GETCALSTATS", "GETCMODE", "GETCONF", "GETENERGY", "GETFASTBOOT",
+  "GETLOG", "GETLTDEL", "GETLTDELAY", "GETPOWER", "GETPROFILE", "GETSAMPL", "GETSAMPLING",
+  "GETSCALI", "GETSCALING", "GETSETTLE", "GETTHROUGHPUT", "II_SCAN", "I_SCAN", "READPROFILE",
+  "RESETDEF", "REVERT", "SCAN", "SCANX", "SESSION", "SETBAUD", "SETBRIGH", "SETBRIGHTNESS",
+  "SETCAL", "SETCALIN", "SETCALINIT", "SETCMODE", "SETCONF", "SETFASTBOOT", "SETLTDEL",
+  "SETLTDELAY", "SETPOWER", "SETPROFILE", "SETSAMPL", "SETSAMPLING", "SETSCALI", "SETSCALING",
+  "SETTHROUGHPUT", "SUBSCRIBE", "TONINO"
+};
+static const uint8_t NR_NAMES = sizeof(names) / sizeof(names[0]);
+
+// the commands registered with addCommand() before the table in flash
+static const char* const legacyNames[] = {
+  "TONINO", "SCAN", "I_SCAN", "II_SCAN", "D_SCAN", "SETCAL", "GETCAL", "SETSCALI", "GETSCALI",
+  "SETBRIGH", "GETBRIGH", "SETSAMPL", "GETSAMPL", "SETCMODE", "GETCMODE", "SETCALIN", "GETCALIN",
+  "SETLTDEL", "GETLTDEL", "RESETDEF", "SETFASTB", "GETFASTB", "GETBOOT", "GETLOG", "GETCONF",
+  "SETCONF", "SETPROFI", "GETPROFI", "READPROF"
+};
+static const uint8_t NR_LEGACY = sizeof(legacyNames) / sizeof(legacyNames[0]);
+
+// sizes on the ATmega328P
+#define AVR_POINTER 2
+#define AVR_MALLOC_HEADER 2
+#define LEGACY_MAXCOMMANDLENGTH 8
+
+static volatile uint32_t handled;
+static void handler() {
+  handled++;
+}
+
+typedef std::chrono::steady_clock benchClock;
+
+static double nsPer(benchClock::time_point start, uint32_t n) {
+  return std::chrono::duration<double, std::nano>(benchClock::now() - start).count() / n;
+}
+
+// ---- dispatch as done by SerialCommand before: the line is buffered, then the command
+// is compared with each entry of the list in RAM until one matches
+struct LegacyEntry {
+  char command[LEGACY_MAXCOMMANDLENGTH + 1];
+  void (*function)();
+};
+
+struct LegacyParser {
+  std::vector<LegacyEntry> list;
+  char buffer[SERIALCOMMAND_BUFFER + 1];
+  uint8_t bufPos;
+  uint32_t comparisons;
+
+  LegacyParser() : bufPos(0), comparisons(0) {
+    buffer[0] = '\0';
+  }
+
+  void add(const char* command) {
+    LegacyEntry e;
+    strncpy(e.command, command, LEGACY_MAXCOMMANDLENGTH);
+    e.command[LEGACY_MAXCOMMANDLENGTH] = '\0';
+    e.function = handler;
+    list.push_back(e);
+  }
+
+  void processChar(char c) {
+    if (c == '\n') {
+      char* last;
+      char* command = strtok_r(buffer, " ", &last);
+      if (command != NULL) {
+        for (size_t i = 0; i < list.size(); ++i) {
+          comparisons++;
+          if (strncmp(command, list[i].command, LEGACY_MAXCOMMANDLENGTH) == 0) {
+            (*list[i].function)();
+            break;
+          }
+        }
+      }
+      buffer[0] = '\0';
+      bufPos = 0;
+    } else if (isprint(c) && bufPos < SERIALCOMMAND_BUFFER) {
+      buffer[bufPos++] = c;
+      buffer[bufPos] = '\0';
+    }
+  }
+};
+
+// comparisons of the binary search of SerialCommand::findCommand() for names[i]
+static uint8_t binaryComparisons(uint8_t i) {
+  int lo = 0;
+  int hi = NR_NAMES - 1;
+  uint8_t n = 0;
+  while (lo <= hi) {
+    int mid = (lo + hi) / 2;
+    n++;
+    if (mid == i) {
+      break;
+    } else if (i < mid) {
+      hi = mid - 1;
+    } else {
+      lo = mid + 1;
+    }
+  }
+  return n;
+}
+
+static void benchDispatch(uint32_t iterations) {
+  std::string lines;
+  for (uint8_t i = 0; i < NR_NAMES; ++i) {
+    lines += names[i];
+    lines += " 1 2\n";
+  }
+
+  // the legacy list holds the 8 character prefixes such that every line matches
+  LegacyParser legacy;
+  for (uint8_t i = 0; i < NR_NAMES; ++i) {
+    legacy.add(names[i]);
+  }
+  std::vector<SerialCommand::SerialCommandCallback> table(NR_NAMES);
+  for (uint8_t i = 0; i < NR_NAMES; ++i) {
+    table[i].command = names[i];
+    table[i].function = handler;
+    table[i].argument = NULL;
+  }
+  SerialCommand sCmd;
+  sCmd.setCommands(table.data(), NR_NAMES);
+
+  handled = 0;
+  benchClock::time_point start = benchClock::now();
+  for (uint32_t it = 0; it < iterations; ++it) {
+    for (size_t i = 0; i < lines.size(); ++i) {
+      legacy.processChar(lines[i]);
+    }
+  }
+  double legacyNs = nsPer(start, iterations * NR_NAMES);
+  uint32_t legacyHandled = handled;
+
+  handled = 0;
+  start = benchClock::now();
+  for (uint32_t it = 0; it < iterations; ++it) {
+    for (size_t i = 0; i < lines.size(); ++i) {
+      sCmd.processChar(lines[i]);
+    }
+  }
+  double tableNs = nsPer(start, iterations * NR_NAMES);
+
+  uint32_t binary = 0;
+  uint8_t binaryMax = 0;
+  for (uint8_t i = 0; i < NR_NAMES; ++i) {
+    binary += binaryComparisons(i);
+    binaryMax = max(binaryMax, binaryComparisons(i));
+  }
+  printf("dispatch of %u commands, per line \"CMD 1 2\":\n", NR_NAMES);
+  printf("  linear list in RAM:     %7.1f ns, %5.1f comparisons (max %u), %u handled\n",
+         legacyNs, (double)legacy.comparisons / (iterations * NR_NAMES), NR_NAMES, legacyHandled);
+  printf("  sorted table in flash:  %7.1f ns, %5.1f comparisons (max %u), %u handled\n",
+         tableNs, (double)binary / NR_NAMES, binaryMax, (uint32_t)handled);
+}
+
+static void reportSram() {
+  uint16_t list = NR_LEGACY * (LEGACY_MAXCOMMANDLENGTH + 1 + AVR_POINTER) + AVR_MALLOC_HEADER;
+  uint16_t literals = 0;
+  for (uint8_t i = 0; i < NR_LEGACY; ++i) {
+    literals += strlen(legacyNames[i]) + 1;
+  }
+  // the copy of the matched table entry kept by SerialCommand
+  uint16_t entry = 3 * AVR_POINTER;
+  printf("SRAM of the %u commands on the ATmega328P:\n", NR_LEGACY);
+  printf("  before: %u bytes heap (list) + %u bytes .data (string literals)\n", list, literals);
+  printf("  after:  %u bytes (entry copy), table and strings in flash; %d bytes freed\n",
+         entry, (int)(list + literals - entry));
+}
+
+// ---- formatting of replies as done before by Print of the Arduino core: each character is
+// a virtual write(), floats are printed by printFloat() one digit after the other by float
+// operations; double is float on the ATmega328P
+struct LegacyPrint {
+  char buffer[RESPONSE_BUFFER];
+  uint8_t len;
+
+  LegacyPrint() : len(0) {
+  }
+  virtual ~LegacyPrint() {
+  }
+
+  virtual size_t write(uint8_t c) {
+    if (len < RESPONSE_BUFFER) {
+      buffer[len++] = c;
+    }
+    return 1;
+  }
+
+  size_t print(const char* s) {
+    size_t n = 0;
+    while (*s != '\0') {
+      n += write(*s++);
+    }
+    return n;
+  }
+
+  size_t printNumber(unsigned long n) {
+    char buf[8 * sizeof(long) + 1];
+    char* str = &buf[sizeof(buf) - 1];
+    *str = '\0';
+    do {
+      unsigned long m = n;
+      n /= 10;
+      *--str = '0' + (m - 10 * n);
+    } while (n);
+    return print(str);
+  }
+
+  size_t print(long n) {
+    if (n < 0) {
+      return write('-') + printNumber(-n);
+    }
+    return printNumber(n);
+  }
+
+  size_t printFloat(float number, uint8_t digits) {
+    size_t n = 0;
+    if (isnan(number)) return print("nan");
+    if (isinf(number)) return print("inf");
+    if (number > 4294967040.0f) return print("ovf");
+    if (number < -4294967040.0f) return print("ovf");
+    if (number < 0.0f) {
+      n += write('-');
+      number = -number;
+    }
+    float rounding = 0.5f;
+    for (uint8_t i = 0; i < digits; ++i) {
+      rounding /= 10.0f;
+    }
+    number += rounding;
+    unsigned long intPart = (unsigned long)number;
+    float remainder = number - (float)intPart;
+    n += printNumber(intPart);
+    if (digits > 0) {
+      n += write('.');
+    }
+    while (digits-- > 0) {
+      remainder *= 10.0f;
+      unsigned int toPrint = (unsigned int)remainder;
+      n += printNumber(toPrint);
+      remainder -= toPrint;
+    }
+    return n;
+  }
+};
+
+// II_SCAN (5 integers) and GETSCALING (4 floats with 6 decimals) as formatted by the handlers
+static void benchFormatting(uint32_t iterations) {
+  std::vector<sensorData> scans(256);
+  std::vector<float> scales(256 * NR_SCALE_VALUES);
+  for (uint16_t i = 0; i < 256; ++i) {
+    for (uint8_t c = 0; c < 5; ++c) {
+      scans[i].value[c] = 1000 + 37 * i + 3001 * c;
+    }
+    for (uint8_t c = 0; c < NR_SCALE_VALUES; ++c) {
+      scales[i * NR_SCALE_VALUES + c] = 0.8f + 0.00123f * i - 0.25f * c;
+    }
+  }
+
+  uint32_t sum = 0;
+  uint32_t differ = 0;
+  benchClock::time_point start = benchClock::now();
+  for (uint32_t it = 0; it < iterations; ++it) {
+    LegacyPrint legacy;
+    legacy.print("II_SCAN:");
+    for (uint8_t c = 0; c < 5; ++c) {
+      legacy.print((long)scans[it & 0xFF].value[c]);
+      legacy.print(SEPARATOR);
+    }
+    legacy.print("\n");
+    sum += legacy.len;
+  }
+  double legacyScanNs = nsPer(start, iterations);
+
+  start = benchClock::now();
+  for (uint32_t it = 0; it < iterations; ++it) {
+    ToninoResponse reply;
+    reply.print(F("II_SCAN:"));
+    for (uint8_t c = 0; c < 5; ++c) {
+      reply.print(scans[it & 0xFF].value[c]);
+      reply.print(SEPARATOR);
+    }
+    reply.write('\n');
+    sum += reply._len;
+    // discarded instead of sent
+    reply._len = 0;
+  }
+  double scanNs = nsPer(start, iterations);
+
+  start = benchClock::now();
+  for (uint32_t it = 0; it < iterations; ++it) {
+    LegacyPrint legacy;
+    legacy.print("GETSCALING:");
+    for (uint8_t c = 0; c < NR_SCALE_VALUES; ++c) {
+      legacy.printFloat(scales[(it & 0xFF) * NR_SCALE_VALUES + c], 6);
+      legacy.print(SEPARATOR);
+    }
+    legacy.print("\n");
+    sum += legacy.len;
+  }
+  double legacyScalingNs = nsPer(start, iterations);
+
+  start = benchClock::now();
+  for (uint32_t it = 0; it < iterations; ++it) {
+    ToninoResponse reply;
+    reply.print(F("GETSCALING:"));
+    for (uint8_t c = 0; c < NR_SCALE_VALUES; ++c) {
+      reply.print(scales[(it & 0xFF) * NR_SCALE_VALUES + c], 6);
+      reply.print(SEPARATOR);
+    }
+    reply.write('\n');
+    sum += reply._len;
+    reply._len = 0;
+  }
+  double scalingNs = nsPer(start, iterations);
+
+  // both give the same text
+  for (uint16_t i = 0; i < 256 * NR_SCALE_VALUES; ++i) {
+    LegacyPrint legacy;
+    legacy.printFloat(scales[i], 6);
+    ToninoResponse reply;
+    reply.print(scales[i], 6);
+    if (legacy.len != reply._len || memcmp(legacy.buffer, reply._buf, reply._len) != 0) {
+      differ++;
+    }
+    reply._len = 0;
+  }
+
+  printf("formatting of replies (checksum %u, %u of %u floats formatted differently):\n",
+         sum & 0xFF, differ, 256 * NR_SCALE_VALUES);
+  printf("  II_SCAN    Print:         %7.1f ns\n", legacyScanNs);
+  printf("  II_SCAN    ToninoResponse:%7.1f ns (%.2fx)\n", scanNs, scanNs / legacyScanNs);
+  printf("  GETSCALING Print:         %7.1f ns\n", legacyScalingNs);
+  printf("  GETSCALING ToninoResponse:%7.1f ns (%.2fx)\n", scalingNs, scalingNs / legacyScalingNs);
+}
+
+// ---- hot paths of a scan and of reading the config
+static void benchFitValue(uint32_t iterations) {
+  TCS3200 sensor(MOCK_PIN_S2, MOCK_PIN_S3, MOCK_PIN_LED, MOCK_PIN_POWER, NULL);
+  sensorData sd;
+  memset(&sd, 0, sizeof(sd));
+  int32_t sum = 0;
+  benchClock::time_point start = benchClock::now();
+  for (uint32_t it = 0; it < iterations * 100; ++it) {
+    sd.value[RED_IDX] = 5000 + (it & 0xFF);
+    sd.value[BLUE_IDX] = 2500;
+    float raw = 0.0;
+    sum += sensor.fitValue(&sd, &raw);
+  }
+  printf("fitValue:                 %7.1f ns (checksum %d)\n", nsPer(start, iterations * 100), (int)(sum & 0xFF));
+}
+
+static void benchEepromRead(uint32_t iterations) {
+  LCD display;
+  TCS3200 sensor(MOCK_PIN_S2, MOCK_PIN_S3, MOCK_PIN_LED, MOCK_PIN_POWER, &display);
+  ToninoConfig config(&sensor, &display);
+  mock::reset();
+  for (uint16_t a = 0; a <= E2END; ++a) {
+    EEPROM.write(a, EEPROM_SET);
+  }
+  uint32_t reads = mock::eepromReads();
+  uint32_t sum = 0;
+  benchClock::time_point start = benchClock::now();
+  for (uint32_t it = 0; it < iterations * 100; ++it) {
+    sum += config.checkedEepromRead(EEPROM_START_ADDRESS + (it % EEPROM_SIZE));
+  }
+  printf("checkedEepromRead:        %7.1f ns, %u EEPROM reads (checksum %u)\n",
+         nsPer(start, iterations * 100), (mock::eepromReads() - reads) / (iterations * 100), sum & 0xFF);
+}
+
+int main(int argc, char** argv) {
+  uint32_t iterations = (argc > 1 ? strtoul(argv[1], NULL, 10) : 20000);
+  if (iterations == 0) {
+    iterations = 1;
+  }
+  benchDispatch(iterations);
+  reportSram();
+  benchFormatting(iterations);
+  benchFitValue(iterations);
+  benchEepromRead(iterations);
+  return 0;
+}
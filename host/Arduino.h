@@ -0,0 +1,139 @@
+// Arduino.h
+//-----------
+// Arduino core API for the host build; only what the firmware uses
+// time, pins, serial line, EEPROM, I2C and the color sensor are simulated by mock.cpp (see mock.h)
+//
+// *** BSD License ***
+// ------------------------------------------------------------------------------------------
+// Copyright (c) 2017, Paul Holleis, Marko Luther
+// All rights reserved.
+//
+// Authors:  Paul Holleis, Marko Luther
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//   Redistributions of source code must retain the above copyright notice, this list of
+//   conditions and the following disclaimer.
+//
+//   Redistributions in binary form must reproduce the above copyright notice, this list
+//   of conditions and the following disclaimer in the documentation and/or other materials
+//   provided with the distribution.
+//
+//   Neither the name of the copyright holder(s) nor the names of its contributors may be
+//   used to endorse or promote products derived from this software without specific prior
+//   written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// ------------------------------------------------------------------------------------------
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <ctype.h>
+#include <stddef.h>
+
+#include <avr/pgmspace.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT        0x0
+#define OUTPUT       0x1
+#define INPUT_PULLUP 0x2
+
+#define A0 14
+#define A7 21
+#define NUM_PINS (A7 + 1)
+
+#define DEC 10
+#define HEX 16
+
+#define B00111111 63
+
+#define bit(b) (1UL << (b))
+#define bitRead(value, b) (((value) >> (b)) & 0x01)
+
+// the core defines these as macros; templates keep the firmware's usage valid
+// without clashing with the C++ standard library
+template <class T, class U> constexpr T min(T a, U b) { return (b < a) ? b : a; }
+template <class T, class U> constexpr T max(T a, U b) { return (a < b) ? b : a; }
+template <class T, class L, class H> constexpr T constrain(T x, L lo, H hi) {
+  return (x < lo) ? lo : ((x > hi) ? hi : x);
+}
+
+extern "C" {
+  void yield(void);
+}
+
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+
+// string literal in flash, as in WString.h of the Arduino core
+class __FlashStringHelper;
+#define F(string_literal) (reinterpret_cast<const __FlashStringHelper *>(PSTR(string_literal)))
+
+class Print {
+  public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* buf, size_t size);
+    size_t write(const char* str) { return str == NULL ? 0 : write((const uint8_t*)str, strlen(str)); }
+
+    size_t print(const char* s);
+    size_t print(const __FlashStringHelper* s) { return print(reinterpret_cast<const char*>(s)); }
+    size_t print(char c);
+    size_t print(unsigned char n, int base = DEC);
+    size_t print(int n, int base = DEC);
+    size_t print(unsigned int n, int base = DEC);
+    size_t print(long n, int base = DEC);
+    size_t print(unsigned long n, int base = DEC);
+    size_t print(double n, int digits = 2);
+
+    size_t println(void);
+    template <class T> size_t println(T v) { size_t n = print(v); return n + println(); }
+    template <class T> size_t println(T v, int f) { size_t n = print(v, f); return n + println(); }
+};
+
+// the hardware UART; the other end of the line is driven by the test (see mock.h)
+class HardwareSerial : public Print {
+  public:
+    void begin(unsigned long baud);
+    void end();
+    int available(void);
+    int peek(void);
+    int read(void);
+    int availableForWrite(void);
+    void flush(void);
+    virtual size_t write(uint8_t c);
+    virtual size_t write(const uint8_t* buf, size_t size);
+    using Print::write;
+    operator bool() { return true; }
+};
+
+extern HardwareSerial Serial;
+
+#endif
@@ -0,0 +1,22 @@
+// EEPROM.h
+//---------
+// 1KB of simulated EEPROM; writes take as long as on the ATmega328P, see mock.h
+
+#ifndef EEPROM_h
+#define EEPROM_h
+
+#include <stdint.h>
+
+#define E2END 0x3FF
+
+class EEPROMClass {
+  public:
+    uint8_t read(int idx);
+    void write(int idx, uint8_t val);
+    void update(int idx, uint8_t val) { if (read(idx) != val) write(idx, val); }
+    uint16_t length() { return E2END + 1; }
+};
+
+extern EEPROMClass EEPROM;
+
+#endif
@@ -0,0 +1,25 @@
+// Wire.h
+//-------
+// I2C master; transmissions take the time of a 100kHz bus and are recorded by the mock
+
+#ifndef TwoWire_h
+#define TwoWire_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define BUFFER_LENGTH 32
+
+class TwoWire {
+  public:
+    void begin();
+    void beginTransmission(uint8_t address);
+    void beginTransmission(int address) { beginTransmission((uint8_t)address); }
+    uint8_t endTransmission(void);
+    size_t write(uint8_t data);
+    size_t write(const uint8_t* data, size_t quantity);
+};
+
+extern TwoWire Wire;
+
+#endif
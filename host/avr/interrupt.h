@@ -0,0 +1,14 @@
+// avr/interrupt.h
+//----------------
+// interrupt handlers are plain functions on the host, called by the mock when the event occurs
+
+#ifndef _HOST_AVR_INTERRUPT_H
+#define _HOST_AVR_INTERRUPT_H
+
+#define ISR(vector, ...) extern "C" void vector(void)
+#define EMPTY_INTERRUPT(vector) extern "C" void vector(void) {}
+
+#define cli()
+#define sei()
+
+#endif
@@ -0,0 +1,71 @@
+// avr/io.h
+//---------
+// ATmega328P registers used by the firmware, plain variables on the host
+// the power relevant ones (PRR, ADCSRA, SMCR) are checked by the mock, see mock.h
+
+#ifndef _HOST_AVR_IO_H
+#define _HOST_AVR_IO_H
+
+#include <stdint.h>
+
+#define F_CPU 16000000UL
+
+extern volatile uint8_t DIDR0;
+extern volatile uint8_t SPCR;
+extern volatile uint8_t PCICR;
+extern volatile uint8_t PCIFR;
+extern volatile uint8_t PCMSK2;
+extern volatile uint8_t TCCR0B;
+extern volatile uint8_t UCSR0A;
+extern volatile uint8_t UCSR0B;
+extern volatile uint16_t UBRR0;
+extern volatile uint8_t PRR;
+extern volatile uint8_t ADCSRA;
+extern volatile uint8_t SMCR;
+extern volatile uint8_t MCUCR;
+extern volatile uint8_t MCUSR;
+extern volatile uint8_t WDTCSR;
+
+// TCCR0B
+#define CS00 0
+#define CS01 1
+#define CS02 2
+// UCSR0A
+#define U2X0 1
+// UCSR0B
+#define UDRIE0 5
+// PCICR, PCIFR, PCMSK2
+#define PCIE2 2
+#define PCIF2 2
+#define PCINT16 0
+// PRR
+#define PRADC 0
+#define PRUSART0 1
+#define PRSPI 2
+#define PRTIM1 3
+#define PRTIM0 5
+#define PRTIM2 6
+#define PRTWI 7
+// ADCSRA
+#define ADEN 7
+// SMCR
+#define SE 0
+#define SM0 1
+#define SM1 2
+#define SM2 3
+// MCUCR
+#define BODSE 5
+#define BODS 6
+// MCUSR
+#define WDRF 3
+// WDTCSR
+#define WDP0 0
+#define WDP1 1
+#define WDP2 2
+#define WDE 3
+#define WDCE 4
+#define WDP3 5
+#define WDIE 6
+#define WDIF 7
+
+#endif
@@ -0,0 +1,26 @@
+// avr/pgmspace.h
+//---------------
+// program memory is ordinary memory on the host
+
+#ifndef _HOST_AVR_PGMSPACE_H
+#define _HOST_AVR_PGMSPACE_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define PROGMEM
+#define PSTR(s) (s)
+
+#define pgm_read_byte(p)  (*(const uint8_t*)(p))
+#define pgm_read_word(p)  (*(const uint16_t*)(p))
+#define pgm_read_dword(p) (*(const uint32_t*)(p))
+#define pgm_read_ptr(p)   (*(void* const*)(p))
+
+#define memcpy_P  memcpy
+#define strcmp_P  strcmp
+#define strncmp_P strncmp
+#define strchr_P  strchr
+#define strncpy_P strncpy
+#define strlen_P  strlen
+
+#endif
@@ -0,0 +1,40 @@
+// avr/power.h
+//------------
+// power reduction and clock prescaler, acting on the simulated PRR
+
+#ifndef _HOST_AVR_POWER_H
+#define _HOST_AVR_POWER_H
+
+#include <avr/io.h>
+
+#define power_adc_enable()     (PRR &= (uint8_t)~(1 << PRADC))
+#define power_adc_disable()    (PRR |= (uint8_t)(1 << PRADC))
+#define power_spi_enable()     (PRR &= (uint8_t)~(1 << PRSPI))
+#define power_spi_disable()    (PRR |= (uint8_t)(1 << PRSPI))
+#define power_timer0_enable()  (PRR &= (uint8_t)~(1 << PRTIM0))
+#define power_timer0_disable() (PRR |= (uint8_t)(1 << PRTIM0))
+#define power_usart0_enable()  (PRR &= (uint8_t)~(1 << PRUSART0))
+#define power_usart0_disable() (PRR |= (uint8_t)(1 << PRUSART0))
+#define power_twi_enable()     (PRR &= (uint8_t)~(1 << PRTWI))
+#define power_twi_disable()    (PRR |= (uint8_t)(1 << PRTWI))
+#define power_timer1_enable()  (PRR &= (uint8_t)~(1 << PRTIM1))
+#define power_timer1_disable() (PRR |= (uint8_t)(1 << PRTIM1))
+#define power_timer2_enable()  (PRR &= (uint8_t)~(1 << PRTIM2))
+#define power_timer2_disable() (PRR |= (uint8_t)(1 << PRTIM2))
+
+typedef enum {
+  clock_div_1 = 0,
+  clock_div_2 = 1,
+  clock_div_4 = 2,
+  clock_div_8 = 3,
+  clock_div_16 = 4,
+  clock_div_32 = 5,
+  clock_div_64 = 6,
+  clock_div_128 = 7,
+  clock_div_256 = 8
+} clock_div_t;
+
+void clock_prescale_set(clock_div_t div);
+clock_div_t clock_prescale_get(void);
+
+#endif
@@ -0,0 +1,23 @@
+// avr/sleep.h
+//------------
+// sleep_cpu() lets the simulated time pass until the next interrupt, see mock.cpp
+
+#ifndef _HOST_AVR_SLEEP_H
+#define _HOST_AVR_SLEEP_H
+
+#include <avr/io.h>
+
+#define SLEEP_MODE_IDLE       (0)
+#define SLEEP_MODE_ADC        (1 << SM0)
+#define SLEEP_MODE_PWR_DOWN   (1 << SM1)
+#define SLEEP_MODE_PWR_SAVE   ((1 << SM0) | (1 << SM1))
+#define SLEEP_MODE_STANDBY    ((1 << SM1) | (1 << SM2))
+
+#define set_sleep_mode(mode)  (SMCR = (uint8_t)((SMCR & ~((1 << SM0) | (1 << SM1) | (1 << SM2))) | (mode)))
+#define sleep_enable()        (SMCR |= (uint8_t)(1 << SE))
+#define sleep_disable()       (SMCR &= (uint8_t)~(1 << SE))
+#define sleep_bod_disable()   (MCUCR |= (uint8_t)(1 << BODS))
+
+void sleep_cpu(void);
+
+#endif
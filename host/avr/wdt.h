@@ -0,0 +1,25 @@
+// avr/wdt.h
+//----------
+// watchdog timer; the mock calls WDT_vect when the interrupt mode timeout elapses
+
+#ifndef _HOST_AVR_WDT_H
+#define _HOST_AVR_WDT_H
+
+#include <avr/io.h>
+
+#define WDTO_15MS  0
+#define WDTO_30MS  1
+#define WDTO_60MS  2
+#define WDTO_120MS 3
+#define WDTO_250MS 4
+#define WDTO_500MS 5
+#define WDTO_1S    6
+#define WDTO_2S    7
+#define WDTO_4S    8
+#define WDTO_8S    9
+
+#define wdt_reset()
+void wdt_enable(uint8_t timeout);
+void wdt_disable(void);
+
+#endif
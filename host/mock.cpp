@@ -0,0 +1,744 @@
+// mock.cpp
+//---------
+// simulated Arduino Nano for the host build, see mock.h
+//
+// *** BSD License ***
+// ------------------------------------------------------------------------------------------
+// Copyright (c) 2017, Paul Holleis, Marko Luther
+// All rights reserved.
+//
+// Authors:  Paul Holleis, Marko Luther
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//   Redistributions of source code must retain the above copyright notice, this list of
+//   conditions and the following disclaimer.
+//
+//   Redistributions in binary form must reproduce the above copyright notice, this list
+//   of conditions and the following disclaimer in the documentation and/or other materials
+//   provided with the distribution.
+//
+//   Neither the name of the copyright holder(s) nor the names of its contributors may be
+//   used to endorse or promote products derived from this software without specific prior
+//   written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// ------------------------------------------------------------------------------------------
+
+#include <mock.h>
+#include <EEPROM.h>
+#include <FreqCount.h>
+#include <Wire.h>
+#include <avr/power.h>
+#include <avr/sleep.h>
+#include <avr/wdt.h>
+
+#include <stdio.h>
+#include <deque>
+
+volatile uint8_t DIDR0;
+volatile uint8_t SPCR;
+volatile uint8_t PCICR;
+volatile uint8_t PCIFR;
+volatile uint8_t PCMSK2;
+volatile uint8_t TCCR0B;
+volatile uint8_t UCSR0A;
+volatile uint8_t UCSR0B;
+volatile uint16_t UBRR0;
+volatile uint8_t PRR;
+volatile uint8_t ADCSRA;
+volatile uint8_t SMCR;
+volatile uint8_t MCUCR;
+volatile uint8_t MCUSR;
+volatile uint8_t WDTCSR;
+
+HardwareSerial Serial;
+EEPROMClass EEPROM;
+FreqCountClass FreqCount;
+TwoWire Wire;
+
+// defaults for the hooks and interrupt handlers the firmware may define
+extern "C" {
+  void __attribute__((weak)) yield(void) {}
+  void __attribute__((weak)) PCINT2_vect(void) {}
+  void __attribute__((weak)) WDT_vect(void) {}
+}
+
+namespace {
+
+  const uint64_t NEVER = ~(uint64_t)0;
+
+  struct LineByte {
+    uint64_t at;  // time the stop bit has been received
+    uint8_t c;
+  };
+
+  // time
+  uint64_t realUs = 0;      // wall clock
+  uint64_t cpuUs = 0;       // stopped in power down, source of millis()
+  bool poweredDown = false;
+  clock_div_t prescaler = clock_div_1;
+
+  // serial line
+  uint32_t hostBaud = 115200;
+  bool uartOn = false;
+  std::deque<LineByte> toDevice;
+  uint64_t toDeviceEnd = 0;
+  std::deque<LineByte> toHost;
+  uint64_t txEnd = 0;
+  uint8_t rxBuf[MOCK_SERIAL_BUFFER];
+  uint8_t rxHead = 0;
+  uint8_t rxLen = 0;
+  uint32_t lost = 0;
+
+  // color sensor and frequency counter
+  mock::Light ambient;
+  mock::Light ledLight;
+  mock::LightFunction lightFunction = NULL;
+  bool gateOpen = false;
+  uint16_t gateMs = 0;
+  uint64_t gateEnd = 0;     // cpu time
+  double pulses = 0.0;
+  uint32_t counted = 0;
+  bool countReady = false;
+  uint32_t nrGates = 0;
+
+  // EEPROM
+  uint8_t rom[E2END + 1];
+  uint32_t romReads = 0;
+  uint32_t romWrites = 0;
+
+  // I2C
+  std::string i2cBuf;
+  std::string i2cLastBuf;
+  uint32_t i2cCount = 0;
+
+  // pins and power
+  uint8_t pins[NUM_PINS];
+  uint64_t idleUs = 0;
+  uint64_t powerDownUs = 0;
+  uint64_t clockedUs[8];
+  uint64_t adcUs = 0;
+
+  // time of one byte (start, 8 data, stop bit)
+  uint64_t byteTime(uint32_t baud) {
+    return (10000000ULL + baud - 1) / baud;
+  }
+
+  bool baudMatches() {
+    uint32_t device = mock::deviceBaud();
+    uint32_t diff = (device > hostBaud ? device - hostBaud : hostBaud - device);
+    return (uint64_t)diff * 1000 <= (uint64_t)hostBaud * MOCK_BAUD_TOLERANCE;
+  }
+
+  // a byte received at the wrong baud rate, mostly framing errors
+  uint8_t garble(uint8_t c) {
+    return c | 0x80;
+  }
+
+  double sensorHz() {
+    if (pins[MOCK_PIN_POWER] == LOW) {
+      return 0.0;
+    }
+    bool s2 = pins[MOCK_PIN_S2];
+    bool s3 = pins[MOCK_PIN_S3];
+    uint8_t idx = (s2 ? (s3 ? 2 : 0) : (s3 ? 3 : 1));  // green, white, blue, red
+    bool ledOn = pins[MOCK_PIN_LED];
+    mock::Light light;
+    if (lightFunction != NULL) {
+      lightFunction(realUs, ledOn, &light);
+    } else {
+      light = ambient;
+      if (ledOn) {
+        for (uint8_t i = 0; i < 4; ++i) {
+          light.hz[i] += ledLight.hz[i];
+        }
+      }
+    }
+    return light.hz[idx];
+  }
+
+  // moves the time forward without any events in between
+  void step(uint64_t dt) {
+    if (!poweredDown) {
+      cpuUs += dt;
+      for (uint8_t b = 0; b < 8; ++b) {
+        if (!(PRR & (1 << b))) {
+          clockedUs[b] += dt;
+        }
+      }
+      if (gateOpen) {
+        pulses += sensorHz() * dt / 1000000.0;
+      }
+    }
+    if ((ADCSRA & (1 << ADEN)) && !(PRR & (1 << PRADC))) {
+      adcUs += dt;
+    }
+    realUs += dt;
+  }
+
+  // moves received bytes into the UART receive buffer
+  void deliver() {
+    while (!toDevice.empty() && toDevice.front().at <= realUs) {
+      uint8_t c = toDevice.front().c;
+      toDevice.pop_front();
+      if (poweredDown || !uartOn || (PRR & (1 << PRUSART0)) || rxLen == MOCK_SERIAL_BUFFER) {
+        ++lost;
+        continue;
+      }
+      rxBuf[(rxHead + rxLen) % MOCK_SERIAL_BUFFER] = baudMatches() ? c : garble(c);
+      ++rxLen;
+    }
+    if (txEnd > realUs + byteTime(mock::deviceBaud() > 0 ? mock::deviceBaud() : hostBaud)) {
+      UCSR0B |= (1 << UDRIE0);
+    } else {
+      UCSR0B &= ~(1 << UDRIE0);
+    }
+  }
+
+  // the frequency counter finished a gate
+  void gateDone() {
+    counted = (uint32_t)pulses;
+    pulses -= counted;
+    countReady = true;
+    gateEnd += (uint64_t)gateMs * 1000;
+  }
+
+  // wake up time of the watchdog in interrupt mode, NEVER if off
+  uint64_t watchdogTimeout() {
+    if (!(WDTCSR & ((1 << WDIE) | (1 << WDE)))) {
+      return NEVER;
+    }
+    uint8_t prescale = (WDTCSR & 0x07) | ((WDTCSR & (1 << WDP3)) ? 8 : 0);
+    return 16000ULL << prescale;
+  }
+}
+
+namespace {
+  // power on state before the firmware's constructors run
+  struct PowerOn {
+    PowerOn() {
+      mock::reset();
+    }
+  } powerOn;
+}
+
+namespace mock {
+
+  void reset() {
+    DIDR0 = SPCR = PCICR = PCIFR = PCMSK2 = 0;
+    UCSR0A = UCSR0B = 0;
+    UBRR0 = 0;
+    PRR = ADCSRA = SMCR = MCUCR = MCUSR = WDTCSR = 0;
+    // as left by init() of the Arduino core: timer 0 running for millis(), ADC enabled
+    TCCR0B = (1 << CS01) | (1 << CS00);
+    ADCSRA = (1 << ADEN);
+
+    realUs = cpuUs = 0;
+    poweredDown = false;
+    prescaler = clock_div_1;
+
+    hostBaud = 115200;
+    uartOn = false;
+    toDevice.clear();
+    toDeviceEnd = 0;
+    toHost.clear();
+    txEnd = 0;
+    rxHead = rxLen = 0;
+    lost = 0;
+
+    memset(&ambient, 0, sizeof(ambient));
+    memset(&ledLight, 0, sizeof(ledLight));
+    lightFunction = NULL;
+    gateOpen = countReady = false;
+    pulses = 0.0;
+    counted = nrGates = 0;
+
+    memset(rom, 0xFF, sizeof(rom));
+    romReads = romWrites = 0;
+
+    i2cBuf.clear();
+    i2cLastBuf.clear();
+    i2cCount = 0;
+
+    memset(pins, 0, sizeof(pins));
+    idleUs = powerDownUs = adcUs = 0;
+    memset(clockedUs, 0, sizeof(clockedUs));
+  }
+
+  uint64_t now() {
+    return realUs;
+  }
+
+  void advance(uint64_t us) {
+    uint64_t end = realUs + us;
+    while (true) {
+      uint64_t next = end;
+      if (!toDevice.empty() && toDevice.front().at < next) {
+        next = max(toDevice.front().at, realUs);
+      }
+      if (gateOpen && !poweredDown && realUs + (gateEnd - cpuUs) < next) {
+        next = realUs + (gateEnd - cpuUs);
+      }
+      step(next - realUs);
+      deliver();
+      if (gateOpen && !poweredDown && cpuUs >= gateEnd) {
+        gateDone();
+      }
+      if (realUs >= end) {
+        break;
+      }
+    }
+  }
+
+  void setHostBaud(uint32_t baud) {
+    hostBaud = baud;
+  }
+
+  uint32_t deviceBaud() {
+    if (!uartOn) {
+      return 0;
+    }
+    uint32_t samples = (UCSR0A & (1 << U2X0)) ? 8 : 16;
+    uint32_t clock = F_CPU >> prescaler;
+    return clock / (samples * ((uint32_t)UBRR0 + 1));
+  }
+
+  void send(const char* s) {
+    send((const uint8_t*)s, strlen(s));
+  }
+
+  void send(const uint8_t* data, size_t len) {
+    sendAt(realUs, data, len);
+  }
+
+  void sendAt(uint64_t at, const char* s) {
+    sendAt(at, (const uint8_t*)s, strlen(s));
+  }
+
+  void sendAt(uint64_t at, const uint8_t* data, size_t len) {
+    uint64_t t = max(at, toDeviceEnd);
+    for (size_t i = 0; i < len; ++i) {
+      t += byteTime(hostBaud);
+      LineByte b = { t, data[i] };
+      toDevice.push_back(b);
+    }
+    toDeviceEnd = t;
+  }
+
+  size_t sending() {
+    return toDevice.size();
+  }
+
+  std::string received() {
+    std::string s;
+    for (size_t i = 0; i < toHost.size() && toHost[i].at <= realUs; ++i) {
+      s += (char)toHost[i].c;
+    }
+    return s;
+  }
+
+  std::string takeReceived(std::vector<uint64_t>* at) {
+    std::string s;
+    while (!toHost.empty() && toHost.front().at <= realUs) {
+      s += (char)toHost.front().c;
+      if (at != NULL) {
+        at->push_back(toHost.front().at);
+      }
+      toHost.pop_front();
+    }
+    return s;
+  }
+
+  uint32_t rxLost() {
+    return lost;
+  }
+
+  void setLight(const Light& a, const Light& led) {
+    ambient = a;
+    ledLight = led;
+  }
+
+  void setLightFunction(LightFunction f) {
+    lightFunction = f;
+  }
+
+  uint32_t gates() {
+    return nrGates;
+  }
+
+  uint8_t* eeprom() {
+    return rom;
+  }
+
+  uint32_t eepromReads() {
+    return romReads;
+  }
+
+  uint32_t eepromWrites() {
+    return romWrites;
+  }
+
+  uint32_t i2cTransmissions() {
+    return i2cCount;
+  }
+
+  std::string i2cLast() {
+    return i2cLastBuf;
+  }
+
+  uint8_t pin(uint8_t p) {
+    return p < NUM_PINS ? pins[p] : LOW;
+  }
+
+  uint64_t idleTime() {
+    return idleUs;
+  }
+
+  uint64_t powerDownTime() {
+    return powerDownUs;
+  }
+
+  uint64_t clockedTime(uint8_t prrBit) {
+    return prrBit < 8 ? clockedUs[prrBit] : 0;
+  }
+
+  uint64_t adcOnTime() {
+    return adcUs;
+  }
+}
+
+
+// ---- time
+
+unsigned long millis(void) {
+  mock::advance(MOCK_POLL_US);
+  return (unsigned long)(uint32_t)(cpuUs / 1000);
+}
+
+unsigned long micros(void) {
+  mock::advance(MOCK_POLL_US);
+  return (unsigned long)(uint32_t)cpuUs;
+}
+
+void delay(unsigned long ms) {
+  uint64_t end = cpuUs + (uint64_t)ms * 1000;
+  while (cpuUs < end) {
+    yield();
+    if (cpuUs < end) {
+      mock::advance(min(end - cpuUs, (uint64_t)MOCK_YIELD_US));
+    }
+  }
+}
+
+void delayMicroseconds(unsigned int us) {
+  mock::advance(us);
+}
+
+// ---- pins
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  (void)pin;
+  (void)mode;
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+  if (pin < NUM_PINS) {
+    pins[pin] = (val ? HIGH : LOW);
+  }
+}
+
+int digitalRead(uint8_t pin) {
+  return pin < NUM_PINS ? pins[pin] : LOW;
+}
+
+// ---- clock, sleep and watchdog
+
+void clock_prescale_set(clock_div_t div) {
+  prescaler = div;
+}
+
+clock_div_t clock_prescale_get(void) {
+  return prescaler;
+}
+
+void wdt_enable(uint8_t timeout) {
+  WDTCSR = (1 << WDE) | (timeout & 0x07) | ((timeout & 0x08) ? (1 << WDP3) : 0);
+}
+
+void wdt_disable(void) {
+  WDTCSR = 0;
+}
+
+// sleeps in the mode set by set_sleep_mode() until an enabled interrupt occurs
+void sleep_cpu(void) {
+  if (!(SMCR & (1 << SE))) {
+    return;
+  }
+  uint8_t mode = SMCR & ((1 << SM0) | (1 << SM1) | (1 << SM2));
+  uint64_t wdt = watchdogTimeout();
+  if (mode == SLEEP_MODE_IDLE) {
+    // timer 0 (millis()) wakes up every ms, the UART with each received byte
+    uint64_t wake = NEVER;
+    if (!(PRR & (1 << PRTIM0))) {
+      wake = realUs + (1000 - cpuUs % 1000);
+    }
+    if (uartOn && !(PRR & (1 << PRUSART0)) && !toDevice.empty()) {
+      wake = min(wake, max(toDevice.front().at, realUs));
+    }
+    if (gateOpen) {
+      wake = min(wake, realUs + (gateEnd - cpuUs));
+    }
+    bool byWatchdog = false;
+    if (wdt != NEVER && realUs + wdt < wake) {
+      wake = realUs + wdt;
+      byWatchdog = true;
+    }
+    if (wake == NEVER) {
+      fprintf(stderr, "mock: idle sleep without wake up source\n");
+      abort();
+    }
+    idleUs += wake - realUs;
+    mock::advance(wake - realUs);
+    if (byWatchdog) {
+      WDT_vect();
+    }
+    return;
+  }
+  if (mode != SLEEP_MODE_PWR_DOWN) {
+    fprintf(stderr, "mock: sleep mode %d not simulated\n", mode);
+    abort();
+  }
+  // the UART is stopped, the start bit of a byte wakes up if the pin change interrupt of RXD is on
+  bool pcint = (PCICR & (1 << PCIE2)) && (PCMSK2 & (1 << PCINT16));
+  uint64_t wake = (wdt != NEVER ? realUs + wdt : NEVER);
+  bool byByte = false;
+  if (pcint && !toDevice.empty()) {
+    uint64_t edge = max(toDevice.front().at - byteTime(hostBaud), realUs);
+    if (edge < wake) {
+      wake = edge;
+      byByte = true;
+    }
+  }
+  if (wake == NEVER) {
+    fprintf(stderr, "mock: power down without wake up source\n");
+    abort();
+  }
+  if ((WDTCSR & (1 << WDE)) && !(WDTCSR & (1 << WDIE)) && !byByte) {
+    fprintf(stderr, "mock: watchdog reset\n");
+    abort();
+  }
+  uint64_t start = realUs;
+  poweredDown = true;
+  mock::advance(wake - realUs + MOCK_WAKEUP_US);
+  poweredDown = false;
+  powerDownUs += realUs - start;
+  if (byByte) {
+    PCIFR |= (1 << PCIF2);
+    PCINT2_vect();
+  } else {
+    WDT_vect();
+  }
+}
+
+// ---- Print
+
+size_t Print::write(const uint8_t* buf, size_t size) {
+  size_t n = 0;
+  while (size--) {
+    n += write(*buf++);
+  }
+  return n;
+}
+
+size_t Print::print(const char* s) {
+  return write(s);
+}
+
+size_t Print::print(char c) {
+  return write((uint8_t)c);
+}
+
+size_t Print::print(unsigned char n, int base) {
+  return print((unsigned long)n, base);
+}
+
+size_t Print::print(int n, int base) {
+  return print((long)n, base);
+}
+
+size_t Print::print(unsigned int n, int base) {
+  return print((unsigned long)n, base);
+}
+
+size_t Print::print(long n, int base) {
+  char buf[24];
+  snprintf(buf, sizeof(buf), base == HEX ? "%lx" : "%ld", n);
+  return write(buf);
+}
+
+size_t Print::print(unsigned long n, int base) {
+  char buf[24];
+  snprintf(buf, sizeof(buf), base == HEX ? "%lx" : "%lu", n);
+  return write(buf);
+}
+
+size_t Print::print(double n, int digits) {
+  char buf[48];
+  snprintf(buf, sizeof(buf), "%.*f", digits, n);
+  return write(buf);
+}
+
+size_t Print::println(void) {
+  return write("\r\n");
+}
+
+// ---- HardwareSerial
+
+void HardwareSerial::begin(unsigned long baud) {
+  // as the Arduino core: double speed mode except for 57600 at 16MHz
+  uint16_t setting = (F_CPU / 4 / baud - 1) / 2;
+  UCSR0A = (1 << U2X0);
+  if ((F_CPU == 16000000UL && baud == 57600) || setting > 4095) {
+    UCSR0A = 0;
+    setting = (F_CPU / 8 / baud - 1) / 2;
+  }
+  UBRR0 = setting;
+  uartOn = true;
+}
+
+void HardwareSerial::end() {
+  flush();
+  uartOn = false;
+  rxLen = 0;
+}
+
+int HardwareSerial::available(void) {
+  mock::advance(MOCK_POLL_US);
+  return rxLen;
+}
+
+int HardwareSerial::peek(void) {
+  return rxLen > 0 ? rxBuf[rxHead] : -1;
+}
+
+int HardwareSerial::read(void) {
+  if (rxLen == 0) {
+    return -1;
+  }
+  uint8_t c = rxBuf[rxHead];
+  rxHead = (rxHead + 1) % MOCK_SERIAL_BUFFER;
+  --rxLen;
+  return c;
+}
+
+int HardwareSerial::availableForWrite(void) {
+  if (!uartOn) {
+    return 0;
+  }
+  uint64_t bt = byteTime(mock::deviceBaud());
+  uint64_t pending = (txEnd > realUs ? (txEnd - realUs + bt - 1) / bt : 0);
+  return pending >= MOCK_SERIAL_BUFFER ? 0 : (int)(MOCK_SERIAL_BUFFER - 1 - pending);
+}
+
+void HardwareSerial::flush(void) {
+  if (txEnd > realUs) {
+    mock::advance(txEnd - realUs);
+  }
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+  if (!uartOn) {
+    return 0;
+  }
+  uint64_t bt = byteTime(mock::deviceBaud());
+  // blocks while the transmit buffer is full
+  if (txEnd > realUs + (MOCK_SERIAL_BUFFER + 1) * bt) {
+    mock::advance(txEnd - realUs - (MOCK_SERIAL_BUFFER + 1) * bt);
+  }
+  txEnd = max(txEnd, realUs) + bt;
+  LineByte b = { txEnd, baudMatches() ? c : garble(c) };
+  toHost.push_back(b);
+  return 1;
+}
+
+size_t HardwareSerial::write(const uint8_t* buf, size_t size) {
+  return Print::write(buf, size);
+}
+
+// ---- EEPROM
+
+uint8_t EEPROMClass::read(int idx) {
+  ++romReads;
+  mock::advance(MOCK_EEPROM_READ_US);
+  return rom[idx & E2END];
+}
+
+void EEPROMClass::write(int idx, uint8_t val) {
+  ++romWrites;
+  rom[idx & E2END] = val;
+  mock::advance(MOCK_EEPROM_WRITE_US);
+}
+
+// ---- FreqCount
+
+void FreqCountClass::begin(uint16_t msec) {
+  gateMs = msec;
+  gateEnd = cpuUs + (uint64_t)msec * 1000;
+  gateOpen = true;
+  countReady = false;
+  // the sensor's phase carries over: light below 1/gate Hz is counted in some gates, not in none
+  pulses -= (uint64_t)pulses;
+  ++nrGates;
+}
+
+uint8_t FreqCountClass::available(void) {
+  if (!countReady && gateOpen) {
+    mock::advance(min(gateEnd - cpuUs, (uint64_t)MOCK_YIELD_US));
+  }
+  return countReady;
+}
+
+uint32_t FreqCountClass::read(void) {
+  countReady = false;
+  return counted;
+}
+
+void FreqCountClass::end(void) {
+  gateOpen = false;
+}
+
+// ---- Wire
+
+void TwoWire::begin() {
+}
+
+void TwoWire::beginTransmission(uint8_t address) {
+  i2cBuf.assign(1, (char)address);
+}
+
+uint8_t TwoWire::endTransmission(void) {
+  mock::advance(i2cBuf.size() * MOCK_I2C_BYTE_US);
+  i2cLastBuf = i2cBuf;
+  ++i2cCount;
+  return 0;
+}
+
+size_t TwoWire::write(uint8_t data) {
+  i2cBuf += (char)data;
+  return 1;
+}
+
+size_t TwoWire::write(const uint8_t* data, size_t quantity) {
+  i2cBuf.append((const char*)data, quantity);
+  return quantity;
+}
@@ -0,0 +1,140 @@
+// mock.h
+//-------
+// control of the simulated Arduino Nano the host build runs the firmware on
+//
+// time is virtual: it only advances in delay(), while waiting for the frequency counter,
+// while sleeping, for EEPROM accesses, I2C transfers and a full serial transmit buffer,
+// and by MOCK_POLL_US for each call of millis(), micros() or Serial.available()
+// the serial line connects the UART to a host end with its own baud rate; input arrives
+// one byte time apart and is lost if the 64 byte receive buffer is full or the UART is
+// stopped (power down)
+// the color sensor outputs the frequencies of the light set by the test for the filter
+// selected by S2/S3, nothing if its power pin is low
+//
+// *** BSD License ***
+// ------------------------------------------------------------------------------------------
+// Copyright (c) 2017, Paul Holleis, Marko Luther
+// All rights reserved.
+//
+// Authors:  Paul Holleis, Marko Luther
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//   Redistributions of source code must retain the above copyright notice, this list of
+//   conditions and the following disclaimer.
+//
+//   Redistributions in binary form must reproduce the above copyright notice, this list
+//   of conditions and the following disclaimer in the documentation and/or other materials
+//   provided with the distribution.
+//
+//   Neither the name of the copyright holder(s) nor the names of its contributors may be
+//   used to endorse or promote products derived from this software without specific prior
+//   written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// ------------------------------------------------------------------------------------------
+
+#ifndef _HOST_MOCK_H
+#define _HOST_MOCK_H
+
+#include <Arduino.h>
+#include <string>
+#include <vector>
+
+// time taken by a call of millis(), micros() or Serial.available() such that polling loops end
+#define MOCK_POLL_US 1
+// step of the time in delay() and while waiting for the frequency counter, yield() is called in between
+#define MOCK_YIELD_US 20
+// one EEPROM write (3.3ms on the ATmega328P) and read (call, 4 cycles halted)
+#define MOCK_EEPROM_WRITE_US 3300
+#define MOCK_EEPROM_READ_US 1
+// one byte on the I2C bus at 100kHz incl. ack
+#define MOCK_I2C_BYTE_US 90
+// oscillator start up after power down (16K clock cycles)
+#define MOCK_WAKEUP_US 1000
+// tolerance of the baud rate of the UART vs. the host end, in 1/1000
+#define MOCK_BAUD_TOLERANCE 30
+// size of the UART receive and transmit buffers of the Arduino core
+#define MOCK_SERIAL_BUFFER 64
+
+// pins of the color sensor, as wired in sketch.cpp
+#define MOCK_PIN_S2    7
+#define MOCK_PIN_S3    6
+#define MOCK_PIN_LED   3
+#define MOCK_PIN_POWER 2
+
+namespace mock {
+
+  // back to power on: time 0, EEPROM erased, pins, registers, serial line and sensor cleared
+  void reset();
+
+  // ---- time
+  // microseconds since reset; keeps running in power down while millis() is stopped
+  uint64_t now();
+  // lets the given time pass, delivering serial input
+  void advance(uint64_t us);
+
+  // ---- serial line, host end
+  // baud rate of the host end (default 115200); bytes are garbled if it does not match the UART
+  void setHostBaud(uint32_t baud);
+  // actual baud rate of the UART from its registers and the CPU clock, 0 if not started
+  uint32_t deviceBaud();
+  // puts the bytes on the line, the first one arrives one byte time after the previous ones
+  void send(const char* s);
+  void send(const uint8_t* data, size_t len);
+  // the same, but the first byte arrives one byte time after at (or after the previous ones if later)
+  void sendAt(uint64_t at, const char* s);
+  void sendAt(uint64_t at, const uint8_t* data, size_t len);
+  // bytes still on the way to the UART
+  size_t sending();
+  // everything the firmware sent since the last take
+  std::string received();
+  // at gets the time each byte was completely received by the host, if not NULL
+  std::string takeReceived(std::vector<uint64_t>* at = NULL);
+  // bytes sent by the host but lost by the UART (receive buffer full, power down)
+  uint32_t rxLost();
+
+  // ---- color sensor
+  // frequencies (Hz) of the sensor output with the white (clear), red, green and blue filter
+  struct Light {
+    uint32_t hz[4];
+  };
+  // light reaching the sensor with LEDs off (ambient) and added by the LEDs (reflected by the can)
+  void setLight(const Light& ambient, const Light& led);
+  // time dependent light, e.g. a can being put down; replaces setLight() until set to NULL
+  typedef void (*LightFunction)(uint64_t us, bool ledOn, Light* light);
+  void setLightFunction(LightFunction f);
+  // number of frequency counter gates
+  uint32_t gates();
+
+  // ---- EEPROM
+  uint8_t* eeprom();
+  uint32_t eepromReads();
+  uint32_t eepromWrites();
+
+  // ---- I2C
+  uint32_t i2cTransmissions();
+  // bytes of the last transmission
+  std::string i2cLast();
+
+  // ---- pins and power
+  uint8_t pin(uint8_t p);
+  // time the CPU spent sleeping in idle and power down mode
+  uint64_t idleTime();
+  uint64_t powerDownTime();
+  // time the modules of the PRR register (PRADC, PRSPI...) were clocked
+  uint64_t clockedTime(uint8_t prrBit);
+  // time the ADC was enabled (ADEN) and clocked, drawing its full current
+  uint64_t adcOnTime();
+}
+
+#endif
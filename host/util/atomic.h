@@ -0,0 +1,12 @@
+// util/atomic.h
+//--------------
+// the host runs the interrupt handlers synchronously, so every block is atomic
+
+#ifndef _HOST_UTIL_ATOMIC_H
+#define _HOST_UTIL_ATOMIC_H
+
+#define ATOMIC_RESTORESTATE
+#define ATOMIC_FORCEON
+#define ATOMIC_BLOCK(type) for (uint8_t _atomic_once = 1; _atomic_once; _atomic_once = 0)
+
+#endif
@@ -54,6 +54,11 @@
 #include <tonino_tcs3200.h>
 #include <tonino_serial.h>
 #include <tonino_config.h>
+#include <tonino_log.h>
+#include <tonino_scheduler.h>
+#include <tonino_clock.h>
+#include <tonino_power.h>
+#include <tonino_calibration.h>
 
 // lib that calls method according to serial input
 // slightly adapted from
@@ -69,8 +74,8 @@
 
 // low power library, built-in, see http://playground.arduino.cc/Learning/arduinoSleepCode
 #include <avr/power.h>  
-// low power library, https://github.com/rocketscream/Low-Power, Version 1.30
-#include <LowPower.h>
+#include <avr/sleep.h>
+#include <avr/wdt.h>
 
 // LCD object
 LCD display = LCD();
@@ -84,27 +89,131 @@ TCS3200 colorSense = TCS3200(CS_S2, CS_S3, CS_LED, CS_POWER, &display);
 
 // object for all parameters
 ToninoConfig tConfig = ToninoConfig(&colorSense, &display);
+// scan history stored in EEPROM
+ToninoLog scanLog = ToninoLog();
+// times till dimming, sleep and power down
+ToninoPower power = ToninoPower(&tConfig);
+// calibration with the calibration plates
+ToninoCalibration calibration = ToninoCalibration(&colorSense, &display, &tConfig);
 // object for serial communication
-ToninoSerial tSerial = ToninoSerial(&colorSense, &display, &tConfig, VERSION);
+ToninoSerial tSerial = ToninoSerial(&colorSense, &display, &tConfig, VERSION, &scanLog, &power, &calibration);
 
 // stores original display brightness if it has been reduced in power save mode
 int8_t origBrightness = -1;
 
+// store when last action was detected (for low power idle mode)
+uint32_t lastTimestamp = 0;
+// last calibrated r/b result, used for averaging
+float lastRaw = 0.0;
+
+// state of the can, see liftTask()
+#define CAN_DOWN     0 // waiting for the can to be lifted
+#define CAN_UP       1 // waiting for the can to be put down again
+#define CAN_SETTLING 2 // can put down, waiting for it to settle (see scanTask())
+#define CAN_SCANNING 3 // can settled, animation and scan (see scanTask())
+uint8_t canState = CAN_DOWN;
+
+// next step of scanTask(): frames of the animation, clearing the display, scanning
+uint8_t scanStep = 0;
+#define SCAN_ANIM_FRAMES (2*CIRCLE_FRAMES)
+
+// throughput mode: max. interval of the lift checks
+#define THROUGHPUT_LIFT_INTERVAL 200
+// interval of the power management task
+#define POWER_INTERVAL 100
+// interval of the serial task if no input arrives, for the timeouts of SETBAUD and binary mode
+#define SERIAL_INTERVAL 100
+
+// tasks of the main loop, all of them must return within a few milliseconds (scans excepted)
+void serialTask();
+void liftTask();
+void scanTask();
+void powerTask();
+void calibrationTask();
+#define TASK_SERIAL    0
+#define TASK_LIFT      1
+#define TASK_SCAN      2
+#define TASK_POWER     3
+#define TASK_CALIBRATE 4
+#define NR_TASKS       5
+ToninoTask tasks[NR_TASKS] = {
+  { serialTask,      0, true },
+  { liftTask,        0, true },
+  { scanTask,        0, false },
+  { powerTask,       0, true },
+  { calibrationTask, 0, false }
+};
+ToninoScheduler scheduler = ToninoScheduler(tasks, NR_TASKS);
+
 
 boolean checkCommands() {
   return tSerial.checkCommands();
 }
 
+// called by delay() and while waiting for the sensor; buffers serial input
+// such that commands sent during a scan are not lost
+void yield() {
+  tSerial.receive();
+}
+
+
+// set by the pin change interrupt of the serial RX pin during power down
+volatile boolean rxWake = false;
+
+ISR(PCINT2_vect) {
+  rxWake = true;
+}
+
+// period of powerDown() without watchdog, only serial input wakes up
+#define POWER_DOWN_FOREVER -1
+
+// the watchdog only wakes up from power down, see powerDown()
+ISR(WDT_vect) {
+  wdt_disable();
+}
+
+// power down for the given watchdog period (WDTO_xxx), until serial input if POWER_DOWN_FOREVER;
+// a pin change on the serial RX pin (D0) wakes up immediately as the UART itself is stopped
+// the ADC stays off (see setup()), brown-out detection is off while sleeping
+inline void powerDown(int8_t period) {
+  rxWake = false;
+  PCIFR = bit(PCIF2);       // clear a pending pin change
+  PCMSK2 |= bit(PCINT16);   // D0 / RXD
+  PCICR |= bit(PCIE2);
+  if (period != POWER_DOWN_FOREVER) {
+    wdt_enable(period);
+    WDTCSR |= bit(WDIE);    // interrupt instead of reset
+  }
+  set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+  cli();
+  sleep_enable();
+  // timed sequence: sleep_cpu() must follow within 3 cycles, sei() delays interrupts by one instruction
+  sleep_bod_disable();
+  sei();
+  sleep_cpu();
+  sleep_disable();
+  PCICR &= ~bit(PCIE2);
+  PCMSK2 &= ~bit(PCINT16);
+}
 
 // low power mode; checks every few seconds for an event
 inline uint32_t checkLowPowerMode(bool isLight, uint32_t lastTimestamp) {
-  if (millis() - lastTimestamp > TIME_TILL_SLEEP) {
+  uint32_t sleepTime = power.sleepTime();
+  if (millis() - lastTimestamp > sleepTime) {
     display.clear();
+    power.slept();
+    tSerial.pushPower(POWER_STATE_SLEEP);
   
-    int16_t loopsTillPowerDown = (TIME_TILL_POWERDOWN - TIME_TILL_SLEEP) / 4000 + 1;
+    int16_t loopsTillPowerDown = (power.powerDownTime() - sleepTime) / 4000 + 1;
   
     while (true) {
-      LowPower.powerDown(SLEEP_4S, ADC_OFF, BOD_OFF);  
+      powerDown(WDTO_4S);
+      if (rxWake) {
+        // the time slept is unknown as millis() is stopped, not counted
+        tSerial.resync();
+        break;
+      }
+      energyAdd(ENERGY_SLEEP, 4000000);
   
       // do we receive serial input during powerDown?
       if (Serial.available() > 0 || 
@@ -116,18 +225,26 @@ inline uint32_t checkLowPowerMode(bool isLight, uint32_t lastTimestamp) {
 
       if (--loopsTillPowerDown <= 0) {
         WRITEDEBUGLN("power down");
+        power.poweredDown();
+        tSerial.pushPower(POWER_STATE_OFF);
         delay(500);
-        LowPower.powerDown(SLEEP_FOREVER, ADC_OFF, BOD_OFF);
+        powerDown(POWER_DOWN_FOREVER);
+        if (rxWake) {
+          tSerial.resync();
+          break;
+        }
       }
     }
     display.line();
     return millis();
 
-  } else if (millis() - lastTimestamp > TIME_TILL_DIM) {
+  } else if (millis() - lastTimestamp > power.dimTime()) {
     if (origBrightness < 0) {
       // temporarily set low brightness
       origBrightness = tConfig.getBrightness();
       display.setBrightness(1);
+      power.dimmed();
+      tSerial.pushPower(POWER_STATE_DIM);
     }
     return lastTimestamp;
     
@@ -135,100 +252,14 @@ inline uint32_t checkLowPowerMode(bool isLight, uint32_t lastTimestamp) {
     // restore original brightness
     display.setBrightness(origBrightness);
     origBrightness = -1;
+    tSerial.pushPower(POWER_STATE_ACTIVE);
   }
   return lastTimestamp;
 }
 
-// called when detected first calibration plate with quick scan
-boolean calibrate() {
-  sensorData sd;
-  
-  display.calibration1();
-  WRITEDEBUGLN("Cal.");
-  delay(500);
-  
-  // scan plate 1
-  colorSense.scan(NULL, false, &sd);
-  if (checkCommands()) return false;
-  display.calibration1();
-  delay(500);
-  if (checkCommands()) return false;
-
-  float redavg = sd.value[RED_IDX];
-  float blueavg = sd.value[BLUE_IDX];
-  
-  if ((abs(redavg - LOW_RED) < RED_RANGE_LOW) && (abs(blueavg - LOW_BLUE) < BLUE_RANGE_LOW)) {
-
-    float rb_low = redavg / blueavg;
-
-    WRITEDEBUG(redavg);
-    WRITEDEBUG("/");
-    WRITEDEBUG(blueavg);
-    WRITEDEBUG("=");
-    WRITEDEBUGF(rb_low, 5);
-    WRITEDEBUG("; ");
-
-    // wait for other plate
-    uint16_t delayTillUpTest = tConfig.getDelayTillUpTest() * 100;
-    while (true) {
-      display.calibration2();
-
-      // wait till can is lifted and put down again
-      while (colorSense.isDark()) {
-        delay(delayTillUpTest);
-        if (checkCommands()) return false;
-      }
-      display.up();
-      while (colorSense.isLight()) {
-        delay(delayTillUpTest);
-        if (checkCommands()) return false;
-      }
-      display.calibration2();
-      delay(500);
-
-      // scan plate 2
-      colorSense.scan(NULL, false, &sd);
-      if (checkCommands()) return false;
-      display.calibration2();
-      delay(500);
-      if (checkCommands()) return false;
-
-      redavg = sd.value[RED_IDX];
-      blueavg = sd.value[BLUE_IDX];
-      float rb_high = redavg / blueavg;
-
-      float cal[2];
-      cal[0] = (HIGH_TARGET - LOW_TARGET) / (rb_high - rb_low);
-      cal[1] = LOW_TARGET - cal[0]*rb_low;
-
-      WRITEDEBUG(redavg);
-      WRITEDEBUG("/");
-      WRITEDEBUG(blueavg);
-      WRITEDEBUG("=");
-      WRITEDEBUGF(rb_high, 5);
-      
-      WRITEDEBUG("=>");
-      WRITEDEBUGF(cal[0], 5);
-      WRITEDEBUG(",");
-      WRITEDEBUGLNF(cal[1], 5);
-
-      if (checkCommands()) return false;
-
-      tConfig.setCalibration(cal);
-      delay(10);
-      return true;
-    }
-
-  } else {
-    // could not detect first plate even though quick check thought so - error and continue
-    display.error();
-    delay(3000);
-    return false;
-  }
-}
-
 // show the given number on the display if possible
-inline void displayNum(int32_t tval) {
+// if anim is false the number is shown without the snake animation
+inline void displayNum(int32_t tval, boolean anim = true) {
   if (tval < 0) {
     if (tval < -999) {
       display.line();
@@ -237,30 +268,47 @@ inline void displayNum(int32_t tval) {
     }
   } else if (tval > 9999) {
     display.line();
-  } else {
+  } else if (anim) {
     display.snake(tval);
+  } else {
+    display.printNumber(tval);
   }
 }
 
-// make a full scan and display on LCD
-inline void scanAndDisplay(float* lastRaw) {
+// make a full scan and display on LCD (animated if anim is true)
+inline void scanAndDisplay(float* lastRaw, boolean anim = true) {
   boolean averaged = false; // indicates if readings got averaged with the lastRaw (the previous one)
+  sensorData sd;
   
   // make a measurement with stored configuration, parameters:
   // 1: lastRaw: passes lastRaw readings for averaging
   // 2: false: no display animation during scan
-  // 3: NULL: not interested in raw values
+  // 3: sd: raw values for the scan history
   // 4: true: switch on LEDs
   // 5: false: no explicit external light removal
   // 6: averaged: return flag that indicates that result got averaged
-  int32_t tval = colorSense.scan(lastRaw, false, NULL, true, false, &averaged);
+  int32_t tval = colorSense.scan(lastRaw, false, &sd, true, false, &averaged);
  
 
-  displayNum(tval);
+  displayNum(tval, anim);
   display.averaged(averaged); // display the averaged indicator
+
+  // store in scan history only after the display has been updated as this needs some EEPROM writes
+  scanLog.add(tval, &sd, averaged);
+  tSerial.pushScan(tval, &sd, averaged);
+  power.scanned();
+}
+
+// runs the calibration instead of the lift and scan tasks until it is done
+void startCalibration() {
+  scheduler.stop(TASK_LIFT);
+  scheduler.stop(TASK_SCAN);
+  scheduler.after(TASK_CALIBRATE, 0);
 }
 
 void setup() {
+  bootStage(BOOT_START);
+
   // ---- begin general low energy configurations
   // set all (unused) pins to input and pull-down
   for (byte i = 0; i <= A7; i++) {
@@ -272,6 +320,7 @@ void setup() {
   DIDR0 = DIDR0 | B00111111;
 
   // disable unsused components
+  ADCSRA = 0;          // the ADC must be disabled before it is shut down
   power_adc_disable(); // disable unused analog digital converter needed only for analogRead()
   power_spi_disable(); // disable unused Serial Peripheral Interface
   SPCR = 0;
@@ -282,7 +331,8 @@ void setup() {
   digitalWrite(13, HIGH);
 
   // initialize serial communication
-  tSerial.init(115200);
+  tSerial.init(DEFAULT_BAUDRATE);
+  bootStage(BOOT_SERIAL);
 
   // directly check if there is an incoming serial command (connected to computer)
   checkCommands();
@@ -290,91 +340,185 @@ void setup() {
   // LCD init
   display.init(0x70);
   display.clear();
+  bootStage(BOOT_DISPLAY);
 
   // color sensor init
   colorSense.init();
+  bootStage(BOOT_SENSOR);
 
   // read parameters from EEPROM or write defaults if not available
   // be sure to call this _after_ display and colorSense have been initialized (using .init())
   tConfig.init();
+  scanLog.init();
+  // switch to the baud rate stored by SETBAUD, if any
+  tSerial.setSpeed(tConfig.getBaudRate());
+  bootStage(BOOT_CONFIG);
   
-  // show that the display is working
-  display.eightSequence();
+  // show that the display is working; skipped in fast boot mode
+  boolean fastBoot = tConfig.getFastBoot();
+  if (!fastBoot) {
+    display.eightSequence();
+  }
   digitalWrite(13, LOW);
   pinMode (13, INPUT);
+  bootStage(BOOT_READY);
 
   // check whether we are calibrating (detect first calibration plate)
   if (colorSense.isDark()) {
     if (tConfig.getCheckCalInit() && colorSense.isCalibrating() == LOW_PLATE) {
-      display.clear();
-      if (calibrate()) {
-        display.done();
-      }
+      // run by the main loop
+      calibration.start();
+      startCalibration();
     } else {
       // no calibration plate detected, directly make first scan
-      scanAndDisplay(NULL);
+      scanAndDisplay(NULL, !fastBoot);
     }
+    bootStage(BOOT_SCAN);
   } else {
     display.clear();
   }
+
+  // load remaining settings not needed for the first scan (fast boot mode only)
+  tConfig.initDeferred();
+  bootStage(BOOT_DEFERRED);
 }
 
 
-void loop() {
-  // store when last action was detected (for low power idle mode)
-  uint32_t lastTimestamp = 0;
-  float lastRaw = 0.0; // last calibrated r/b result
-  
-  while(true) {
-    // check this setting within the while loop as it could be changed during runtime
-    uint16_t delayTillUpTest = tConfig.getDelayTillUpTest() * 100;
-    
-    // poll if there is an incoming serial command
-    if (checkCommands()) lastTimestamp = millis();
-    
-    // check whether user lifted the can
+// executes serial commands; scheduled by loop() as soon as input arrives
+void serialTask() {
+  if (checkCommands()) lastTimestamp = millis();
+  if (calibration.active() && !scheduler.isScheduled(TASK_CALIBRATE)) {
+    // started by CALIBRATE
+    startCalibration();
+  }
+  scheduler.after(TASK_SERIAL, SERIAL_INTERVAL);
+}
+
+// interval of the lift checks; at most THROUGHPUT_LIFT_INTERVAL in throughput mode
+inline uint16_t liftInterval() {
+  // check this setting every time as it could be changed during runtime
+  uint16_t interval = tConfig.getDelayTillUpTest() * 100;
+  if (tConfig.getThroughputMode() && interval > THROUGHPUT_LIFT_INTERVAL) {
+    return THROUGHPUT_LIFT_INTERVAL;
+  }
+  return interval;
+}
+
+// checks whether the user lifted the can and put it down again, every liftInterval()
+void liftTask() {
+  if (canState == CAN_DOWN) {
     if (colorSense.isLight()) {
       lastTimestamp = millis();
       // display hint that can lifting was detected
       display.up();
+      tSerial.pushLift(true);
       // this call is mainly to reset dipslay brightness etc. to normal
       lastTimestamp = checkLowPowerMode(true, lastTimestamp);
+      canState = CAN_UP;
+    }
+  } else if (colorSense.isDark()) {
+    tSerial.pushLift(false);
+    canState = CAN_SETTLING;
+    // it might already be dark before the can is fully placed on the surface
+    colorSense.startSettle();
+    scheduler.after(TASK_SCAN, SETTLE_PROBE_INTERVAL);
+    // resumed by scanTask()
+    return;
+  }
+  scheduler.after(TASK_LIFT, liftInterval());
+}
+
+// after the can was put down: waits for it to settle, shows the circle animation, clears the display and scans
+// in throughput mode scans as soon as the can settled, without any animation
+void scanTask() {
+  boolean throughput = tConfig.getThroughputMode();
+  if (canState == CAN_SETTLING) {
+    if (!colorSense.settled()) {
+      scheduler.after(TASK_SCAN, SETTLE_PROBE_INTERVAL);
+      return;
+    }
+    canState = CAN_SCANNING;
+    scanStep = (throughput ? SCAN_ANIM_FRAMES+1 : 0);
+  }
+  if (scanStep < SCAN_ANIM_FRAMES) {
+    // two circles in 500ms each
+    display.circleFrame(scanStep++);
+    scheduler.after(TASK_SCAN, 500 / CIRCLE_FRAMES);
+    return;
+  } else if (scanStep == SCAN_ANIM_FRAMES) {
+    display.clear();
+    scanStep++;
+    scheduler.after(TASK_SCAN, 100);
+    return;
+  }
 
-      // wait until user puts the can down again
-      while (!colorSense.isDark()) {
-        // interval for checking - need not be small
-        delay(delayTillUpTest);
-        // poll if there is an incoming serial command
-        if (checkCommands()) lastTimestamp = millis();
+  if ((millis() - lastTimestamp) > AVERAGE_TIME_SPAN) {
+    // AVERAGE_TIME_SPAN milliseconds after the last scan we deactivate the averaging
+    lastRaw = 0.0;
+  }
+  scanAndDisplay(&lastRaw, !throughput);
 
-        lastTimestamp = checkLowPowerMode(true, lastTimestamp);
-      }
-      // short wait because it might already be dark before 
-      // the can is fully placed on the surface
-      delay(1000);
-      display.circle(2, 500);
-      display.clear();
-      delay(100);
-
-      if ((millis() - lastTimestamp) > AVERAGE_TIME_SPAN) {
-        // AVERAGE_TIME_SPAN milliseconds after the last scan we deactivate the averaging
-        lastRaw = 0.0;
-      }
-      scanAndDisplay(&lastRaw);
+  lastTimestamp = millis();
+  // this call is mainly to potentially reset display brightness back to normal
+  lastTimestamp = checkLowPowerMode(false, lastTimestamp);
+  canState = CAN_DOWN;
+  scheduler.after(TASK_LIFT, liftInterval());
+}
 
-      lastTimestamp = millis();
-      // this call is mainly to potentially reset display brightness back to normal
-      lastTimestamp = checkLowPowerMode(false, lastTimestamp);
-    }
-    delay(delayTillUpTest);
-    
-    if ((millis() - lastTimestamp) > AVERAGE_TIME_SPAN) {
-        // AVERAGE_TIME_SPAN milliseconds after the last scan we deactivate the averaging
-        lastRaw = 0.0;
-        display.averaged(false); // clear the averaging indicator
+// steps through the calibration, see ToninoCalibration; resumes the lift task when it is done
+void calibrationTask() {
+  uint16_t wait = calibration.step();
+  if (calibration.active()) {
+    scheduler.after(TASK_CALIBRATE, wait);
+  } else {
+    lastTimestamp = millis();
+    lastRaw = 0.0;
+    canState = CAN_DOWN;
+    scheduler.after(TASK_LIFT, liftInterval());
+  }
+}
+
+// ends averaging and handles the low power modes, every POWER_INTERVAL
+// not while calibrating as that ends by itself after CAL_TIMEOUT
+void powerTask() {
+  if ((canState == CAN_DOWN || canState == CAN_UP) && !scheduler.isScheduled(TASK_CALIBRATE)) {
+    if (canState == CAN_DOWN && lastRaw != 0.0 && (millis() - lastTimestamp) > AVERAGE_TIME_SPAN) {
+      // AVERAGE_TIME_SPAN milliseconds after the last scan we deactivate the averaging
+      lastRaw = 0.0;
+      display.averaged(false); // clear the averaging indicator
     }
-      
-    lastTimestamp = checkLowPowerMode(false, lastTimestamp);
+    lastTimestamp = checkLowPowerMode(canState == CAN_UP, lastTimestamp);
   }
+  scheduler.after(TASK_POWER, POWER_INTERVAL);
 }
 
+// sleeps until the next interrupt; timer 0 (millis()) wakes up every 1ms, serial input at once
+// idle is the deepest sleep mode that keeps both running
+// if the baud rate allows, the clock is slowed down while sleeping; everything else runs at full speed
+// timers 1 and 2 (FreqCount) and the TWI (display) are stopped while sleeping; ADC and SPI stay
+// off as set up by setup()
+inline void idle() {
+  boolean slow = ToninoClock::slow();
+  uint32_t start = micros();
+  power_timer1_disable();
+  power_timer2_disable();
+  power_twi_disable();
+  set_sleep_mode(SLEEP_MODE_IDLE);
+  sleep_enable();
+  sleep_cpu();
+  sleep_disable();
+  power_timer1_enable();
+  power_timer2_enable();
+  power_twi_enable();
+  ToninoClock::full();
+  energyAdd(slow ? ENERGY_IDLE_SLOW : ENERGY_IDLE, micros() - start);
+}
+
+void loop() {
+  scheduler.run();
+  if (tSerial.pending()) {
+    scheduler.after(TASK_SERIAL, 0);
+  } else if (scheduler.idleTime() > 0) {
+    idle();
+  }
+}
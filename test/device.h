@@ -0,0 +1,128 @@
+// device.h
+//---------
+// helpers for the tests that run the whole sketch on the simulated device
+
+#ifndef _DEVICE_H
+#define _DEVICE_H
+
+#include "test.h"
+
+#include <EEPROM.h>
+#include <functional>
+#include <sys/wait.h>
+#include <unistd.h>
+
+void setup();
+void loop();
+
+// light reaching the sensor (Hz with white, red, green, blue filter): nothing (can down, LEDs off),
+// a lit room (can lifted) and what the LEDs add for coffee and the two calibration plates
+const mock::Light DARK = { { 0, 0, 0, 0 } };
+const mock::Light ROOM = { { 2000, 700, 650, 600 } };
+const mock::Light COFFEE = { { 12000, 6000, 3500, 3000 } };
+const mock::Light LOW_PLATE_LIGHT = { { 6000, 2600, 1700, 1600 } };
+const mock::Light HIGH_PLATE_LIGHT = { { 25000, 15000, 4000, 3600 } };
+
+// runs the main loop for the given time
+inline void runFor(uint64_t us) {
+  uint64_t end = mock::now() + us;
+  while (mock::now() < end) {
+    loop();
+  }
+}
+
+// true if line is the reply to the command name, with or without request ID and values
+inline bool isReply(const std::string& line, const std::string& name) {
+  if (line.compare(0, name.size(), name) != 0) {
+    return false;
+  }
+  return line.size() == name.size() || line[name.size()] == ':' || line[name.size()] == ' ' ||
+         line[name.size()] == '#';
+}
+
+// runs the main loop until the host received the reply to the command name or the timeout elapsed;
+// returns that line without the \n, and everything received before in *before, "" on timeout
+inline std::string awaitLine(const std::string& name, uint64_t timeout = 3000000, std::string* before = NULL) {
+  uint64_t end = mock::now() + timeout;
+  std::string got;
+  while (mock::now() < end) {
+    loop();
+    got += mock::takeReceived();
+    size_t start = 0;
+    size_t nl;
+    while ((nl = got.find('\n', start)) != std::string::npos) {
+      std::string line = got.substr(start, nl - start);
+      if (isReply(line, name)) {
+        if (before != NULL) {
+          *before = got.substr(0, start);
+        }
+        return line;
+      }
+      start = nl + 1;
+    }
+  }
+  return "";
+}
+
+// sends the command and returns its reply
+inline std::string command(const std::string& cmd, uint64_t timeout = 3000000) {
+  mock::send((cmd + "\n").c_str());
+  return awaitLine(cmd.substr(0, cmd.find_first_of(" #")), timeout);
+}
+
+// power on with an erased EEPROM and the can down; setup() ends with the first boot done
+inline void powerOn(const mock::Light& ambient = DARK, const mock::Light& led = COFFEE) {
+  mock::reset();
+  mock::setLight(ambient, led);
+  setup();
+}
+
+// power on with the given EEPROM content, e.g. from a previous run(), instead of an erased one
+inline void powerOn(const std::string& eeprom, const mock::Light& ambient = DARK, const mock::Light& led = COFFEE) {
+  mock::reset();
+  memcpy(mock::eeprom(), eeprom.data(), min(eeprom.size(), (size_t)(E2END + 1)));
+  mock::setLight(ambient, led);
+  setup();
+}
+
+// the EEPROM content, to be passed to a later powerOn()
+inline std::string eepromImage() {
+  return std::string((const char*)mock::eeprom(), E2END + 1);
+}
+
+// runs f in a child process and returns its result; as the sketch's globals are not reset by
+// powerOn(), each test runs in a process of its own (see test.cpp), and a test that boots the
+// device several times with the globals as constructed must isolate each boot like this
+inline std::string isolated(std::function<std::string()> f) {
+  int fds[2];
+  if (pipe(fds) != 0) {
+    return "";
+  }
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid == 0) {
+    close(fds[0]);
+    int before = testFailures();
+    std::string result = f();
+    ssize_t n = write(fds[1], result.data(), result.size());
+    close(fds[1]);
+    fflush(stdout);
+    _exit(n == (ssize_t)result.size() && testFailures() == before ? 0 : 1);
+  }
+  close(fds[1]);
+  std::string result;
+  char buf[256];
+  ssize_t n;
+  while ((n = read(fds[0], buf, sizeof(buf))) > 0) {
+    result.append(buf, n);
+  }
+  close(fds[0]);
+  int status = 0;
+  waitpid(pid, &status, 0);
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    testFailed(__FILE__, __LINE__, "isolated run failed");
+  }
+  return result;
+}
+
+#endif
@@ -0,0 +1,60 @@
+// frames.h
+//---------
+// frames of the binary mode (see Tonino-Serial.md) as a host builds and reads them
+
+#ifndef _FRAMES_H
+#define _FRAMES_H
+
+#include <tonino_config.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// COBS encoded frame of data, terminated by 0
+inline std::string cobsEncode(const std::vector<uint8_t>& data) {
+  std::string out;
+  size_t start = 0;
+  for (;;) {
+    size_t end = start;
+    while (end < data.size() && data[end] != 0 && end - start < 254) {
+      ++end;
+    }
+    out += (char)(end - start + 1);
+    out.append((const char*)&data[start], end - start);
+    if (end == data.size()) {
+      break;
+    }
+    start = (end - start == 254 ? end : end + 1);
+  }
+  out += '\0';
+  return out;
+}
+
+// data of a COBS encoded frame without its terminating 0
+inline std::vector<uint8_t> cobsDecode(const std::string& frame) {
+  std::vector<uint8_t> out;
+  size_t i = 0;
+  while (i < frame.size()) {
+    uint8_t code = frame[i++];
+    for (uint8_t k = 1; k < code && i < frame.size(); ++k) {
+      out.push_back(frame[i++]);
+    }
+    if (code < 0xFF && i < frame.size()) {
+      out.push_back(0);
+    }
+  }
+  return out;
+}
+
+// request frame of the binary mode: cmd, payload and CRC, the CRC corrupted if corrupt is true
+inline std::string requestFrame(uint8_t cmd, const std::vector<uint8_t>& payload, bool corrupt) {
+  std::vector<uint8_t> f;
+  f.push_back(cmd);
+  f.insert(f.end(), payload.begin(), payload.end());
+  uint16_t c = ToninoConfig::crc(f.data(), f.size()) ^ (corrupt ? 0x0100 : 0);
+  f.push_back(c & 0xFF);
+  f.push_back(c >> 8);
+  return cobsEncode(f);
+}
+
+#endif
@@ -0,0 +1,69 @@
+// settle_traces.h
+//----------------
+// put-down traces for the settle detection (see SETTLE_xxx in tonino_tcs3200.h): the light leaking
+// under the can from the moment the white channel fell below LIGHT_MIN until the can sits flat
+//
+// no hardware recordings exist; these are models of the put-downs seen on the bench, each a list
+// of segments of constant or alternating leak. After the last segment (the seated time) no light
+// reaches the sensor besides what the LEDs reflect.
+
+#ifndef _SETTLE_TRACES_H
+#define _SETTLE_TRACES_H
+
+#include <stdint.h>
+
+// light leaking under the can until untilMs: hz, alternating with altHz every halfPeriodMs if not 0
+struct SettleSegment {
+  uint16_t untilMs;
+  uint16_t hz;
+  uint16_t altHz;
+  uint16_t halfPeriodMs;
+};
+
+struct SettleTrace {
+  const char* name;
+  uint8_t n;
+  SettleSegment segments[4];
+};
+
+static const SettleTrace settleTraces[] = {
+  // placed straight down, dark at once
+  { "clean", 0, { } },
+  // lowered slowly: a narrowing gap for the last few millimeters
+  { "lowered", 2, { { 40, 120, 0, 0 }, { 90, 60, 0, 0 } } },
+  // dark first, then a short leak as the hand lets go
+  { "released", 2, { { 30, 0, 0, 0 }, { 70, 90, 0, 0 } } },
+  // slid into place on the surface: a faint leak along one edge
+  { "slid", 2, { { 150, 80, 0, 0 }, { 300, 40, 0, 0 } } },
+  // tipped on its edge and rocking until it rests
+  { "wobble", 1, { { 400, 110, 30, 30 } } },
+  // slow rocking with a faint leak
+  { "rocking", 1, { { 600, 60, 20, 100 } } },
+  // shadow of the hand moving over the gap
+  { "flicker", 3, { { 50, 150, 20, 10 }, { 100, 90, 0, 15 }, { 150, 40, 0, 25 } } },
+  // pressed down: only the shortest flash of light
+  { "pressed", 1, { { 15, 100, 0, 0 } } },
+};
+
+#define NR_SETTLE_TRACES (sizeof(settleTraces) / sizeof(settleTraces[0]))
+
+// leak (Hz of the white channel) of trace t at ms after the start of the trace
+inline uint32_t settleLeak(const SettleTrace& t, uint32_t ms) {
+  for (uint8_t i = 0; i < t.n; ++i) {
+    const SettleSegment& s = t.segments[i];
+    if (ms < s.untilMs) {
+      if (s.halfPeriodMs != 0 && (ms / s.halfPeriodMs) % 2 == 1) {
+        return s.altHz;
+      }
+      return s.hz;
+    }
+  }
+  return 0;
+}
+
+// time after which the can sits flat
+inline uint32_t settleSeated(const SettleTrace& t) {
+  return t.n == 0 ? 0 : t.segments[t.n - 1].untilMs;
+}
+
+#endif
@@ -0,0 +1,114 @@
+// test.cpp
+//---------
+// minimal test runner of the host build, see test.h
+
+#include "test.h"
+
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+  struct Test {
+    const char* name;
+    TestFunction f;
+  };
+
+  std::vector<Test>& tests() {
+    static std::vector<Test> all;
+    return all;
+  }
+
+  int failures = 0;
+}
+
+TestRegistration::TestRegistration(const char* name, TestFunction f) {
+  Test t = { name, f };
+  tests().push_back(t);
+}
+
+void testFailed(const char* file, int line, const std::string& what) {
+  ++failures;
+  printf("%s:%d: FAILED: %s\n", file, line, what.c_str());
+}
+
+int testFailures() {
+  return failures;
+}
+
+std::string testString(const std::string& s) {
+  std::string out = "\"";
+  for (size_t i = 0; i < s.size(); ++i) {
+    unsigned char c = s[i];
+    if (c == '\n') {
+      out += "\\n";
+    } else if (c < 0x20 || c >= 0x7f) {
+      char hex[8];
+      snprintf(hex, sizeof(hex), "\\x%02x", c);
+      out += hex;
+    } else {
+      out += (char)c;
+    }
+  }
+  return out + "\"";
+}
+
+std::string testString(const char* s) {
+  return s == NULL ? "NULL" : testString(std::string(s));
+}
+
+std::string testString(double v) {
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%.9g", v);
+  return buf;
+}
+
+std::string testString(long long v) {
+  return std::to_string(v);
+}
+
+std::string testString(unsigned long long v) {
+  return std::to_string(v);
+}
+
+int main(int argc, char** argv) {
+  int failed = 0;
+  int run = 0;
+  for (size_t i = 0; i < tests().size(); ++i) {
+    const Test& t = tests()[i];
+    bool selected = (argc < 2);
+    for (int a = 1; a < argc; ++a) {
+      selected = selected || (strcmp(argv[a], t.name) == 0);
+    }
+    if (!selected) {
+      continue;
+    }
+    printf("[ RUN  ] %s\n", t.name);
+    fflush(stdout);
+    failures = 0;
+    // each test in a process of its own such that it starts with the globals as constructed
+    pid_t pid = fork();
+    if (pid == 0) {
+      t.f();
+      fflush(stdout);
+      _exit(failures > 0 ? 1 : 0);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      failures = 1;
+      if (!WIFEXITED(status)) {
+        printf("crashed\n");
+      }
+    }
+    ++run;
+    if (failures > 0) {
+      ++failed;
+      printf("[ FAIL ] %s\n", t.name);
+    } else {
+      printf("[  OK  ] %s\n", t.name);
+    }
+  }
+  printf("%d of %d tests passed\n", run - failed, run);
+  return (failed > 0 || run == 0) ? 1 : 0;
+}
@@ -0,0 +1,66 @@
+// test.h
+//-------
+// minimal test runner of the host build
+// each test file is an executable of its own; TEST() registers a test, CHECK...() report failures
+// and continue, REQUIRE() ends the test; the executable runs all tests or those named as arguments,
+// each one in a child process
+
+#ifndef _TEST_H
+#define _TEST_H
+
+#include <mock.h>
+#include <stdio.h>
+#include <math.h>
+#include <string>
+
+typedef void (*TestFunction)();
+
+struct TestRegistration {
+  TestRegistration(const char* name, TestFunction f);
+};
+
+void testFailed(const char* file, int line, const std::string& what);
+
+// number of failures so far in the current test
+int testFailures();
+
+#define TEST(name) \
+  static void name(); \
+  static TestRegistration name##_registration(#name, name); \
+  static void name()
+
+#define CHECK(cond) \
+  do { if (!(cond)) testFailed(__FILE__, __LINE__, #cond); } while (0)
+
+#define CHECK_EQ(a, b) \
+  do { \
+    if (!((a) == (b))) testFailed(__FILE__, __LINE__, std::string(#a " == " #b " (") + \
+                                  testString(a) + " vs. " + testString(b) + ")"); \
+  } while (0)
+
+#define CHECK_NEAR(a, b, eps) \
+  do { \
+    if (!(fabs((double)(a) - (double)(b)) <= (eps))) testFailed(__FILE__, __LINE__, \
+        std::string(#a " ~ " #b " (") + testString((double)(a)) + " vs. " + testString((double)(b)) + ")"); \
+  } while (0)
+
+#define REQUIRE(cond) \
+  do { if (!(cond)) { testFailed(__FILE__, __LINE__, #cond); return; } } while (0)
+
+std::string testString(const std::string& s);
+std::string testString(const char* s);
+std::string testString(double v);
+std::string testString(long long v);
+std::string testString(unsigned long long v);
+inline std::string testString(int v) { return testString((long long)v); }
+inline std::string testString(long v) { return testString((long long)v); }
+inline std::string testString(unsigned int v) { return testString((unsigned long long)v); }
+inline std::string testString(unsigned long v) { return testString((unsigned long long)v); }
+inline std::string testString(unsigned char v) { return testString((unsigned long long)v); }
+inline std::string testString(signed char v) { return testString((long long)v); }
+inline std::string testString(unsigned short v) { return testString((unsigned long long)v); }
+inline std::string testString(short v) { return testString((long long)v); }
+inline std::string testString(bool v) { return v ? "true" : "false"; }
+inline std::string testString(float v) { return testString((double)v); }
+
+#endif
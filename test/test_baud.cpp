@@ -0,0 +1,118 @@
+// test_baud.cpp
+//--------------
+// SETBAUD handshake over the simulated serial line: the host end follows the switch or not
+
+#include "device.h"
+
+#include <tonino_config.h>
+#include <tonino_serial.h>
+
+// true if the UART runs at baud within the tolerance of the line
+static bool deviceAt(uint32_t baud) {
+  uint32_t device = mock::deviceBaud();
+  uint32_t diff = (device > baud ? device - baud : baud - device);
+  return (uint64_t)diff * 1000 <= (uint64_t)baud * MOCK_BAUD_TOLERANCE;
+}
+
+// switches to baud as a host would: request, follow, confirm
+static bool switchTo(uint32_t baud, bool persist = false) {
+  std::string request = "SETBAUD " + std::to_string(baud);
+  if (command(request + (persist ? " 1" : "")) != "SETBAUD") {
+    return false;
+  }
+  mock::setHostBaud(baud);
+  return command(request) == "SETBAUD:" + std::to_string(baud);
+}
+
+TEST(switches_to_every_rate) {
+  static const uint32_t rates[] = { 9600, 19200, 38400, 57600, 250000, 500000, 1000000 };
+  powerOn();
+  for (size_t i = 0; i < sizeof(rates) / sizeof(rates[0]); ++i) {
+    if (!switchTo(rates[i])) {
+      CHECK_EQ(rates[i], 0u);
+      return;
+    }
+    printf("%7u baud: UART at %u\n", rates[i], mock::deviceBaud());
+    CHECK(deviceAt(rates[i]));
+    // stays after the timeout
+    runFor((BAUD_TIMEOUT + 500) * 1000ULL);
+    CHECK_EQ(command("TONINO"), std::string("TONINO:1 1 7"));
+    REQUIRE(switchTo(115200));
+  }
+  CHECK_EQ(mock::rxLost(), 0u);
+}
+
+TEST(reverts_without_confirmation) {
+  powerOn();
+  REQUIRE(command("SETBAUD 57600") == "SETBAUD");
+  CHECK(deviceAt(57600));
+  // the host stays at 115200: its requests arrive garbled and the device returns after the timeout
+  mock::send("TONINO\n");
+  runFor((BAUD_TIMEOUT + 500) * 1000ULL);
+  CHECK(deviceAt(115200));
+  mock::takeReceived();
+  CHECK_EQ(command("TONINO"), std::string("TONINO:1 1 7"));
+  // not stored
+  CHECK_EQ(mock::eeprom()[EEPROM_BAUDRATE_ADDRESS], ToninoConfig::baudRateIndex(115200));
+}
+
+TEST(confirmation_at_the_old_rate_is_not_accepted) {
+  powerOn();
+  REQUIRE(command("SETBAUD 38400") == "SETBAUD");
+  // the host did not follow; its repetition is garbled at the new rate
+  CHECK_EQ(command("SETBAUD 38400", 500000), std::string(""));
+  runFor((BAUD_TIMEOUT + 500) * 1000ULL);
+  CHECK(deviceAt(115200));
+  mock::takeReceived();
+  CHECK_EQ(command("TONINO"), std::string("TONINO:1 1 7"));
+}
+
+TEST(rejects_unsupported_rates) {
+  powerOn();
+  CHECK_EQ(command("SETBAUD 12345"), std::string("SETBAUD ERROR"));
+  // 222222 baud at 16MHz
+  CHECK_EQ(command("SETBAUD 230400"), std::string("SETBAUD ERROR"));
+  CHECK_EQ(command("SETBAUD 57600 2"), std::string("SETBAUD ERROR"));
+  CHECK_EQ(command("SETBAUD"), std::string("SETBAUD ERROR"));
+  CHECK(deviceAt(115200));
+}
+
+TEST(persists_only_if_requested) {
+  std::string persisted = isolated([]() {
+    powerOn();
+    CHECK(switchTo(38400, true));
+    return eepromImage();
+  });
+  std::string transient = isolated([]() {
+    powerOn();
+    CHECK(switchTo(38400));
+    return eepromImage();
+  });
+  REQUIRE(persisted.size() > EEPROM_BAUDRATE_ADDRESS && transient.size() > EEPROM_BAUDRATE_ADDRESS);
+
+  std::string reply = isolated([&]() {
+    powerOn(persisted);
+    mock::setHostBaud(38400);
+    return command("TONINO");
+  });
+  CHECK_EQ(reply, std::string("TONINO:1 1 7"));
+  reply = isolated([&]() {
+    powerOn(transient);
+    return command("TONINO");
+  });
+  CHECK_EQ(reply, std::string("TONINO:1 1 7"));
+}
+
+TEST(stored_230400_falls_back_to_default) {
+  std::string image = isolated([]() {
+    powerOn();
+    return eepromImage();
+  });
+  // index of 230400 as stored by earlier firmware, in all redundant copies
+  for (uint8_t c = 0; c <= EEPROM_REDUNDANT_CYCLES; ++c) {
+    image[EEPROM_BAUDRATE_ADDRESS + c * EEPROM_EXT_SIZE] = 5;
+  }
+  powerOn(image);
+  CHECK(deviceAt(115200));
+  CHECK_EQ(command("TONINO"), std::string("TONINO:1 1 7"));
+}
@@ -0,0 +1,65 @@
+// test_boot.cpp
+//--------------
+// boot timeline (GETBOOT) with and without fast boot
+
+#include "device.h"
+
+#include <tonino.h>
+#include <vector>
+
+// values of a GETBOOT reply
+static std::vector<uint32_t> timeline(const std::string& reply) {
+  std::vector<uint32_t> t;
+  const char* p = strchr(reply.c_str(), ':');
+  while (p != NULL && *p != '\0') {
+    char* end;
+    t.push_back(strtoul(p + 1, &end, 10));
+    p = (end == p + 1 ? NULL : end);
+  }
+  return t;
+}
+
+TEST(getboot_format) {
+  powerOn();
+  std::string r = command("GETBOOT");
+  CHECK_EQ(r.compare(0, 8, "GETBOOT:"), 0);
+  CHECK(r[r.size() - 1] != ' ');
+  std::vector<uint32_t> t = timeline(r);
+  REQUIRE(t.size() == NR_BOOT_STAGES);
+  for (uint8_t i = 1; i < NR_BOOT_STAGES; ++i) {
+    CHECK(t[i] >= t[i - 1]);
+  }
+}
+
+TEST(fast_boot_saves_time) {
+  std::string normalImage = isolated([]() {
+    powerOn();
+    return eepromImage();
+  });
+  std::string fastImage = isolated([]() {
+    powerOn();
+    command("SETFASTBOOT 1");
+    return eepromImage();
+  });
+  // second boot of each, with the configuration in EEPROM
+  std::vector<uint32_t> normal = timeline(isolated([&]() {
+    powerOn(normalImage);
+    return command("GETBOOT");
+  }));
+  std::vector<uint32_t> fast = timeline(isolated([&]() {
+    powerOn(fastImage);
+    return command("GETBOOT");
+  }));
+  REQUIRE(normal.size() == NR_BOOT_STAGES && fast.size() == NR_BOOT_STAGES);
+
+  uint32_t normalConfig = normal[BOOT_CONFIG] - normal[BOOT_SENSOR];
+  uint32_t fastConfig = fast[BOOT_CONFIG] - fast[BOOT_SENSOR];
+  printf("config loaded in %u us, fast boot %u us (rest after the first scan: %u us)\n",
+         normalConfig, fastConfig, fast[BOOT_DEFERRED] - fast[BOOT_SCAN]);
+  printf("first scan done after %u ms, fast boot %u ms\n", normal[BOOT_SCAN] / 1000, fast[BOOT_SCAN] / 1000);
+  // the other three profiles are read after the first scan
+  CHECK(fastConfig < normalConfig);
+  CHECK(normal[BOOT_DEFERRED] - normal[BOOT_SCAN] < fast[BOOT_DEFERRED] - fast[BOOT_SCAN]);
+  // no display test (4x 250ms) and no snake animation
+  CHECK(fast[BOOT_SCAN] + 1000000 < normal[BOOT_SCAN]);
+}
@@ -0,0 +1,55 @@
+// test_calibration.cpp
+//---------------------
+// calibration with the two calibration plates, driven by the can as on the device
+
+#include "device.h"
+
+#include <tonino_calibration.h>
+
+// runs the main loop until the !CAL event of the given state; returns the time of the event on
+// the device, or 0 on timeout
+static uint32_t awaitCal(uint8_t state, uint64_t timeout = 20000000) {
+  uint64_t end = mock::now() + timeout;
+  while (mock::now() < end) {
+    std::string event = awaitLine("!CAL", end - mock::now());
+    uint32_t at;
+    unsigned s, plate, reason;
+    if (sscanf(event.c_str(), "!CAL:%u %u %u %u", &at, &s, &plate, &reason) == 4 && s == state) {
+      return at;
+    }
+  }
+  return 0;
+}
+
+// calibrates at the given sampling; returns the time the CAL_SCANS scans of the first plate took (ms),
+// "" if the calibration did not complete
+static std::string calibrate(uint8_t sampling) {
+  powerOn(DARK, LOW_PLATE_LIGHT);
+  CHECK(command("SETSAMPLING " + std::to_string(sampling)) == "SETSAMPLING");
+  CHECK(command("SUBSCRIBE 1") == "SUBSCRIBE");
+  CHECK(command("CALIBRATE") == "CALIBRATE");
+  uint32_t scanning = awaitCal(CAL_SCAN);
+  uint32_t lift = awaitCal(CAL_LIFT);
+  mock::setLight(ROOM, HIGH_PLATE_LIGHT);
+  uint32_t putDown = awaitCal(CAL_PUTDOWN);
+  mock::setLight(DARK, HIGH_PLATE_LIGHT);
+  uint32_t done = awaitCal(CAL_DONE);
+  CHECK_EQ(command("GETSAMPLING"), "GETSAMPLING:" + std::to_string(sampling));
+  // the settle statistics count stand-alone scans only
+  CHECK_EQ(command("GETSETTLE"), "GETSETTLE:0 0 0 0 0 0 0");
+  if (scanning == 0 || lift <= scanning || putDown == 0 || done == 0) {
+    return "";
+  }
+  return std::to_string(lift - scanning);
+}
+
+// the plates are scanned at the sampling of the profile, as the coffee measured with it
+TEST(scans_at_profile_sampling) {
+  std::string full = isolated([]() { return calibrate(FULL_SAMPLING); });
+  std::string normal = isolated([]() { return calibrate(NORMAL_SAMPLING); });
+  REQUIRE(full != "" && normal != "");
+  uint32_t fullMs = std::stoul(full), normalMs = std::stoul(normal);
+  printf("%u scans: %u ms at full sampling, %u ms at normal sampling\n", CAL_SCANS, fullMs, normalMs);
+  CHECK(fullMs > CAL_SCANS * 1000);
+  CHECK(fullMs > 2 * normalMs);
+}
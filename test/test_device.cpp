@@ -0,0 +1,199 @@
+// test_device.cpp
+//----------------
+// the whole sketch on the simulated device: boot, commands, stand-alone scans
+
+#include "device.h"
+
+#include <tonino_config.h>
+#include <vector>
+
+TEST(boots_and_answers) {
+  powerOn();
+  CHECK_EQ(command("TONINO"), std::string("TONINO:1 1 7"));
+  CHECK_EQ(mock::deviceBaud(), 117647u);
+  // defaults written to the erased EEPROM
+  CHECK_EQ(mock::eeprom()[EEPROM_CHANGED_ADDRESS], EEPROM_SET);
+  CHECK_EQ(mock::rxLost(), 0u);
+}
+
+TEST(scans_on_request) {
+  powerOn();
+  std::string r = command("II_SCAN");
+  REQUIRE(r.size() > 0);
+  unsigned w, red, g, b;
+  CHECK_EQ(sscanf(r.c_str(), "II_SCAN:%u %u %u %u", &w, &red, &g, &b), 4);
+  // the red channel is read with twice the gate time
+  CHECK_NEAR(red, COFFEE.hz[1], COFFEE.hz[1] * 0.01);
+  CHECK_NEAR(b, COFFEE.hz[3], COFFEE.hz[3] * 0.01);
+}
+
+TEST(unknown_command) {
+  powerOn();
+  mock::send("NOSUCHCMD\n");
+  CHECK_EQ(awaitLine("NOSUCHCMD"), std::string("NOSUCHCMD ERROR"));
+}
+
+TEST(config_roundtrip) {
+  powerOn();
+  CHECK_EQ(command("SETBRIGHTNESS 3"), std::string("SETBRIGHTNESS"));
+  std::string conf = command("GETCONF");
+  // longer lines than the 128 bytes of serial buffers are fine while the device is idle
+  REQUIRE(conf.compare(0, 8, "GETCONF:") == 0);
+  CHECK_EQ(command("SETBRIGHTNESS 9"), std::string("SETBRIGHTNESS"));
+  CHECK_EQ(command("SETCONF " + conf.substr(8)), std::string("SETCONF"));
+  CHECK_EQ(command("GETBRIGHTNESS"), std::string("GETBRIGHTNESS:3"));
+  CHECK_EQ(command("GETCONF"), conf);
+}
+
+static const char base64Chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static std::vector<uint8_t> fromBase64(const std::string& s) {
+  std::vector<uint8_t> out;
+  uint32_t bits = 0;
+  int n = 0;
+  for (size_t i = 0; i < s.size() && s[i] != '='; ++i) {
+    bits = (bits << 6) | (strchr(base64Chars, s[i]) - base64Chars);
+    n += 6;
+    if (n >= 8) {
+      n -= 8;
+      out.push_back((bits >> n) & 0xFF);
+    }
+  }
+  return out;
+}
+
+static std::string toBase64(const std::vector<uint8_t>& b) {
+  std::string out;
+  for (size_t i = 0; i < b.size(); i += 3) {
+    uint32_t t = (uint32_t)b[i] << 16 | (i + 1 < b.size() ? b[i + 1] << 8 : 0) | (i + 2 < b.size() ? b[i + 2] : 0);
+    out += base64Chars[(t >> 18) & 0x3F];
+    out += base64Chars[(t >> 12) & 0x3F];
+    out += (i + 1 < b.size() ? base64Chars[(t >> 6) & 0x3F] : '=');
+    out += (i + 2 < b.size() ? base64Chars[t & 0x3F] : '=');
+  }
+  return out;
+}
+
+static void setCrc(std::vector<uint8_t>* blob) {
+  uint16_t c = ToninoConfig::crc(blob->data(), blob->size() - 2);
+  (*blob)[blob->size() - 2] = c & 0xFF;
+  (*blob)[blob->size() - 1] = c >> 8;
+}
+
+TEST(config_holds_power_and_throughput) {
+  powerOn();
+  REQUIRE(command("SETPOWER 30 90 900 1") == "SETPOWER");
+  REQUIRE(command("SETTHROUGHPUT 1") == "SETTHROUGHPUT");
+  std::string conf = command("GETCONF");
+  REQUIRE(conf.compare(0, 8, "GETCONF:") == 0);
+  std::vector<uint8_t> blob = fromBase64(conf.substr(8));
+  CHECK_EQ(blob.size(), (size_t)CONFIG_BLOB_SIZE);
+  CHECK_EQ(blob[0], CONFIG_BLOB_VERSION);
+  CHECK_EQ(command("RESETDEF"), std::string("RESETDEF"));
+  CHECK_EQ(command("SETCONF " + conf.substr(8)), std::string("SETCONF"));
+  CHECK_EQ(command("GETPOWER").substr(0, 20), std::string("GETPOWER:30 90 900 1"));
+  CHECK_EQ(command("GETTHROUGHPUT").substr(0, 15), std::string("GETTHROUGHPUT:1"));
+
+  // invalid power times or flags reject the whole blob
+  std::vector<uint8_t> bad = blob;
+  bad[2 + 5] = 200;
+  setCrc(&bad);
+  CHECK_EQ(command("SETCONF " + toBase64(bad)), std::string("SETCONF ERROR"));
+  bad = blob;
+  bad[2 + 12] = 2;
+  setCrc(&bad);
+  CHECK_EQ(command("SETCONF " + toBase64(bad)), std::string("SETCONF ERROR"));
+  CHECK_EQ(command("GETCONF"), conf);
+}
+
+// the profiles of a blob without the quadratic term behind each, as in version 2 and 3 blobs
+static std::vector<uint8_t> linearProfiles(const std::vector<uint8_t>& blob) {
+  std::vector<uint8_t> profiles;
+  for (uint8_t p = 0; p < NR_PROFILES; ++p) {
+    std::vector<uint8_t>::const_iterator start =
+        blob.begin() + CONFIG_BLOB_HEADER + CONFIG_BLOB_SETTINGS + p * CONFIG_BLOB_PROFILE_SIZE;
+    profiles.insert(profiles.end(), start, start + SENSOR_PROFILE_SIZE);
+  }
+  return profiles;
+}
+
+TEST(config_holds_quadratic_calibration) {
+  powerOn();
+  REQUIRE(command("SETPROFILE 2") == "SETPROFILE");
+  REQUIRE(command("SETCAL 1.2 -0.3 0.25") == "SETCAL");
+  std::string cal = command("GETCAL");
+  std::string conf = command("GETCONF");
+  REQUIRE(conf.compare(0, 8, "GETCONF:") == 0);
+  std::vector<uint8_t> blob = fromBase64(conf.substr(8));
+  REQUIRE(blob.size() == CONFIG_BLOB_SIZE);
+  // 0.25 in units of 1/CAL_QUAD_SCALE behind profile 2
+  size_t quad = CONFIG_BLOB_HEADER + CONFIG_BLOB_SETTINGS + 2 * CONFIG_BLOB_PROFILE_SIZE + SENSOR_PROFILE_SIZE;
+  CHECK_EQ(blob[quad] | blob[quad + 1] << 8, 5000);
+
+  CHECK_EQ(command("RESETDEF"), std::string("RESETDEF"));
+  REQUIRE(command("SETPROFILE 2") == "SETPROFILE");
+  CHECK(command("GETCAL") != cal);
+  CHECK_EQ(command("SETCONF " + conf.substr(8)), std::string("SETCONF"));
+  CHECK_EQ(command("GETPROFILE").substr(0, 12), std::string("GETPROFILE:2"));
+  CHECK_EQ(command("GETCAL"), cal);
+  CHECK_EQ(command("GETCONF"), conf);
+
+  // -32768 is out of range
+  blob[quad] = 0x00;
+  blob[quad + 1] = 0x80;
+  setCrc(&blob);
+  CHECK_EQ(command("SETCONF " + toBase64(blob)), std::string("SETCONF ERROR"));
+  CHECK_EQ(command("GETCONF"), conf);
+}
+
+TEST(config_version_3_is_converted) {
+  powerOn();
+  REQUIRE(command("SETCAL 1.2 -0.3") == "SETCAL");
+  std::string linear = command("GETCAL");
+  std::vector<uint8_t> blob = fromBase64(command("GETCONF").substr(8));
+  REQUIRE(blob.size() == CONFIG_BLOB_SIZE);
+  // a version 3 blob as exported by earlier firmware: profiles without the quadratic terms
+  std::vector<uint8_t> v3(blob.begin(), blob.begin() + CONFIG_BLOB_HEADER + CONFIG_BLOB_SETTINGS);
+  v3[0] = 3;
+  v3[1] = CONFIG_BLOB_V3_PAYLOAD;
+  std::vector<uint8_t> profiles = linearProfiles(blob);
+  v3.insert(v3.end(), profiles.begin(), profiles.end());
+  v3.resize(v3.size() + 2);
+  REQUIRE(v3.size() == CONFIG_BLOB_HEADER + CONFIG_BLOB_V3_PAYLOAD + 2);
+  setCrc(&v3);
+
+  REQUIRE(command("SETCAL 1.2 -0.3 0.25") == "SETCAL");
+  CHECK_EQ(command("SETCONF " + toBase64(v3)), std::string("SETCONF"));
+  // its calibrations are linear
+  CHECK_EQ(command("GETCAL"), linear);
+
+  // an unknown version is rejected
+  blob[0] = CONFIG_BLOB_VERSION + 1;
+  setCrc(&blob);
+  CHECK_EQ(command("SETCONF " + toBase64(blob)), std::string("SETCONF ERROR"));
+}
+
+TEST(config_version_2_is_converted) {
+  powerOn();
+  REQUIRE(command("SETBRIGHTNESS 3") == "SETBRIGHTNESS");
+  std::vector<uint8_t> blob = fromBase64(command("GETCONF").substr(8));
+  REQUIRE(blob.size() == CONFIG_BLOB_SIZE);
+  // a version 2 blob as exported by earlier firmware: without the settings added since
+  std::vector<uint8_t> v2(blob.begin(), blob.begin() + CONFIG_BLOB_HEADER + CONFIG_BLOB_V2_SETTINGS);
+  v2[0] = 2;
+  v2[1] = CONFIG_BLOB_V2_PAYLOAD;
+  std::vector<uint8_t> profiles = linearProfiles(blob);
+  v2.insert(v2.end(), profiles.begin(), profiles.end());
+  v2.resize(v2.size() + 2);
+  REQUIRE(v2.size() == CONFIG_BLOB_HEADER + CONFIG_BLOB_V2_PAYLOAD + 2);
+  setCrc(&v2);
+
+  REQUIRE(command("SETPOWER 30 90 900 1") == "SETPOWER");
+  REQUIRE(command("SETTHROUGHPUT 1") == "SETTHROUGHPUT");
+  REQUIRE(command("SETBRIGHTNESS 9") == "SETBRIGHTNESS");
+  CHECK_EQ(command("SETCONF " + toBase64(v2)), std::string("SETCONF"));
+  CHECK_EQ(command("GETBRIGHTNESS"), std::string("GETBRIGHTNESS:3"));
+  // kept
+  CHECK_EQ(command("GETPOWER").substr(0, 20), std::string("GETPOWER:30 90 900 1"));
+  CHECK_EQ(command("GETTHROUGHPUT").substr(0, 15), std::string("GETTHROUGHPUT:1"));
+}
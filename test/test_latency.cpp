@@ -0,0 +1,172 @@
+// test_latency.cpp
+//-----------------
+// serial response time while the can is lifted and put down: a request is only delayed by
+// the scan running when it arrives, never by the waits of lift detection, settling or animation;
+// and the response time of single requests in ASCII and binary mode
+
+#include "device.h"
+
+#include "frames.h"
+#include <tonino_serial.h>
+#include <algorithm>
+#include <vector>
+
+// can lifted for the first 2s of every 8s
+#define CYCLE_US 8000000ULL
+#define LIFTED_US 2000000ULL
+
+static void liftedCan(uint64_t us, bool ledOn, mock::Light* light) {
+  bool lifted = (us % CYCLE_US) < LIFTED_US;
+  *light = (lifted ? ROOM : DARK);
+  if (ledOn && !lifted) {
+    for (uint8_t i = 0; i < 4; ++i) {
+      light->hz[i] += COFFEE.hz[i];
+    }
+  }
+}
+
+// time of a line: the end of its '\n' on the wire
+static uint64_t byteUs(uint32_t baud) {
+  return 10000000ULL / baud;
+}
+
+TEST(requests_answered_within_a_scan) {
+  powerOn();
+  REQUIRE(command("SUBSCRIBE 1") == "SUBSCRIBE");
+  // the longest a request can wait: a whole scan
+  uint64_t start = mock::now();
+  REQUIRE(command("SCAN").size() > 0);
+  uint64_t scanUs = mock::now() - start;
+  mock::setLightFunction(liftedCan);
+
+  // like a host polling every 37ms, each request waits for the previous reply
+  const uint64_t interval = 37000;
+  const uint64_t end = mock::now() + 60000000ULL;
+  std::vector<uint64_t> latencies;
+  uint32_t sent = 0, scans = 0, lifts = 0;
+  uint64_t requestAt = 0;
+  bool open = false;
+  uint64_t nextAt = mock::now();
+  std::string got;
+  std::vector<uint64_t> gotAt;
+  while (mock::now() < end) {
+    if (!open) {
+      std::string line = "GETSAMPLING#" + std::to_string(sent++) + "\n";
+      mock::sendAt(nextAt, line.c_str());
+      requestAt = max(nextAt, mock::now()) + line.size() * byteUs(115200);
+      nextAt = requestAt + interval;
+      open = true;
+    }
+    loop();
+    got += mock::takeReceived(&gotAt);
+    size_t nl;
+    while ((nl = got.find('\n')) != std::string::npos) {
+      std::string reply = got.substr(0, nl);
+      uint64_t replyAt = gotAt[nl];
+      got.erase(0, nl + 1);
+      gotAt.erase(gotAt.begin(), gotAt.begin() + nl + 1);
+      if (reply.compare(0, 5, "!SCAN") == 0) {
+        scans++;
+      } else if (reply.compare(0, 5, "!LIFT") == 0) {
+        lifts++;
+      } else if (isReply(reply, "GETSAMPLING")) {
+        CHECK(open);
+        latencies.push_back(replyAt - requestAt);
+        open = false;
+      }
+    }
+  }
+  mock::setLightFunction(NULL);
+  REQUIRE(latencies.size() > 1000);
+
+  std::sort(latencies.begin(), latencies.end());
+  uint64_t median = latencies[latencies.size() / 2];
+  uint64_t p99 = latencies[latencies.size() * 99 / 100];
+  uint64_t worst = latencies.back();
+  size_t slow = latencies.end() - std::upper_bound(latencies.begin(), latencies.end(), 20000ULL);
+  printf("%u requests, %u lifts, %u scans: median %.1f ms, 99%% %.1f ms, max %.1f ms (a scan takes %.1f ms), %u over 20 ms\n",
+         (uint32_t)latencies.size(), lifts, scans, median / 1000.0, p99 / 1000.0, worst / 1000.0, scanUs / 1000.0,
+         (uint32_t)slow);
+  CHECK(lifts >= 6);
+  CHECK(scans >= 6);
+  CHECK(median < 5000);
+  // only requests arriving during a scan wait longer
+  CHECK(worst < scanUs + 20000);
+  CHECK(slow < latencies.size() / 10);
+  CHECK_EQ(mock::rxLost(), 0u);
+}
+
+// one request sent to the idle device and its reply
+struct Exchange {
+  size_t requestBytes;
+  size_t replyBytes;
+  uint64_t deviceUs;    // end of the request to the start of the reply: handler, scan, waits
+  uint64_t totalUs;     // end of the request to the end of the reply
+};
+
+// sends request and runs the main loop until a reply ending with end has arrived completely
+static Exchange exchangeOnce(const std::string& request, char end) {
+  Exchange e;
+  uint64_t at = mock::now();
+  mock::sendAt(at, (const uint8_t*)request.data(), request.size());
+  uint64_t requestEnd = at + request.size() * byteUs(115200);
+  std::string got;
+  std::vector<uint64_t> gotAt;
+  while (got.empty() || got[got.size() - 1] != end) {
+    loop();
+    std::vector<uint64_t> t;
+    got += mock::takeReceived(&t);
+    gotAt.insert(gotAt.end(), t.begin(), t.end());
+  }
+  e.requestBytes = request.size();
+  e.replyBytes = got.size();
+  e.deviceUs = gotAt.front() - byteUs(115200) - requestEnd;
+  e.totalUs = gotAt.back() - requestEnd;
+  return e;
+}
+
+// the fastest of a few exchanges at different times, i.e. one not delayed by a lift check
+static Exchange exchange(const std::string& request, char end) {
+  Exchange best = exchangeOnce(request, end);
+  for (uint8_t i = 1; i < 5; ++i) {
+    runFor(37000 * i);
+    Exchange e = exchangeOnce(request, end);
+    if (e.totalUs < best.totalUs) {
+      best = e;
+    }
+  }
+  return best;
+}
+
+// the virtual clock counts the wire, the gates of a scan and waits for the transmit buffer, not
+// the CPU time of formatting (see the ToninoResponse benchmark in bench/)
+TEST(ascii_and_binary_response_times) {
+  static const char* const names[] = { "SCAN", "II_SCAN", "GETCONF" };
+  static const uint8_t cmds[] = { BIN_SCAN, BIN_II_SCAN, BIN_GETCONF };
+  Exchange ascii[3], binary[3];
+  powerOn();
+  // past the scan after power-on
+  runFor(3000000);
+  mock::takeReceived();
+  for (uint8_t i = 0; i < 3; ++i) {
+    ascii[i] = exchange(std::string(names[i]) + "\n", '\n');
+  }
+  REQUIRE(command("BINARY") == "BINARY");
+  for (uint8_t i = 0; i < 3; ++i) {
+    binary[i] = exchange(requestFrame(cmds[i], std::vector<uint8_t>(), false), '\0');
+  }
+  printf("at 115200 baud     request  reply  device ms  total ms\n");
+  for (uint8_t i = 0; i < 3; ++i) {
+    printf("%-7s ASCII    %7u %6u %10.2f %9.2f\n", names[i], (uint32_t)ascii[i].requestBytes,
+           (uint32_t)ascii[i].replyBytes, ascii[i].deviceUs / 1000.0, ascii[i].totalUs / 1000.0);
+    printf("%-7s binary   %7u %6u %10.2f %9.2f\n", names[i], (uint32_t)binary[i].requestBytes,
+           (uint32_t)binary[i].replyBytes, binary[i].deviceUs / 1000.0, binary[i].totalUs / 1000.0);
+  }
+  // the same scan in both modes, the replies differ only by their length on the wire
+  for (uint8_t i = 0; i < 3; ++i) {
+    CHECK_NEAR(binary[i].deviceUs, ascii[i].deviceUs, 2000);
+  }
+  CHECK(binary[1].totalUs <= ascii[1].totalUs);
+  CHECK(binary[2].totalUs < ascii[2].totalUs);
+  CHECK_EQ(mock::rxLost(), 0u);
+}
@@ -0,0 +1,127 @@
+// test_log.cpp
+//-------------
+// scan history in EEPROM across power cycles
+
+#include "test.h"
+
+#include <tonino_log.h>
+#include <vector>
+
+// power cycle keeping the EEPROM; millis() restarts at 0
+static void reboot(ToninoLog* log) {
+  std::string rom((const char*)mock::eeprom(), E2END + 1);
+  mock::reset();
+  memcpy(mock::eeprom(), rom.data(), rom.size());
+  *log = ToninoLog();
+  log->init();
+}
+
+static void add(ToninoLog* log, int32_t tval, int32_t red, int32_t blue) {
+  sensorData sd;
+  memset(&sd, 0, sizeof(sd));
+  sd.value[RED_IDX] = red;
+  sd.value[BLUE_IDX] = blue;
+  log->add(tval, &sd, false);
+}
+
+static std::vector<logRecord> history(ToninoLog* log) {
+  std::vector<logRecord> records;
+  logRecord rec;
+  log->rewind();
+  while (log->next(&rec)) {
+    records.push_back(rec);
+  }
+  return records;
+}
+
+static uint8_t pageSeq(uint8_t p) {
+  return mock::eeprom()[LOG_START_ADDRESS + p * LOG_PAGE_SIZE];
+}
+
+TEST(reboot_continues_page) {
+  ToninoLog log;
+  log.init();
+  mock::advance(70000000);
+  add(&log, 80, 5000, 2500);
+  mock::advance(5000000);
+  add(&log, 82, 5100, 2400);
+
+  reboot(&log);
+  uint32_t writes = mock::eepromWrites();
+  mock::advance(3000000);
+  add(&log, 75, 4800, 2600);
+  // only the record is written, no page is cleared
+  CHECK(mock::eepromWrites() - writes < 10);
+  CHECK_EQ(pageSeq(0), 0);
+  CHECK_EQ(pageSeq(1), LOG_EMPTY);
+
+  std::vector<logRecord> r = history(&log);
+  REQUIRE(r.size() == 3);
+  CHECK_EQ(r[0].tval, 80);
+  CHECK_EQ(r[0].time, 70u);
+  CHECK_EQ(r[0].flags, LOG_BOOT);
+  CHECK_EQ(r[1].tval, 82);
+  CHECK_EQ(r[1].red, 5100);
+  CHECK_EQ(r[1].time, 75u);
+  CHECK_EQ(r[1].flags, 0);
+  // time restarted at power-on
+  CHECK_EQ(r[2].tval, 75);
+  CHECK_EQ(r[2].red, 4800);
+  CHECK_EQ(r[2].blue, 2600);
+  CHECK_EQ(r[2].time, 3u);
+  CHECK_EQ(r[2].flags, LOG_BOOT);
+}
+
+TEST(history_survives_reboots) {
+  ToninoLog log;
+  log.init();
+  const int boots = 40;
+  for (int i = 0; i < boots; ++i) {
+    mock::advance(2000000 + i * 1000000);
+    add(&log, 60 + i, 4000 + 10 * i, 2000 - 10 * i);
+    reboot(&log);
+  }
+  std::vector<logRecord> r = history(&log);
+  REQUIRE(r.size() == (size_t)boots);
+  for (int i = 0; i < boots; ++i) {
+    CHECK_EQ(r[i].tval, 60 + i);
+    CHECK_EQ(r[i].blue, 2000 - 10 * i);
+    CHECK_EQ(r[i].time, (uint32_t)(2 + i));
+    CHECK_EQ(r[i].flags, LOG_BOOT);
+  }
+  // one page per boot would have kept only the last LOG_NR_PAGES - 1 of them
+  uint8_t pages = 0;
+  for (uint8_t p = 0; p < LOG_NR_PAGES; ++p) {
+    pages += (pageSeq(p) != LOG_EMPTY);
+  }
+  printf("%d boots with one scan each use %u of %u pages\n", boots, pages, (unsigned)LOG_NR_PAGES);
+  CHECK(pages < boots / 2);
+}
+
+TEST(torn_record_starts_new_page) {
+  ToninoLog log;
+  log.init();
+  mock::advance(10000000);
+  add(&log, 90, 6000, 3000);
+  // power lost after the header and first byte of the next record were written
+  uint8_t* page = mock::eeprom() + LOG_START_ADDRESS;
+  uint8_t free = 1;
+  while (page[free] != LOG_EMPTY) {
+    free++;
+  }
+  page[free] = 0;
+  page[free + 1] = 0x81;
+
+  reboot(&log);
+  mock::advance(4000000);
+  add(&log, 70, 4000, 2800);
+  CHECK_EQ(pageSeq(1), 1);
+
+  std::vector<logRecord> r = history(&log);
+  REQUIRE(r.size() == 2);
+  CHECK_EQ(r[0].tval, 90);
+  CHECK_EQ(r[0].time, 10u);
+  CHECK_EQ(r[1].tval, 70);
+  CHECK_EQ(r[1].red, 4000);
+  CHECK_EQ(r[1].time, 4u);
+}
@@ -0,0 +1,327 @@
+// test_parser.cpp
+//----------------
+// streaming parser of SerialCommand: fixed regressions and random lines checked against a
+// simple reference model of the protocol (CMD[#id] [args...] or streamed arguments)
+
+#include "test.h"
+
+#include <SerialCommand.h>
+#include <vector>
+
+// one command as seen by a handler
+struct Call {
+  std::string handler;     // name of the handler, "default" for unknown commands
+  std::string command;     // command passed to the default handler
+  std::string id;          // request ID, empty if none
+  std::vector<std::string> args;
+  std::string stream;      // characters passed to the argument handler
+  bool streamStarted;      // argument handler got the leading '\0'
+};
+
+static SerialCommand sCmd;
+static std::vector<Call> calls;
+static std::string streamed;
+static bool streamStarted;
+
+static void record(const char* name) {
+  Call c;
+  c.handler = name;
+  c.id = (sCmd.requestId() == NULL ? "" : sCmd.requestId());
+  char* arg;
+  while ((arg = sCmd.next()) != NULL) {
+    c.args.push_back(arg);
+  }
+  c.stream = streamed;
+  c.streamStarted = streamStarted;
+  streamed.clear();
+  streamStarted = false;
+  calls.push_back(c);
+}
+
+static void handleA() { record("A"); }
+static void handleGet() { record("GET"); }
+static void handleGetx() { record("GETX"); }
+static void handleSet() { record("SET"); }
+static void handleStream() {
+  Call c;
+  c.handler = "STREAM";
+  c.id = (sCmd.requestId() == NULL ? "" : sCmd.requestId());
+  c.stream = streamed;
+  c.streamStarted = streamStarted;
+  streamed.clear();
+  streamStarted = false;
+  calls.push_back(c);
+}
+static void streamArg(char c) {
+  if (c == '\0') {
+    streamStarted = true;
+  } else {
+    streamed += c;
+  }
+}
+static void handleDefault(const char* command) {
+  Call c;
+  c.handler = "default";
+  c.command = command;
+  c.streamStarted = false;
+  calls.push_back(c);
+}
+
+// sorted by command as required by setCommands()
+static const SerialCommand::SerialCommandCallback table[] = {
+  { "A",      handleA, NULL },
+  { "GET",    handleGet, NULL },
+  { "GETX",   handleGetx, NULL },
+  { "SET",    handleSet, NULL },
+  { "STREAM", handleStream, streamArg },
+};
+static const char* const names[] = { "A", "GET", "GETX", "SET", "STREAM" };
+
+static void setUp() {
+  sCmd = SerialCommand();
+  sCmd.setCommands(table, sizeof(table) / sizeof(table[0]));
+  sCmd.setDefaultHandler(handleDefault);
+  calls.clear();
+  streamed.clear();
+  streamStarted = false;
+}
+
+// feeds the bytes one by one; returns the number of times processChar() reported a command
+static int feed(const std::string& s) {
+  int executed = 0;
+  for (size_t i = 0; i < s.size(); ++i) {
+    executed += sCmd.processChar(s[i]) ? 1 : 0;
+  }
+  return executed;
+}
+
+// the characters of the line that are parsed at all
+static std::string printable(const std::string& line) {
+  std::string s;
+  for (size_t i = 0; i < line.size(); ++i) {
+    if (isprint((unsigned char)line[i]) && !(line[i] & 0x80)) {
+      s += line[i];
+    }
+  }
+  return s;
+}
+
+// reference model: the call expected for a line (without terminator); false if none
+static bool model(const std::string& line, Call* expected) {
+  std::string s = printable(line);
+  size_t p = s.find_first_not_of(' ');
+  if (p == std::string::npos) {
+    return false;
+  }
+  // command up to the first delimiter or request ID separator, the latter not at the start
+  size_t end = s.find(' ', p);
+  size_t sep = s.find('#', p + 1);
+  std::string command, id;
+  if (sep != std::string::npos && (end == std::string::npos || sep < end)) {
+    command = s.substr(p, sep - p);
+    id = s.substr(sep + 1, end == std::string::npos ? std::string::npos : end - sep - 1);
+  } else {
+    command = s.substr(p, end == std::string::npos ? std::string::npos : end - p);
+  }
+  std::string rest = (end == std::string::npos ? "" : s.substr(end + 1));
+
+  *expected = Call();
+  expected->streamStarted = false;
+  const char* handler = NULL;
+  for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); ++i) {
+    if (command == names[i]) {
+      handler = names[i];
+    }
+  }
+  if (handler == NULL) {
+    expected->handler = "default";
+    expected->command = command;
+    return true;
+  }
+  expected->handler = handler;
+  expected->id = id;
+  if (expected->handler == "STREAM") {
+    expected->stream = rest;
+    expected->streamStarted = true;
+    return true;
+  }
+  size_t a = 0;
+  while (a < rest.size()) {
+    size_t b = rest.find(' ', a);
+    if (b == std::string::npos) {
+      b = rest.size();
+    }
+    if (b > a) {
+      expected->args.push_back(rest.substr(a, b - a));
+    }
+    a = b + 1;
+  }
+  return true;
+}
+
+static std::string describe(const Call& c) {
+  std::string s = c.handler + "(" + c.command + ")#" + c.id;
+  for (size_t i = 0; i < c.args.size(); ++i) {
+    s += " [" + c.args[i] + "]";
+  }
+  if (c.streamStarted) {
+    s += " stream[" + c.stream + "]";
+  }
+  return s;
+}
+
+// checks that line followed by the terminator results in exactly the call of the model
+static void checkLine(const std::string& line) {
+  calls.clear();
+  Call expected;
+  bool any = model(line, &expected);
+  int executed = feed(line + "\n");
+  if (!any) {
+    CHECK_EQ(calls.size(), 0u);
+    CHECK_EQ(executed, 0);
+    return;
+  }
+  REQUIRE(calls.size() == 1);
+  CHECK_EQ(describe(calls[0]), describe(expected));
+  CHECK_EQ(executed, expected.handler == "default" ? 0 : 1);
+}
+
+// deterministic pseudo random numbers such that failures can be reproduced
+static uint32_t seed;
+static uint32_t rnd(uint32_t n) {
+  seed = seed * 1103515245u + 12345u;
+  return (seed >> 16) % n;
+}
+
+// a random line of commands, IDs, delimiters, arguments and noise of up to maxLen characters
+static std::string randomLine(size_t maxLen) {
+  static const char noise[] = { ' ', ' ', ' ', '#', '\r', '\t', '\x01', '\x7F', '\xB0', '\0' };
+  std::string s;
+  while (s.size() < maxLen) {
+    switch (rnd(6)) {
+      case 0:
+        s += names[rnd(sizeof(names) / sizeof(names[0]))];
+        break;
+      case 1:
+      case 2:
+        s += (char)('A' + rnd(26));
+        break;
+      case 3:
+        s += (char)('0' + rnd(10));
+        break;
+      default:
+        s += noise[rnd(sizeof(noise))];
+        break;
+    }
+  }
+  return s.substr(0, maxLen);
+}
+
+// number of buffer bytes the line takes at most: each stored character and separator
+// plus the one behind the command
+static size_t bufferUse(const std::string& line) {
+  return printable(line).size() + 1;
+}
+
+TEST(commands_and_arguments) {
+  setUp();
+  checkLine("GET");
+  checkLine("GET 1 22 333");
+  checkLine("   GETX   a  b   ");
+  checkLine("SET#42 x");
+  checkLine("SET#42");
+  checkLine("A#");
+  checkLine("A 1#2 3");
+  checkLine("");
+  checkLine("    ");
+  checkLine("GE");
+  checkLine("GETXY 1");
+  checkLine("#1 GET");
+  checkLine("G\rE\tT\x01 5");
+  // bytes of 0x80 and above, e.g. from a line garbled at another baud rate
+  checkLine("GE\xB0T\xFF 5\x80");
+}
+
+TEST(unknown_command_skips_long_arguments) {
+  setUp();
+  checkLine("NOPE " + std::string(300, 'x'));
+  checkLine("GET 7");
+}
+
+TEST(streamed_arguments_are_not_limited_by_the_buffer) {
+  setUp();
+  std::string blob;
+  for (int i = 0; i < 160; ++i) {
+    blob += (char)('A' + i % 26);
+  }
+  checkLine("STREAM#9 " + blob);
+  checkLine("STREAM  a b#c ");
+  checkLine("STREAM");
+  checkLine("STREAM#id");
+  checkLine("GET 1");
+}
+
+TEST(long_lines_do_not_overflow) {
+  setUp();
+  std::string arg(SERIALCOMMAND_BUFFER * 3, '7');
+  calls.clear();
+  feed("GET " + arg + " " + arg + "\n");
+  REQUIRE(calls.size() == 1);
+  CHECK_EQ(calls[0].handler, std::string("GET"));
+  REQUIRE(calls[0].args.size() == 1);
+  CHECK_EQ(calls[0].args[0].size(), (size_t)SERIALCOMMAND_BUFFER - 4);
+  calls.clear();
+  feed(std::string(SERIALCOMMAND_BUFFER * 2, 'G') + "#" + arg + "\n");
+  REQUIRE(calls.size() == 1);
+  CHECK_EQ(calls[0].handler, std::string("default"));
+  CHECK_EQ(calls[0].command.size(), (size_t)SERIALCOMMAND_BUFFER);
+  checkLine("SET#1 2");
+}
+
+// random lines that fit into the buffer must match the model exactly
+TEST(fuzz_against_model) {
+  setUp();
+  seed = 2017;
+  int checked = 0;
+  for (int i = 0; i < 20000; ++i) {
+    std::string line = randomLine(1 + rnd(SERIALCOMMAND_BUFFER + 10));
+    if (bufferUse(line) > SERIALCOMMAND_BUFFER) {
+      continue;
+    }
+    int failures = testFailures();
+    checkLine(line);
+    if (testFailures() != failures) {
+      printf("line %d: \"%s\"\n", i, line.c_str());
+      return;
+    }
+    checked++;
+  }
+  CHECK(checked > 10000);
+}
+
+// random lines of any length: at most one call each, tokens within the line, and the parser
+// recovers such that the following line is parsed as the model says
+TEST(fuzz_recovery) {
+  setUp();
+  seed = 4711;
+  for (int i = 0; i < 5000; ++i) {
+    std::string line = randomLine(1 + rnd(4 * SERIALCOMMAND_BUFFER));
+    calls.clear();
+    feed(line + "\n");
+    int failures = testFailures();
+    CHECK(calls.size() <= 1);
+    for (size_t c = 0; c < calls.size(); ++c) {
+      for (size_t a = 0; a < calls[c].args.size(); ++a) {
+        CHECK(!calls[c].args[a].empty());
+        CHECK(calls[c].args[a].find(' ') == std::string::npos);
+        CHECK(printable(line).find(calls[c].args[a]) != std::string::npos);
+      }
+      CHECK(calls[c].id.size() <= SERIALCOMMAND_BUFFER);
+    }
+    checkLine(randomLine(1 + rnd(SERIALCOMMAND_BUFFER / 2)));
+    if (testFailures() != failures) {
+      printf("line %d: \"%s\"\n", i, line.c_str());
+      return;
+    }
+  }
+}
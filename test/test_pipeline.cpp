@@ -0,0 +1,167 @@
+// test_pipeline.cpp
+//------------------
+// pipelined commands: the host keeps sending without waiting for replies, as far as the
+// 128 bytes of the receive buffer and command queue allow, while scans block the device
+
+#include "device.h"
+
+#include "frames.h"
+#include <tonino_config.h>
+#include <tonino_serial.h>
+#include <deque>
+#include <vector>
+
+// bytes the host may have sent without having the reply: receive buffer and command queue
+#define WINDOW (MOCK_SERIAL_BUFFER + SERIAL_QUEUE)
+
+// deterministic pseudo random numbers such that failures can be reproduced
+static uint32_t seed;
+static uint32_t rnd(uint32_t n) {
+  seed = seed * 1103515245u + 12345u;
+  return (seed >> 16) % n;
+}
+
+// one request on its way and the length it takes of the window
+struct Request {
+  std::string tag;
+  size_t len;
+};
+
+TEST(ascii_commands_in_order) {
+  static const char* const commands[] = {
+    "TONINO", "GETSAMPLING", "GETCMODE", "GETBRIGHTNESS", "SETBRIGHTNESS", "SCAN", "II_SCAN",
+    "GETPROFILE", "GETCAL"
+  };
+  const uint32_t total = 400;
+  powerOn();
+  seed = 35;
+  std::vector<std::string> lines;
+  for (uint32_t i = 0; i < total; ++i) {
+    const char* name = commands[rnd(sizeof(commands) / sizeof(commands[0]))];
+    lines.push_back(std::string(name) + "#" + std::to_string(i) + (strcmp(name, "SETBRIGHTNESS") == 0 ? " 8\n" : "\n"));
+  }
+
+  std::deque<Request> open;
+  size_t inFlight = 0;
+  uint32_t sent = 0, replied = 0, scans = 0;
+  std::string got;
+  uint64_t end = mock::now() + 900000000ULL;
+  while (replied < total && mock::now() < end) {
+    // send as much as fits into the window
+    while (sent < total && inFlight + lines[sent].size() <= WINDOW) {
+      const std::string& line = lines[sent];
+      mock::send(line.c_str());
+      Request r;
+      r.tag = line.substr(0, line.find_first_of(" \n"));
+      r.len = line.size();
+      open.push_back(r);
+      inFlight += r.len;
+      scans += (line.find("SCAN") != std::string::npos);
+      sent++;
+    }
+    loop();
+    got += mock::takeReceived();
+    size_t nl;
+    while ((nl = got.find('\n')) != std::string::npos) {
+      std::string reply = got.substr(0, nl);
+      got.erase(0, nl + 1);
+      if (reply.empty() || reply[0] == '!') {
+        continue;
+      }
+      REQUIRE(!open.empty());
+      // each reply carries the tag of the oldest open request
+      std::string tag = reply.substr(0, reply.find(':'));
+      if (tag != open.front().tag) {
+        CHECK_EQ(tag, open.front().tag);
+        return;
+      }
+      CHECK(reply.find("ERR") == std::string::npos);
+      inFlight -= open.front().len;
+      open.pop_front();
+      replied++;
+    }
+  }
+  printf("%u commands (%u scans) in %.1f s, none lost\n", replied, scans, mock::now() / 1e6);
+  CHECK_EQ(replied, total);
+  CHECK_EQ(mock::rxLost(), 0u);
+  CHECK(scans > total / 10);
+}
+
+// ---- binary mode
+
+struct Frame {
+  uint8_t cmd;
+  uint8_t status;
+  size_t len;
+};
+
+TEST(binary_frames_in_order) {
+  static const uint8_t commands[] = { BIN_TONINO, BIN_SCAN, BIN_I_SCAN, BIN_II_SCAN, BIN_GETCONF, BIN_SETCONF, 0x42 };
+  const uint32_t total = 300;
+  powerOn();
+  REQUIRE(command("BINARY") == "BINARY");
+  seed = 33;
+  std::vector<uint8_t> cmds;
+  std::vector<bool> corrupt;
+  for (uint32_t i = 0; i < total; ++i) {
+    cmds.push_back(commands[rnd(sizeof(commands))]);
+    corrupt.push_back(rnd(20) == 0);
+  }
+
+  std::vector<uint8_t> blob;
+  std::deque<Frame> open;
+  size_t inFlight = 0;
+  uint32_t sent = 0, replied = 0, corrupted = 0, configs = 0;
+  std::string got;
+  uint64_t end = mock::now() + 900000000ULL;
+  while (replied < total && mock::now() < end) {
+    while (sent < total) {
+      Frame f;
+      f.cmd = cmds[sent];
+      // the blob is sent back once the device exported it
+      if (f.cmd == BIN_SETCONF && blob.empty()) {
+        f.cmd = BIN_GETCONF;
+      }
+      std::string frame = requestFrame(f.cmd, f.cmd == BIN_SETCONF ? blob : std::vector<uint8_t>(), corrupt[sent]);
+      // SETCONF is longer than the window, it is sent with nothing else in flight
+      if (inFlight + frame.size() > WINDOW && inFlight > 0) {
+        break;
+      }
+      f.status = (corrupt[sent] ? BIN_ERR_CRC : (f.cmd == 0x42 ? BIN_ERR_CMD : BIN_OK));
+      f.len = frame.size();
+      mock::send((const uint8_t*)frame.data(), frame.size());
+      open.push_back(f);
+      inFlight += f.len;
+      corrupted += corrupt[sent];
+      sent++;
+    }
+    loop();
+    got += mock::takeReceived();
+    size_t zero;
+    while ((zero = got.find('\0')) != std::string::npos) {
+      std::vector<uint8_t> r = cobsDecode(got.substr(0, zero));
+      got.erase(0, zero + 1);
+      REQUIRE(!open.empty());
+      REQUIRE(r.size() >= 4);
+      uint16_t c = r[r.size() - 2] | (r[r.size() - 1] << 8);
+      CHECK_EQ(ToninoConfig::crc(r.data(), r.size() - 2), c);
+      if (r[0] != open.front().cmd || r[1] != open.front().status) {
+        CHECK_EQ(r[0], open.front().cmd);
+        CHECK_EQ(r[1], open.front().status);
+        return;
+      }
+      if (r[0] == BIN_GETCONF && r[1] == BIN_OK) {
+        CHECK_EQ(r.size(), (size_t)CONFIG_BLOB_SIZE + 4);
+        blob.assign(r.begin() + 2, r.end() - 2);
+        configs++;
+      }
+      inFlight -= open.front().len;
+      open.pop_front();
+      replied++;
+    }
+  }
+  printf("%u frames (%u corrupted, %u configs) in %.1f s, none lost\n", replied, corrupted, configs, mock::now() / 1e6);
+  CHECK_EQ(replied, total);
+  CHECK_EQ(mock::rxLost(), 0u);
+  CHECK(corrupted > 0);
+}
@@ -0,0 +1,51 @@
+// test_power.cpp
+//---------------
+// sleep modes: what is clocked and enabled while the device waits
+
+#include "device.h"
+
+#include <avr/power.h>
+
+// idle sleep between the tasks must not switch the unused ADC and SPI back on
+TEST(idle_keeps_adc_and_spi_off) {
+  powerOn();
+  uint64_t adc = mock::adcOnTime();
+  uint64_t spi = mock::clockedTime(PRSPI);
+  uint64_t adcClock = mock::clockedTime(PRADC);
+  uint64_t timer1 = mock::clockedTime(PRTIM1);
+  uint64_t idle = mock::idleTime();
+  uint64_t start = mock::now();
+  runFor(10000000);
+  uint64_t elapsed = mock::now() - start;
+  printf("idle %.1f%% of the time, timer 1 clocked %.1f%%\n", 100.0 * (mock::idleTime() - idle) / elapsed,
+         100.0 * (mock::clockedTime(PRTIM1) - timer1) / elapsed);
+  CHECK(mock::idleTime() - idle > elapsed / 2);
+  CHECK_EQ(mock::adcOnTime() - adc, 0u);
+  CHECK_EQ(mock::clockedTime(PRADC) - adcClock, 0u);
+  CHECK_EQ(mock::clockedTime(PRSPI) - spi, 0u);
+  // stopped while sleeping
+  CHECK(mock::clockedTime(PRTIM1) - timer1 < elapsed / 2);
+  // and still working afterwards
+  CHECK_EQ(command("TONINO"), std::string("TONINO:1 1 7"));
+  CHECK(command("SCAN").size() > 0);
+}
+
+// neither does power down: sleeping with the watchdog, then until serial input wakes up
+TEST(power_down_keeps_adc_off) {
+  powerOn();
+  REQUIRE(command("SETPOWER 1 2 3") == "SETPOWER");
+  uint64_t adc = mock::adcOnTime();
+  uint64_t adcClock = mock::clockedTime(PRADC);
+  uint64_t down = mock::powerDownTime();
+  uint64_t start = mock::now();
+  mock::sendAt(start + 30000000ULL, "TONINO\n");
+  REQUIRE(awaitLine("WAKE", 40000000ULL) == "WAKE");
+  uint64_t elapsed = mock::now() - start;
+  printf("powered down %.1f s of %.1f s\n", (mock::powerDownTime() - down) / 1e6, elapsed / 1e6);
+  CHECK(mock::powerDownTime() - down > 25000000ULL);
+  CHECK_EQ(mock::adcOnTime() - adc, 0u);
+  CHECK_EQ(mock::clockedTime(PRADC) - adcClock, 0u);
+  CHECK_EQ(ADCSRA & (1 << ADEN), 0);
+  CHECK_EQ(command("TONINO"), std::string("TONINO:1 1 7"));
+  CHECK(command("SCAN").size() > 0);
+}
@@ -0,0 +1,67 @@
+// test_sensor.cpp
+//----------------
+// color sensor readings against the light set on the simulated sensor
+
+#include "test.h"
+
+#include <tonino_tcs3200.h>
+
+static const mock::Light DARK = { { 0, 0, 0, 0 } };
+static const mock::Light COFFEE = { { 12000, 6000, 3500, 3000 } };
+
+// raw values of a scan with the given sampling and sub gates
+static sensorData scan(uint8_t sampling, uint8_t subGates) {
+  mock::reset();
+  mock::setLight(DARK, COFFEE);
+  TCS3200 sensor(MOCK_PIN_S2, MOCK_PIN_S3, MOCK_PIN_LED, MOCK_PIN_POWER, NULL);
+  sensor.init();
+  sensorData sd;
+  sensor.scan(NULL, false, &sd, true, false, NULL, sampling, COLOR_FULL, subGates);
+  return sd;
+}
+
+// Hz of one pulse more or less in each gate
+static double quantum(uint8_t sampling, uint8_t subGates) {
+  return 1000.0 / (1000 / (sampling * subGates));
+}
+
+// the values counted in sub gates are in Hz for any gate, also if it does not divide the second evenly
+TEST(readings_in_hz_for_any_gate) {
+  static const uint8_t samplings[] = { FULL_SAMPLING, SLOW_SAMPLING, NORMAL_SAMPLING, 7, 30, QUICK_SAMPLING };
+  for (size_t s = 0; s < sizeof(samplings); ++s) {
+    for (uint8_t subGates = 2; subGates <= MAX_SUBGATES; ++subGates) {
+      sensorData sd = scan(samplings[s], subGates);
+      uint8_t redSampling = min(REDSAMPLING_FACTOR * samplings[s], 100);
+      CHECK_NEAR(sd.value[WHITE_IDX], COFFEE.hz[0], COFFEE.hz[0] * 0.001 + quantum(samplings[s], subGates));
+      CHECK_NEAR(sd.value[RED_IDX], COFFEE.hz[1], COFFEE.hz[1] * 0.001 + quantum(redSampling, subGates));
+      CHECK_NEAR(sd.value[BLUE_IDX], COFFEE.hz[3], COFFEE.hz[3] * 0.001 + quantum(samplings[s], subGates));
+    }
+  }
+}
+
+// checks that value was read as ever since in a single gate: the pulses counted (one more or less
+// as the phase of the sensor carries over) multiplied by the sampling
+static void checkBaseline(int32_t value, uint32_t hz, uint8_t sampling) {
+  uint32_t pulses = hz * (1000 / sampling) / 1000;
+  CHECK_EQ(value % sampling, 0);
+  CHECK_NEAR(value / sampling, pulses, 1);
+}
+
+// SCAN and II_SCAN read in a single gate; their raw values, and with them the calibrations, are
+// those of earlier firmware, also where the gate does not divide the second
+TEST(single_gate_readings_unchanged) {
+  static const uint8_t samplings[] = { FULL_SAMPLING, SLOW_SAMPLING, NORMAL_SAMPLING, 7, 30, QUICK_SAMPLING };
+  for (size_t s = 0; s < sizeof(samplings); ++s) {
+    sensorData sd = scan(samplings[s], 1);
+    uint8_t redSampling = min(REDSAMPLING_FACTOR * samplings[s], 100);
+    checkBaseline(sd.value[WHITE_IDX], COFFEE.hz[0], samplings[s]);
+    checkBaseline(sd.value[RED_IDX], COFFEE.hz[1], redSampling);
+    checkBaseline(sd.value[GREEN_IDX], COFFEE.hz[2], samplings[s]);
+    checkBaseline(sd.value[BLUE_IDX], COFFEE.hz[3], samplings[s]);
+  }
+  // at sampling 3 white is counted for 333ms: 3996 pulses read as 11988, not scaled to 12000 Hz
+  sensorData sd = scan(NORMAL_SAMPLING, 1);
+  CHECK(sd.value[WHITE_IDX] >= 11985 && sd.value[WHITE_IDX] <= 11991);
+  // red for 166ms: 997 pulses read as 5982, not as 6006 Hz
+  CHECK(sd.value[RED_IDX] >= 5976 && sd.value[RED_IDX] <= 5988);
+}
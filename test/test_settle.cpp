@@ -0,0 +1,180 @@
+// test_settle.cpp
+//----------------
+// settle detection after a put-down, run on the traces of settle_traces.h: which number of equal
+// readings and probe interval scan as early as possible without scanning before the can sits flat
+
+#include "device.h"
+
+#include "settle_traces.h"
+#include <tonino_tcs3200.h>
+
+static const SettleTrace* trace;
+static uint64_t traceStart;    // put-down, NEVER while the can is lifted
+static uint64_t firstLedOn;    // first use of the LEDs after the put-down
+
+static const uint64_t NEVER = ~0ULL;
+
+// the room light, or its leak under the can while it is put down, plus the LEDs reflected by coffee
+static void puttingDown(uint64_t us, bool ledOn, mock::Light* light) {
+  if (traceStart == NEVER || us < traceStart) {
+    *light = ROOM;
+    return;
+  }
+  uint32_t leak = settleLeak(*trace, (us - traceStart) / 1000);
+  for (uint8_t i = 0; i < 4; ++i) {
+    light->hz[i] = (uint64_t)ROOM.hz[i] * leak / ROOM.hz[0];
+  }
+  if (ledOn) {
+    if (firstLedOn == NEVER) {
+      firstLedOn = us;
+    }
+    for (uint8_t i = 0; i < 4; ++i) {
+      light->hz[i] += COFFEE.hz[i];
+    }
+  }
+}
+
+static void startTrace(const SettleTrace& t, uint64_t at) {
+  trace = &t;
+  traceStart = at;
+  firstLedOn = NEVER;
+  mock::setLightFunction(puttingDown);
+}
+
+// the sketch notices the dark can up to a lift interval after the put-down; runs of each trace
+// start their probes this many ms into the trace
+static const uint16_t offsets[] = { 0, 3, 7, 12, 18, 25, 33, 42 };
+#define NR_OFFSETS (sizeof(offsets) / sizeof(offsets[0]))
+
+// ms after the put-down at which the rule "readings equal successive quick readings, one every
+// interval ms" (all 0 if dark) detects a settled can; probes are scheduled interval ms after the
+// previous one ended, as in the sketch
+static uint32_t detect(const SettleTrace& t, uint16_t offset, uint8_t readings, uint16_t interval, bool dark) {
+  mock::reset();
+  TCS3200 sensor(MOCK_PIN_S2, MOCK_PIN_S3, MOCK_PIN_LED, MOCK_PIN_POWER, NULL);
+  sensor.init();
+  startTrace(t, mock::now());
+  delay(offset);
+  // millis() as in settled(), it takes simulated time as well
+  uint32_t start = millis();
+  uint32_t last = sensor.readWhite();
+  uint8_t stable = 1;
+  for (;;) {
+    delay(interval);
+    uint32_t white = sensor.readWhite();
+    stable = (white == last && (!dark || white == 0) ? stable + 1 : 1);
+    last = white;
+    if (stable >= readings || millis() - start >= SETTLE_TIMEOUT) {
+      return (mock::now() - traceStart) / 1000;
+    }
+  }
+}
+
+// the rule above is what TCS3200::settled() implements with the SETTLE_xxx constants
+TEST(model_matches_detector) {
+  for (size_t i = 0; i < NR_SETTLE_TRACES; ++i) {
+    for (size_t o = 0; o < NR_OFFSETS; ++o) {
+      uint32_t model = detect(settleTraces[i], offsets[o], SETTLE_READINGS, SETTLE_PROBE_INTERVAL, SETTLE_DARK);
+      mock::reset();
+      TCS3200 sensor(MOCK_PIN_S2, MOCK_PIN_S3, MOCK_PIN_LED, MOCK_PIN_POWER, NULL);
+      sensor.init();
+      startTrace(settleTraces[i], mock::now());
+      delay(offsets[o]);
+      sensor.startSettle();
+      do {
+        delay(SETTLE_PROBE_INTERVAL);
+      } while (!sensor.settled());
+      CHECK_EQ((mock::now() - traceStart) / 1000, (uint64_t)model);
+    }
+  }
+  mock::setLightFunction(NULL);
+}
+
+// all combinations of rule, readings and interval on all traces: the chosen one is the fastest
+// that never detects a can as settled before it sits flat
+TEST(settle_parameters) {
+  static const uint8_t readings[] = { 2, 3, 4, 5, 6 };
+  static const uint16_t intervals[] = { 0, 10, 20, 30, 50 };
+
+  printf("rule  readings interval");
+  for (size_t t = 0; t < NR_SETTLE_TRACES; ++t) {
+    printf(" %8s", settleTraces[t].name);
+  }
+  printf("  early  mean ms\n%-23s", "seated at");
+  for (size_t t = 0; t < NR_SETTLE_TRACES; ++t) {
+    printf(" %8u", settleSeated(settleTraces[t]));
+  }
+  printf("\n");
+
+  uint32_t chosenMean = 0;
+  uint32_t bestMean = SETTLE_TIMEOUT;
+  for (int dark = 0; dark < 2; ++dark) {
+    for (size_t r = 0; r < sizeof(readings); ++r) {
+      for (size_t i = 0; i < sizeof(intervals) / sizeof(intervals[0]); ++i) {
+        uint32_t early = 0, total = 0;
+        printf("%-5s %8u %8u", dark ? "dark" : "equal", readings[r], intervals[i]);
+        for (size_t t = 0; t < NR_SETTLE_TRACES; ++t) {
+          // the latest detection of the runs, marked if any run was too early
+          uint32_t latest = 0;
+          bool tooEarly = false;
+          for (size_t o = 0; o < NR_OFFSETS; ++o) {
+            uint32_t ms = detect(settleTraces[t], offsets[o], readings[r], intervals[i], dark);
+            tooEarly = tooEarly || ms < settleSeated(settleTraces[t]);
+            early += (ms < settleSeated(settleTraces[t]));
+            latest = max(latest, ms);
+            total += ms;
+          }
+          printf(" %7u%c", latest, tooEarly ? '!' : ' ');
+        }
+        uint32_t mean = total / (NR_SETTLE_TRACES * NR_OFFSETS);
+        printf(" %6u %8u\n", early, mean);
+        if (dark == SETTLE_DARK && readings[r] == SETTLE_READINGS && intervals[i] == SETTLE_PROBE_INTERVAL) {
+          CHECK_EQ(early, 0u);
+          chosenMean = mean;
+        }
+        if (early == 0 && mean < bestMean) {
+          bestMean = mean;
+        }
+      }
+    }
+  }
+  mock::setLightFunction(NULL);
+  REQUIRE(chosenMean > 0);
+  CHECK_EQ(chosenMean, bestMean);
+}
+
+// the whole device in throughput mode: each put-down is scanned, never before the can sits flat,
+// and counted by GETSETTLE
+TEST(put_downs_scanned_when_seated) {
+  powerOn();
+  REQUIRE(command("SETTHROUGHPUT 1") == "SETTHROUGHPUT");
+  REQUIRE(command("SUBSCRIBE 1") == "SUBSCRIBE");
+  for (size_t t = 0; t < NR_SETTLE_TRACES; ++t) {
+    startTrace(settleTraces[t], NEVER);
+    REQUIRE(awaitLine("!LIFT", 3000000) != "");
+    runFor(500000);
+    traceStart = mock::now();
+    std::string scan = awaitLine("!SCAN", 3000000);
+    REQUIRE(scan != "");
+    REQUIRE(firstLedOn != NEVER);
+    uint64_t waited = (firstLedOn - traceStart) / 1000;
+    printf("%-8s seated after %3u ms, scanned after %3u ms\n", settleTraces[t].name,
+           settleSeated(settleTraces[t]), (uint32_t)waited);
+    CHECK(waited >= settleSeated(settleTraces[t]));
+    mock::setLightFunction(NULL);
+    mock::setLight(DARK, COFFEE);
+  }
+  std::string settle = command("GETSETTLE");
+  printf("%s\n", settle.c_str());
+  uint32_t counts[SETTLE_BUCKETS], total;
+  REQUIRE(sscanf(settle.c_str(), "GETSETTLE:%u %u %u %u %u %u %u", &counts[0], &counts[1], &counts[2],
+                 &counts[3], &counts[4], &counts[5], &total) == 7);
+  uint32_t n = 0;
+  for (uint8_t b = 0; b < SETTLE_BUCKETS; ++b) {
+    n += counts[b];
+  }
+  CHECK_EQ(n, (uint32_t)NR_SETTLE_TRACES);
+  // none timed out
+  CHECK_EQ(counts[SETTLE_BUCKETS - 1], 0u);
+  CHECK(total > NR_SETTLE_TRACES * 500);
+}